@@ -0,0 +1,425 @@
+#include "ForceCheck.h"
+#include <iostream>
+#include <algorithm>
+#include "Setup.h"
+#include "Ensemble.h"
+#include "Integrator.h"
+#include "Minimizer.h"
+#include "CellBuilder.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// The cases are the random cubic box, the same molecules reordered and with
+// partial charges, the triclinic box, and the pairs at the edges with and
+// without the cut-off, followed by the drift of the energy
+int ForceCheck::run(dataT* data) {
+	int failed = 0;
+	dataT c = *data;
+	c.config = "";
+	c.LT = LatticeType::RANDOM;
+	c.MT = MinType::NONE;
+	c.monteCarlo = 0;
+	// The cell list needs a cut-off
+	if (c.r_co <= 0.0) {
+		c.r_co = 2.5;
+	}
+
+	// A random configuration in the (cubic) box of the input
+	Atoms* atoms = buildConfiguration(&c);
+	double L = atoms->getBox().getLength(0) * c.sigma;
+	failed += compareKernels("cubic", atoms, &c);
+
+	// The same configuration in the Morton order of the cells
+	failed += compareKernels("cubic, reordered", atoms, &c, true);
+
+	// The same configuration with the pairs at the edges
+	failed += placeEdgePairs(atoms, c.r_co, c.seed);
+	failed += compareKernels("cubic, edge pairs", atoms, &c);
+
+	// Partial charges of alternating sign, unless the input has them, so the
+	// real-space and the excluded pairs of the PME are compared as well
+	if (!atoms->hasCharges()) {
+		vector<double> q(c.apm);
+		for (int i = 0; i < c.apm; i++) {
+			q[i] = i % 2 == 0 ? testCharge : -testCharge;
+		}
+		atoms->setCharges(q);
+		if (c.apm == 1) {
+			cout << "The molecules are single atoms, so there are no excluded "
+				<< "pairs" << endl;
+		}
+		failed += compareKernels("cubic, charged edge pairs", atoms, &c);
+	}
+	delete atoms;
+
+	// A triclinic box with the volume of the cubic box, which is made wider
+	// along y and z, so the tilts don't make it too narrow for the cell list
+	dataT t = c;
+	t.nMolecules = static_cast<int>(ceil(c.nMolecules * 1.25 * 1.25));
+	t.box = { L, 1.25 * L, 1.25 * L, 0.3 * L, -0.2 * L, 0.25 * L };
+	atoms = buildConfiguration(&t);
+	failed += compareKernels("triclinic", atoms, &t);
+	failed += placeEdgePairs(atoms, t.r_co, t.seed);
+	failed += compareKernels("triclinic, edge pairs", atoms, &t);
+	delete atoms;
+
+	// Without a cut-off every pair interacts, also across half the box. The
+	// real-space sum of the PME ends at half the box, where the energy jumps,
+	// so the molecules are neutral here.
+	dataT a = c;
+	a.nMolecules = min(c.nMolecules, 256);
+	a.r_co = 0.0;
+	a.box.clear();
+	a.charges.clear();
+	atoms = buildConfiguration(&a);
+	failed += placeEdgePairs(atoms,
+		min(2.5, 0.4 * atoms->getBox().getMinimumWidth()), a.seed);
+	failed += compareKernels("no cut-off, edge pairs", atoms, &a);
+	failed += checkGradient("no cut-off, edge pairs", atoms, &a, edgePairs);
+	delete atoms;
+
+	failed += checkDrift(&c);
+
+	if (failed == 0) {
+		cout << "All force checks passed" << endl;
+		return 0;
+	}
+	cout << failed << " force check(s) failed" << endl;
+	return -1;
+}
+
+// The molecules are inserted randomly without overlaps. If the box is too
+// narrow for a cell list of three cells per axis, the box and the number of
+// molecules grow at the same density.
+Atoms* ForceCheck::buildConfiguration(dataT* d) {
+	Atoms* atoms = new Atoms(d->apm, d->mass);
+	InitializeSetup(atoms, d);
+	double width = atoms->getBox().getMinimumWidth();
+	double needed = 3.05 * d->r_co;
+	if (d->r_co > 0.0 && width < needed) {
+		double f = needed / width;
+		d->nMolecules = static_cast<int>(ceil(d->nMolecules * f * f * f));
+		for (size_t k = 0; k < d->box.size(); k++) {
+			d->box[k] *= f;
+		}
+		cout << "The box is too narrow for the cell list, so the check uses "
+			<< d->nMolecules << " molecules" << endl;
+		delete atoms;
+		atoms = new Atoms(d->apm, d->mass);
+		InitializeSetup(atoms, d);
+	}
+	return atoms;
+}
+
+// Every placement moves its own molecule from the end of the list next to an
+// anchor molecule from the start. The molecules in the way are moved to random
+// places with room, but an anchor, which is in the way itself, or an earlier
+// pair in the way are tried with the next anchor instead.
+int ForceCheck::placeEdgePairs(Atoms* atoms, double r_c, int seed) {
+	const boxT& box = atoms->getBox();
+	int apm = atoms->getApm();
+	int nm = atoms->getNM();
+	double s = 1.0 / sqrt(3.0);
+	// The separations of the first atoms
+	double separations[edgePairs][3] = {
+		{ r_c * (1.0 - edgeOffset), 0.0, 0.0 },
+		{ 0.0, r_c * (1.0 + edgeOffset), 0.0 },
+		{ s * r_c * (1.0 - edgeOffset), s * r_c * (1.0 - edgeOffset),
+			s * r_c * (1.0 - edgeOffset) },
+		// Half the last cell vector, which is the longest minimum image
+		{ 0.5 * box.h[0][2] * (1.0 - edgeOffset),
+			0.5 * box.h[1][2] * (1.0 - edgeOffset),
+			0.5 * box.h[2][2] * (1.0 - edgeOffset) }
+	};
+
+	CounterRNG rng(static_cast<uint64_t>(seed));
+	// The molecules of the placed pairs, which stay where they are
+	vector<bool> fixed(nm, false);
+	int skipped = 0;
+	for (int p = 0; p < edgePairs; p++) {
+		int m = nm - 1 - p;
+		bool placed = false;
+		for (int anchor = 0; anchor < m && !placed; anchor++) {
+			if (fixed[anchor]) continue;
+			// Move molecule m rigidly, so its first atom is at the separation
+			vector<double> first = atoms->getPos(m * apm);
+			vector<double> target = atoms->getPos(anchor * apm);
+			vector<vector<double>> r(apm), old(apm);
+			for (int i = 0; i < apm; i++) {
+				old[i] = atoms->getPos(m * apm + i);
+				r[i] = old[i];
+				for (int k = 0; k < 3; k++) {
+					r[i][k] += target[k] + separations[p][k] - first[k];
+				}
+			}
+			vector<int> overlaps = findOverlaps(atoms, m, r);
+			bool movable = true;
+			for (int o : overlaps) {
+				movable = movable && o != anchor && !fixed[o];
+			}
+			if (!movable) continue;
+			for (int i = 0; i < apm; i++) {
+				atoms->setPos(m * apm + i, r[i]);
+			}
+			placed = true;
+			for (int o : overlaps) {
+				placed = placed && relocate(atoms, o, rng);
+			}
+			if (!placed) {
+				for (int i = 0; i < apm; i++) {
+					atoms->setPos(m * apm + i, old[i]);
+				}
+				continue;
+			}
+			fixed[m] = true;
+			fixed[anchor] = true;
+		}
+		if (!placed) {
+			cout << "FAIL No room for edge pair " << p << endl;
+			skipped++;
+		}
+	}
+	return skipped;
+}
+
+// Every atom of the other molecules is compared with the positions
+vector<int> ForceCheck::findOverlaps(Atoms* atoms, int m,
+	const vector<vector<double>>& r) {
+	const boxT& box = atoms->getBox();
+	int apm = atoms->getApm();
+	vector<int> overlaps;
+	for (int j = 0; j < atoms->getSize(); j++) {
+		int o = j / apm;
+		if (o == m || (!overlaps.empty() && overlaps.back() == o)) continue;
+		vector<double> x = atoms->getPos(j);
+		for (size_t i = 0; i < r.size(); i++) {
+			double d[3];
+			for (int k = 0; k < 3; k++) {
+				d[k] = r[i][k] - x[k];
+			}
+			box.minimumImage(d);
+			if (d[0] * d[0] + d[1] * d[1] + d[2] * d[2]
+				< clearance * clearance) {
+				overlaps.push_back(o);
+				break;
+			}
+		}
+	}
+	return overlaps;
+}
+
+// The first atom of the molecule goes to a uniform random place in the box,
+// and the orientation is kept
+bool ForceCheck::relocate(Atoms* atoms, int m, CounterRNG& rng) {
+	const boxT& box = atoms->getBox();
+	int apm = atoms->getApm();
+	vector<double> first = atoms->getPos(m * apm);
+	vector<vector<double>> r(apm);
+	for (int trial = 0; trial < maxRelocations; trial++) {
+		double u[4], target[3];
+		rng.uniform(m, trial, CounterRNG::RELOCATION, u);
+		box.toCartesian(u, target);
+		for (int i = 0; i < apm; i++) {
+			r[i] = atoms->getPos(m * apm + i);
+			for (int k = 0; k < 3; k++) {
+				r[i][k] += target[k] - first[k];
+			}
+		}
+		if (findOverlaps(atoms, m, r).empty()) {
+			for (int i = 0; i < apm; i++) {
+				atoms->setPos(m * apm + i, r[i]);
+			}
+			return true;
+		}
+	}
+	return false;
+}
+
+// The reference is the all-pairs loop of a Potential without a cell list on
+// one thread. The test Potential is made anew for every thread count, so
+// nothing is reused from an earlier calculation. A reordering is done like
+// the Ensemble does it, after the test Potential has calculated the forces
+// in the old order.
+int ForceCheck::compareKernels(string name, Atoms* atoms, dataT* data,
+	bool reorder) {
+	int maxThreads = 1;
+#ifdef _OPENMP
+	maxThreads = omp_get_max_threads();
+	omp_set_num_threads(1);
+#endif
+	Potential* ref = Potential::createPotential(atoms, data);
+	ref->disableCellList();
+	resultT expected = getResult(ref, atoms);
+	delete ref;
+	bool cellList = data->r_co > 0.0
+		&& atoms->getBox().getMinimumWidth() >= 3.0 * data->r_co;
+
+	int failed = 0;
+	vector<int> threads;
+	// The all-pairs loop on one thread is the reference itself
+	if (cellList) {
+		threads.push_back(1);
+	}
+	if (maxThreads > 1) {
+		threads.push_back(maxThreads);
+	}
+	if (threads.empty()) {
+		cout << "SKIP " << name << " (all pairs needs more than one thread)"
+			<< endl;
+	}
+	for (int n : threads) {
+#ifdef _OPENMP
+		omp_set_num_threads(n);
+#endif
+		Potential* test = Potential::createPotential(atoms, data);
+		if (reorder) {
+			test->getForces();
+			vector<int> order = test->getSpatialOrder();
+			atoms->reorder(order);
+			test->reorder(order);
+		}
+		string label = name + (cellList ? " (cell list, " : " (all pairs, ")
+			+ to_string(n) + (n == 1 ? " thread)" : " threads)");
+		if (!compare(label, expected, getResult(test, atoms))) {
+			failed++;
+		}
+		delete test;
+	}
+#ifdef _OPENMP
+	omp_set_num_threads(maxThreads);
+#endif
+	return failed;
+}
+
+// The forces are put back in the original order of the atoms, so the results
+// of reordered molecules compare atom by atom
+ForceCheck::resultT ForceCheck::getResult(Potential* pot, Atoms* atoms) {
+	resultT r;
+	const vector<vector<double>>& F = pot->getForces();
+	r.F.resize(F.size());
+	for (int i = 0; i < atoms->getSize(); i++) {
+		r.F[atoms->getOriginalIndex(i)] = F[i];
+	}
+	r.U = pot->getEnergy();
+	r.S = pot->getSumForcesInteraction();
+	r.W = pot->getVirialTensor();
+	return r;
+}
+
+// The differences are relative to the size of the quantity, or absolute
+// when it is below one
+bool ForceCheck::compare(string name, const resultT& ref,
+	const resultT& test) {
+	double dU = abs(test.U - ref.U) / max(abs(ref.U), 1.0);
+	double dS = abs(test.S - ref.S) / max(abs(ref.S), 1.0);
+	double dW = 0.0, Wmax = 1.0;
+	for (int a = 0; a < 3; a++) {
+		for (int b = 0; b < 3; b++) {
+			dW = max(dW, abs(test.W[a][b] - ref.W[a][b]));
+			Wmax = max(Wmax, abs(ref.W[a][b]));
+		}
+	}
+	dW /= Wmax;
+	double dF = 0.0, Fmax = 1.0;
+	for (size_t i = 0; i < ref.F.size(); i++) {
+		for (int k = 0; k < 3; k++) {
+			dF = max(dF, abs(test.F[i][k] - ref.F[i][k]));
+			Fmax = max(Fmax, abs(ref.F[i][k]));
+		}
+	}
+	dF /= Fmax;
+
+	bool pass = dU <= relTolerance && dS <= relTolerance
+		&& dW <= relTolerance && dF <= relTolerance;
+	cout << (pass ? "PASS " : "FAIL ") << name << ": dU = " << dU
+		<< ", dF = " << dF << ", dS = " << dS << ", dW = " << dW << endl;
+	return pass;
+}
+
+// Every atom of the last molecules is moved a step back and forth along each
+// axis. An atom within a few steps of the minimum image boundary to another
+// atom is left out, as the energy has a kink there.
+int ForceCheck::checkGradient(string name, Atoms* atoms, dataT* data,
+	int nMolecules) {
+	const boxT& box = atoms->getBox();
+	int apm = atoms->getApm();
+	int first = (atoms->getNM() - nMolecules) * apm;
+	Potential* pot = Potential::createPotential(atoms, data);
+	pot->disableCellList();
+	vector<vector<double>> F = pot->getForces();
+
+	double dF = 0.0, Fmax = 1.0;
+	int checked = 0;
+	for (int i = first; i < atoms->getSize(); i++) {
+		vector<double> x = atoms->getPos(i);
+		bool kink = false;
+		for (int j = 0; j < atoms->getSize() && !kink; j++) {
+			if (j == i) continue;
+			vector<double> y = atoms->getPos(j);
+			double d[3], s[3];
+			for (int k = 0; k < 3; k++) {
+				d[k] = x[k] - y[k];
+			}
+			box.minimumImage(d);
+			box.toFractional(d, s);
+			for (int k = 0; k < 3; k++) {
+				kink = kink || abs(abs(s[k]) - 0.5)
+					< 10.0 * gradientStep / box.getWidth(k);
+			}
+		}
+		if (kink) continue;
+		for (int k = 0; k < 3; k++) {
+			vector<double> r = x;
+			r[k] = x[k] + gradientStep;
+			atoms->setPos(i, r);
+			double Uplus = pot->getEnergy();
+			r[k] = x[k] - gradientStep;
+			atoms->setPos(i, r);
+			double Uminus = pot->getEnergy();
+			double Fk = -(Uplus - Uminus) / (2.0 * gradientStep);
+			dF = max(dF, abs(F[i][k] - Fk));
+			Fmax = max(Fmax, abs(F[i][k]));
+		}
+		atoms->setPos(i, x);
+		checked++;
+	}
+	delete pot;
+	dF /= Fmax;
+
+	bool pass = checked > 0 && dF <= gradTolerance;
+	cout << (pass ? "PASS " : "FAIL ") << name << " (gradient of the energy, "
+		<< checked << " atoms): dF = " << dF << endl;
+	return pass ? 0 : 1;
+}
+
+// The relaxed configuration starts at the temperature of the input, and the
+// conserved energy is watched every step
+int ForceCheck::checkDrift(dataT* data) {
+	dataT d = *data;
+	d.MT = MinType::FIRE;
+	d.ET = EnsType::NVE;
+	d.IT = InteType::VELVERLET;
+	// Without a relaxation time the integrator has no thermostat
+	d.tau_s_s = 0.0;
+	Atoms* atoms = buildConfiguration(&d);
+	Ensemble* ens = Ensemble::createEnsemble(atoms, &d);
+	double U = ens->calculate();
+	double K0 = atoms->getEnergy();
+	double H0 = U + K0;
+	double drift = 0.0;
+	int steps = min(d.simSteps, maxDriftSteps);
+	for (int i = 0; i < steps; i++) {
+		ens->update();
+		U = ens->calculate();
+		drift = max(drift, abs(U + atoms->getEnergy() - H0));
+	}
+	drift /= K0;
+	delete ens;
+	delete atoms;
+
+	bool pass = drift <= driftTolerance;
+	cout << (pass ? "PASS " : "FAIL ") << "NVE energy drift over "
+		<< steps << " steps: max |H - H0| / K0 = " << drift << endl;
+	return pass ? 0 : 1;
+}
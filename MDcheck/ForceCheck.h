@@ -0,0 +1,97 @@
+#ifndef _forcecheck_h
+#define _forcecheck_h
+
+#include "Atoms.h"
+#include "Potential.h"
+#include "dataType.h"
+#include "Random.h"
+
+// Static class for checking the force kernels of the Potential against the
+// reference all-pairs loops (the MDcheck tool). Random configurations of the
+// molecules of the input are built in a cubic and a triclinic box, and with
+// pairs placed just inside and outside the cut-off and at half the box. The
+// cubic box is also checked in the Morton order of the cells, and with
+// partial charges for the PME paths. The energy, the forces, the sum of the
+// force interactions and the virial tensor of the cell list kernels are
+// compared with the reference for one and for all the OpenMP threads, and the
+// all-pairs loop without a cut-off with the gradient of its energy. At last
+// the energy conservation is checked over a short NVE run.
+class ForceCheck
+{
+public:
+	// Static function for running all the checks for the system of the
+	// input. Returns 0, if they all pass.
+	static int run(dataT* data);
+
+private:
+	// The energy, the forces, the sum of the force interactions and the
+	// virial tensor of a calculation
+	struct resultT {
+		vector<vector<double>> F;
+		double U;
+		double S;
+		vector<vector<double>> W;
+	};
+
+	// The largest difference to the reference relative to the size of the
+	// compared quantity
+	static constexpr double relTolerance = 1e-9;
+	// The largest |H(t) - H(0)| relative to the initial kinetic energy in the
+	// NVE run
+	static constexpr double driftTolerance = 1e-2;
+	// The largest difference of the forces to the central differences of the
+	// energy relative to the largest force
+	static constexpr double gradTolerance = 1e-6;
+	// The step of the central differences
+	static constexpr double gradientStep = 1e-5;
+	// The (reduced) partial charge of the check with charges
+	static constexpr double testCharge = 1.0;
+	// The largest number of steps of the NVE run (at most the input steps)
+	static constexpr int maxDriftSteps = 1000;
+	// The relative distance of the pairs inside and outside the cut-off
+	static constexpr double edgeOffset = 1e-9;
+	// The number of pairs placed at the edges
+	static constexpr int edgePairs = 4;
+	// The closest distance of a placed molecule to the other atoms
+	static constexpr double clearance = 0.8;
+	// The most random places tried for a molecule, which is moved out of the
+	// way of an edge pair
+	static constexpr int maxRelocations = 1000;
+
+	// Build a random configuration of the molecules in the box of the data
+	// (or a cubic box with the density of the data)
+	static Atoms* buildConfiguration(dataT* data);
+	// Move edgePairs molecules rigidly, so their first atoms are at the cut-off
+	// (inside and outside), on the diagonal inside the cut-off, and at half
+	// the box from the first atom of another molecule. Returns the number of
+	// pairs, which couldn't be placed.
+	static int placeEdgePairs(Atoms* atoms, double r_c, int seed);
+	// Get the molecules (other than molecule m) with an atom closer than the
+	// clearance to one of the positions r
+	static vector<int> findOverlaps(Atoms* atoms, int m,
+		const vector<vector<double>>& r);
+	// Move molecule m rigidly to a random place with room. Returns false, if
+	// none is found.
+	static bool relocate(Atoms* atoms, int m, CounterRNG& rng);
+	// Compare the kernels with the reference for a configuration. With
+	// reorder, the molecules are put in the Morton order of the cells first.
+	// Returns the number of failed comparisons.
+	static int compareKernels(string name, Atoms* atoms, dataT* data,
+		bool reorder = false);
+	// Get the results of a Potential with the forces in the original order
+	// of the atoms
+	static resultT getResult(Potential* pot, Atoms* atoms);
+	// Compare the results of two Potentials for the same Atoms
+	static bool compare(string name, const resultT& ref,
+		const resultT& test);
+	// Compare the forces of the all-pairs loop on the atoms of the last
+	// molecules with the central differences of the energy. Returns 1, if it
+	// fails.
+	static int checkGradient(string name, Atoms* atoms, dataT* data,
+		int nMolecules);
+	// Check the energy conservation of a relaxed configuration with the
+	// Velocity Verlet integrator. Returns 1, if it fails.
+	static int checkDrift(dataT* data);
+};
+
+#endif // !_forcecheck_h
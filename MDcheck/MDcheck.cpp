@@ -0,0 +1,41 @@
+// MDcheck.cpp : Consistency check of the force kernels of MDsimulator for the
+// system of an input file. The command is:
+//	MDcheck [input]
+//		check the cell list kernels against the all-pairs reference for
+//		random cubic and triclinic boxes, reordered molecules, partial
+//		charges and pairs at the edges of the cut-off, with one and all the
+//		threads (OpenMP), the all-pairs forces without a cut-off against the
+//		gradient of the energy, and the energy drift of a short NVE run (the
+//		input is params.in by default)
+// The exit code is 0, if all the checks pass, so the tool can gate a build.
+//
+
+#include <iostream>
+#include <string>
+
+#include "dataType.h"
+#include "Setup.h"
+#include "Arena.h"
+#include "ForceCheck.h"
+using namespace std;
+
+// The input file, unless one is given
+const string INFILE = "params.in";
+
+
+// Main program execution routine
+int main(int argc, char* argv[])
+{
+	if (argc > 2) {
+		cout << "Usage: MDcheck [input]" << endl;
+		return -1;
+	}
+	string file = argc == 2 ? argv[1] : INFILE;
+
+	// Create the data container and populate it
+	dataT dataContainer;
+	GetParameters(&dataContainer, file);
+	Arena::setHugePages(dataContainer.hugePages != 0);
+
+	return ForceCheck::run(&dataContainer);
+}
@@ -0,0 +1,267 @@
+// MDpost.cpp : Post-processing of the output of MDsimulator, which reads the
+// binary files without the simulation engine. The commands are:
+//	MDpost info <file>
+//		list the columns, the rows and the time span of an observable store
+//	MDpost text <file> [column ...] [-from t] [-to t]
+//		write the columns (all by default) in the time window [ps] as
+//		tab-separated text to the console, like sim.out
+//	MDpost rdf <file> [-from t] [-to t] [-dr w] [-rmax r]
+//		the radial distribution function of the frames of a trajectory in
+//		the time window, with bins of width w up to r (reduced, by default
+//		the bins of rdf.txt up to half the smallest width of the boxes)
+//	MDpost msd <file> [-from t] [-to t] [-origins k]
+//		the mean square displacement [Angstrom^2] of the frames of a
+//		trajectory from time origins every k frames (default 1), and the
+//		self-diffusion coefficient from its slope
+// The frames of a trajectory are read from the mapping by all the threads
+// (OpenMP) at the same time.
+//
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <map>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "ObservableStore.h"
+#include "Trajectory.h"
+#include "Analysis.h"
+using namespace std;
+
+// Function prototypes for main
+int info(string file);
+int text(string file, vector<string> names, double tFrom, double tTo);
+int rdf(string file, double tFrom, double tTo, double dr, double rMax);
+int msd(string file, double tFrom, double tTo, int originStride);
+void getFrameWindow(TrajectoryReader* traj, double tFrom, double tTo,
+	int* begin, int* end);
+void usage();
+
+
+// Main program execution routine
+int main(int argc, char* argv[])
+{
+	if (argc < 3) {
+		usage();
+		return -1;
+	}
+	string command = argv[1];
+	string file = argv[2];
+	// The remaining arguments are the columns and the options with a value
+	vector<string> names;
+	map<string, double> options = { { "-from", -1e300 }, { "-to", 1e300 },
+		{ "-dr", AnalysisTools::RadDistribFunc::defaultBinWidth },
+		{ "-rmax", 0.0 }, { "-origins", 1.0 } };
+	for (int a = 3; a < argc; a++) {
+		string arg = argv[a];
+		if (options.count(arg) > 0 && a + 1 < argc) {
+			options[arg] = atof(argv[++a]);
+		} else {
+			names.push_back(arg);
+		}
+	}
+	double tFrom = options["-from"], tTo = options["-to"];
+
+	if (command == "info") {
+		return info(file);
+	}
+	if (command == "text") {
+		return text(file, names, tFrom, tTo);
+	}
+	if (command == "rdf") {
+		return rdf(file, tFrom, tTo, options["-dr"], options["-rmax"]);
+	}
+	if (command == "msd") {
+		return msd(file, tFrom, tTo,
+			max(1, static_cast<int>(options["-origins"])));
+	}
+	usage();
+	return -1;
+}
+
+int info(string file) {
+	ObservableReader obs(file);
+	cout << obs.getRows() << " rows in " << obs.getChunks() << " chunks";
+	if (obs.getChunks() > 0) {
+		int n;
+		const double* first = obs.getChunk(0, 0, &n);
+		const double* last = obs.getChunk(obs.getChunks() - 1, 0, &n);
+		cout << " from t = " << first[0] << " to " << last[n - 1] << " ps";
+	}
+	cout << endl << "columns:";
+	for (const string& name : obs.getColumns()) {
+		cout << " " << name;
+	}
+	cout << endl;
+	return 0;
+}
+
+// Only the chunks in the time window are touched, and of those only the
+// requested columns
+int text(string file, vector<string> names, double tFrom, double tTo) {
+	ObservableReader obs(file);
+	if (names.empty()) {
+		names = obs.getColumns();
+	}
+	vector<int> columns;
+	for (const string& name : names) {
+		int c = obs.findColumn(name);
+		if (c < 0) {
+			cout << "'" << file << "' has no column '" << name << "'" << endl;
+			return -1;
+		}
+		columns.push_back(c);
+	}
+
+	for (size_t c = 0; c < names.size(); c++) {
+		cout << (c > 0 ? "\t" : "") << names[c];
+	}
+	cout << "\n";
+	vector<const double*> values(columns.size());
+	for (int k = obs.findChunk(tFrom); k < obs.getChunks(); k++) {
+		int begin, end, n;
+		if (!obs.getWindow(k, tFrom, tTo, &begin, &end)) {
+			// The chunks after the window are skipped too
+			if (obs.getChunk(k, 0, &n)[0] > tTo) break;
+			continue;
+		}
+		for (size_t c = 0; c < columns.size(); c++) {
+			values[c] = obs.getChunk(k, columns[c], &n);
+		}
+		for (int i = begin; i < end; i++) {
+			for (size_t c = 0; c < columns.size(); c++) {
+				cout << (c > 0 ? "\t" : "") << values[c][i];
+			}
+			cout << "\n";
+		}
+	}
+	cout.flush();
+	return 0;
+}
+
+// Every thread bins its frames in its own histogram, and the histograms are
+// added at the end. The density is the mean of the frames, as the box may
+// change under pressure.
+int rdf(string file, double tFrom, double tTo, double dr, double rMax) {
+	TrajectoryReader traj(file);
+	int begin, end;
+	getFrameWindow(&traj, tFrom, tTo, &begin, &end);
+	if (begin >= end) {
+		cout << "'" << file << "' has no frames in the time window" << endl;
+		return -1;
+	}
+	int n = traj.getAtoms();
+	double rhoN = 0.0, widthMin = 0.0;
+	for (int f = begin; f < end; f++) {
+		double t;
+		boxT box;
+		traj.getFrame(f, &t, &box);
+		rhoN += n / traj.getApm() / box.getVolume() / (end - begin);
+		double w = box.getMinimumWidth();
+		widthMin = f == begin ? w : fmin(widthMin, w);
+	}
+	// The minimum image only finds the pairs up to half the width
+	if (rMax <= 0.0 || rMax > widthMin / 2.0) {
+		rMax = widthMin / 2.0;
+	}
+
+	int nThreads = 1;
+#ifdef _OPENMP
+	nThreads = omp_get_max_threads();
+#endif
+	vector<AnalysisTools::RadDistribFunc> partial(nThreads,
+		AnalysisTools::RadDistribFunc(n, rhoN, rMax, dr));
+	#pragma omp parallel for schedule(dynamic)
+	for (int f = begin; f < end; f++) {
+		int thread = 0;
+#ifdef _OPENMP
+		thread = omp_get_thread_num();
+#endif
+		double t;
+		boxT box;
+		const double* r = traj.getFrame(f, &t, &box);
+		partial[thread].update(r, box);
+	}
+	for (int th = 1; th < nThreads; th++) {
+		partial[0].merge(partial[th]);
+	}
+
+	cout << "r" << "\t" << "g_r" << "\n";
+	for (vector<double> c : partial[0].getRDF()) {
+		cout << c[0] << "\t" << c[1] << "\n";
+	}
+	cout.flush();
+	return 0;
+}
+
+// The displacement of every lag is averaged over all the origins, which
+// have a frame at that lag in the window. The lags are independent, so they
+// are shared by the threads. The frames are assumed to be evenly spaced.
+int msd(string file, double tFrom, double tTo, int originStride) {
+	TrajectoryReader traj(file);
+	int begin, end;
+	getFrameWindow(&traj, tFrom, tTo, &begin, &end);
+	if (end - begin < 2) {
+		cout << "'" << file << "' has less than two frames in the time window"
+			<< endl;
+		return -1;
+	}
+	int n = traj.getAtoms();
+	double t0, t1;
+	traj.getFrame(begin, &t0, nullptr);
+	traj.getFrame(begin + 1, &t1, nullptr);
+	double dt = t1 - t0;
+	// Longer lags have too few origins to be averaged
+	int maxLag = (end - begin) / 2;
+	vector<double> r2(maxLag + 1, 0.0);
+	#pragma omp parallel for schedule(dynamic)
+	for (int lag = 1; lag <= maxLag; lag++) {
+		double sum = 0.0;
+		long long origins = 0;
+		for (int o = begin; o + lag < end; o += originStride) {
+			double t;
+			const double* r0 = traj.getFrame(o, &t, nullptr);
+			const double* r = traj.getFrame(o + lag, &t, nullptr);
+			for (int i = 0; i < 3 * n; i++) {
+				sum += (r[i] - r0[i]) * (r[i] - r0[i]);
+			}
+			origins++;
+		}
+		r2[lag] = sum / n / origins;
+	}
+
+	// The slope is fitted after the first fifth of the lags, where the
+	// motion is no longer ballistic
+	double sigma2 = traj.getSigma() * traj.getSigma();
+	AnalysisTools::LinearRegressor reg;
+	cout << "t" << "\t" << "MSD" << "\n";
+	for (int lag = 0; lag <= maxLag; lag++) {
+		cout << lag * dt << "\t" << r2[lag] * sigma2 << "\n";
+		if (lag >= max(1, maxLag / 5)) {
+			reg.addPoint(lag * dt, r2[lag] * sigma2);
+		}
+	}
+	cout.flush();
+	// 1 Angstrom^2/ps = 1e-8 m^2/s. The coefficient goes to the error
+	// stream, so the output is only the table.
+	cerr << "D = " << reg.getSlope() / 6.0 * 1e-8 << " m^2/s" << endl;
+	return 0;
+}
+
+// The frames with a time in [tFrom, tTo] are [begin, end)
+void getFrameWindow(TrajectoryReader* traj, double tFrom, double tTo,
+	int* begin, int* end) {
+	*begin = traj->findFrame(tFrom);
+	*end = max(*begin, traj->findFrame(nextafter(tTo, HUGE_VAL)));
+}
+
+void usage() {
+	cout << "Usage: MDpost info <file>" << endl
+		<< "       MDpost text <file> [column ...] [-from t] [-to t]" << endl
+		<< "       MDpost rdf <file> [-from t] [-to t] [-dr w] [-rmax r]"
+		<< endl
+		<< "       MDpost msd <file> [-from t] [-to t] [-origins k]" << endl;
+}
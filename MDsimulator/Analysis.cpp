@@ -1,92 +1,283 @@
 #define _USE_MATH_DEFINES
 #include "Analysis.h"
 #include <iostream>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "CellList.h"
 
 // Empty constructor, since all members are already initialized to zero
 AnalysisTools::LinearRegressor::LinearRegressor(){}
 
-// Adding a point adds to all the members and raises the element count by one
+// Adding a point updates the means and the co-moments around them
 void AnalysisTools::LinearRegressor::addPoint(double x, double y) {
-	sumX += x;
-	sumXX += x * x;
-	sumY += y;
-	sumXY += x * y;
 	elements++;
+	double dx = x - meanX;
+	meanX += dx / elements;
+	meanY += (y - meanY) / elements;
+	coXX += dx * (x - meanX);
+	coXY += dx * (y - meanY);
 }
 
-// Getting the slope uses a nice formula for calculating the slope from the sums
+// The slope is the ratio of the co-moments
 double AnalysisTools::LinearRegressor::getSlope() {
 	// We can't have a slope, if there are no elements
-	if (elements == 0) {
+	if (elements == 0 || coXX == 0.0) {
 		return 0;
 	}
-	
-	// Calculate averages
-	double averageX = sumX / elements;
-	double averageY = sumY / elements;
-
-	// Simply return the result of the formula
-	return (sumXY - elements * averageX * averageY) /
-		(sumXX - elements * averageX * averageX);
+	return coXY / coXX;
 }
 
 // Getting the intersect uses  y = ax + b for calculating the intersect from
-// the sums
+// the means
 double AnalysisTools::LinearRegressor::getIntersect() {
 	// We can't have an intersect, if there are no elements
 	if (elements == 0) {
 		return 0;
 	}
 
-	// Calculate averages
-	double averageX = sumX / elements;
-	double averageY = sumY / elements;
-
 	// y = ax + b => b = y - ax, but using averages
-	return averageY - getSlope() * averageX;
+	return meanY - getSlope() * meanX;
 }
 
 // Simply print out the internal members to the console
 void AnalysisTools::LinearRegressor::printSums() {
-	std::cout << sumX << std::endl;
-	std::cout << sumXX << std::endl;
-	std::cout << sumXY << std::endl;
-	std::cout << sumY << std::endl;
+	std::cout << meanX << std::endl;
+	std::cout << meanY << std::endl;
+	std::cout << coXX << std::endl;
+	std::cout << coXY << std::endl;
+}
+
+
+// The levels are created, when the first block reaches them
+AnalysisTools::BlockAverage::BlockAverage()
+	: levels(0)
+{}
+
+void AnalysisTools::BlockAverage::addPoint(double x) {
+	addBlock(0, x);
+}
+
+// Welford's update of the level, and every second block is averaged with
+// the one before it and added to the next level
+void AnalysisTools::BlockAverage::addBlock(int level, double x) {
+	if (level == static_cast<int>(levels.size())) {
+		levels.push_back(levelT());
+	}
+	levelT& l = levels[level];
+	l.n++;
+	double dx = x - l.mean;
+	l.mean += dx / l.n;
+	l.m2 += dx * (x - l.mean);
+	if (l.hasPending) {
+		l.hasPending = false;
+		addBlock(level + 1, 0.5 * (l.pending + x));
+	} else {
+		l.pending = x;
+		l.hasPending = true;
+	}
+}
+
+double AnalysisTools::BlockAverage::getMean() {
+	if (levels.size() == 0) {
+		return 0;
+	}
+	return levels[0].mean;
+}
+
+double AnalysisTools::BlockAverage::getError() {
+	if (levels.size() == 0 || levels[0].n < 2) {
+		return 0;
+	}
+	int plateau = findPlateau();
+	if (plateau >= 0) {
+		return getLevelError(plateau);
+	}
+	double error = getLevelError(0);
+	for (int l = 1; l < static_cast<int>(levels.size())
+		&& levels[l].n >= minBlocks; l++) {
+		error = fmax(error, getLevelError(l));
+	}
+	return error;
+}
+
+bool AnalysisTools::BlockAverage::isConverged() {
+	return findPlateau() >= 0;
+}
+
+long long AnalysisTools::BlockAverage::getSamples() {
+	if (levels.size() == 0) {
+		return 0;
+	}
+	return levels[0].n;
+}
+
+// The standard deviation of the block means divided by sqrt(blocks)
+double AnalysisTools::BlockAverage::getLevelError(int level) {
+	const levelT& l = levels[level];
+	if (l.n < 2) {
+		return 0;
+	}
+	return sqrt(l.m2 / (l.n - 1.0) / l.n);
+}
+
+// The plateau starts at the first level, whose error agrees with the errors
+// of the next two levels within 1.5 times their statistical uncertainty
+// error / sqrt(2 (n - 1)). Both of them need enough blocks.
+int AnalysisTools::BlockAverage::findPlateau() {
+	int usable = 0;
+	while (usable < static_cast<int>(levels.size())
+		&& levels[usable].n >= minBlocks) {
+		usable++;
+	}
+	for (int l = 0; l < usable - 2; l++) {
+		double error = getLevelError(l);
+		bool flat = true;
+		for (int k = l + 1; k <= l + 2 && flat; k++) {
+			double errorK = getLevelError(k);
+			flat = abs(errorK - error)
+				<= 1.5 * errorK / sqrt(2.0 * (levels[k].n - 1.0));
+		}
+		if (flat) {
+			return l;
+		}
+	}
+	return -1;
+}
+
+
+AnalysisTools::EquilibrationDetector::EquilibrationDetector(int n)
+	: batchMeans(n), batchSum(n, 0.0)
+{
+	nSeries = n;
+}
+
+// Adding a point adds to the batch sums, and closes the batch when it is full
+void AnalysisTools::EquilibrationDetector::addPoint(const vector<double>& x) {
+	for (int s = 0; s < nSeries; s++) {
+		batchSum[s] += x[s];
+	}
+	inBatch++;
+	if (inBatch == batchSize) {
+		for (int s = 0; s < nSeries; s++) {
+			batchMeans[s].push_back(batchSum[s] / batchSize);
+			batchSum[s] = 0.0;
+		}
+		inBatch = 0;
+	}
+}
+
+bool AnalysisTools::EquilibrationDetector::isEquilibrated() {
+	for (int s = 0; s < nSeries; s++) {
+		int m = static_cast<int>(batchMeans[s].size());
+		if (m < minBatches || getTruncation(s) >= m / 2 * batchSize) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// The sums over the batches after every truncation point are accumulated
+// from the end, so all the truncation points are tried in one pass. The
+// batch means are shifted by the last one to avoid cancellation.
+int AnalysisTools::EquilibrationDetector::getTruncation(int s) {
+	const vector<double>& y = batchMeans[s];
+	int m = static_cast<int>(y.size());
+	if (m < 2) {
+		return 0;
+	}
+	double shift = y[m - 1];
+	double sum = 0.0, sumSq = 0.0;
+	double best = -1.0;
+	int truncation = 0;
+	for (int d = m - 1; d >= 0; d--) {
+		double dy = y[d] - shift;
+		sum += dy;
+		sumSq += dy * dy;
+		int k = m - d;  // Batches after the truncation
+		// The last batches alone give no meaningful spread
+		if (k < 2) continue;
+		double mser = (sumSq - sum * sum / k) / (static_cast<double>(k) * k);
+		if (best < 0.0 || mser <= best) {
+			best = mser;
+			truncation = d;
+		}
+	}
+	return truncation * batchSize;
 }
 
 
+// The largest sphere, which fits in the box
 AnalysisTools::RadDistribFunc::RadDistribFunc(Atoms* a, dataT* d)
+	: RadDistribFunc(a->getSize(), d->rhoN,
+		a->getBox().getMinimumWidth() / 2.0)
+{
+	atoms = a;
+}
+
+AnalysisTools::RadDistribFunc::RadDistribFunc(int n, double rho, double r,
+	double binWidth)
 	: hist(0, 0)
 {
-	rMax = a->getCellLength() / 2.0;
-	int nbins = static_cast<int>(rMax / 0.02);
+	rMax = r;
+	int nbins = max(1, static_cast<int>(rMax / binWidth));
 	dr = rMax / nbins;
 	hist.resize(nbins);
-	rhoN = d->rhoN;
-	atoms = a;
+	rhoN = rho;
+	nAtoms = n;
 }
 
 AnalysisTools::RadDistribFunc::~RadDistribFunc() {
-	vector<int>().swap(hist);		// Release memory from hist
+	vector<long long>().swap(hist);		// Release memory from hist
 }
 
 void AnalysisTools::RadDistribFunc::update() {
-	vector<vector<double>> r = atoms->getDistances();
-	for (int i = 0; i < atoms->getSize()-1; i++) {
-		for (int j = i+1; j < atoms->getSize(); j++) {
-			if (r[i][j] > rMax) {
+	vector<double> r(3 * (size_t)atoms->getSize());
+	for (int i = 0; i < atoms->getSize(); i++) {
+		vector<double> p = atoms->getPos(i);
+		for (int k = 0; k < 3; k++) {
+			r[3 * (size_t)i + k] = p[k];
+		}
+	}
+	update(r, atoms->getBox());
+}
+
+void AnalysisTools::RadDistribFunc::update(const vector<double>& r,
+	const boxT& box) {
+	update(r.data(), box);
+}
+
+// The pairs are found with the minimum image convention
+void AnalysisTools::RadDistribFunc::update(const double* r, const boxT& box) {
+	int n = nAtoms;
+	for (int i = 0; i < n - 1; i++) {
+		for (int j = i + 1; j < n; j++) {
+			double d[3];
+			for (int k = 0; k < 3; k++) {
+				d[k] = r[3 * (size_t)j + k] - r[3 * (size_t)i + k];
+			}
+			box.minimumImage(d);
+			double rij = sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+			if (rij >= rMax) {
 				continue;
 			}
-			int index = static_cast<int>( r[i][j] / dr);
+			int index = static_cast<int>(rij / dr);
 			hist[index] += 2;
 		}
 	}
 	nt++;
-	vector<vector<double>>().swap(r);	// Release memory from r
+}
+
+void AnalysisTools::RadDistribFunc::merge(const RadDistribFunc& other) {
+	for (size_t i = 0; i < hist.size(); i++) {
+		hist[i] += other.hist[i];
+	}
+	nt += other.nt;
 }
 
 vector<vector<double>> AnalysisTools::RadDistribFunc::getRDF() {
-	double prefactor = atoms->getSize() * static_cast<double>(nt) 
+	double prefactor = nAtoms * static_cast<double>(nt) 
 		* 4.0 * M_PI * rhoN * pow(dr, 3.0) / 3.0;
 	vector<vector<double>> RDF(hist.size(), vector<double>(2, 0));
 	for (int i = 0; i < hist.size(); i++) {
@@ -110,9 +301,12 @@ AnalysisTools::Diffusion::~Diffusion() {
 
 void AnalysisTools::Diffusion::start(double time) 
 {
+	// The origins are stored by the original index, so they are unaffected
+	// by any later reordering of the atoms
+	op.resize(atoms->getSize());
 	for (int i = 0; i < atoms->getSize(); i++)
 	{
-		op.push_back(atoms->getPos(i));
+		op[atoms->getOriginalIndex(i)] = atoms->getPos(i);
 	}
 	startt = time;
 }
@@ -126,13 +320,261 @@ double AnalysisTools::Diffusion::getDiffu(double time)
 	for (int i = 0; i < atoms->getSize(); i++)
 	{
 		vector<double> np = atoms->getPos(i);
+		vector<double> p0 = op[atoms->getOriginalIndex(i)];
 		double r =  0.0;
 		for (int k = 0; k < 3; k++)
 		{
-			r += pow(np[k] - op[i][k], 2.0);
+			r += pow(np[k] - p0[k], 2.0);
 		}
 		msd += r;
 	}
 	endt = (time - startt);
 	return msd / (6.0 * endt * atoms->getSize());
 }
+
+// The diffusion coefficient of every molecule is found from the mean square
+// displacement of its atoms
+double AnalysisTools::Diffusion::getError()
+{
+	int apm = atoms->getApm();
+	int nM = atoms->getNM();
+	if (op.size() == 0 || nM < 2 || endt <= 0.0)
+	{
+		return 0;
+	}
+	double mean = 0.0, m2 = 0.0;
+	for (int m = 0; m < nM; m++)
+	{
+		double r = 0.0;
+		for (int i = m * apm; i < (m + 1) * apm; i++)
+		{
+			vector<double> np = atoms->getPos(i);
+			vector<double> p0 = op[atoms->getOriginalIndex(i)];
+			for (int k = 0; k < 3; k++)
+			{
+				r += pow(np[k] - p0[k], 2.0);
+			}
+		}
+		double D = r / (6.0 * endt * apm);
+		double dD = D - mean;
+		mean += dD / (m + 1);
+		m2 += dD * (D - mean);
+	}
+	return sqrt(m2 / (nM - 1.0) / nM);
+}
+
+
+// The Nyquist wave number along cell vector a is pi M_a / w_a, where w_a is
+// the width of the box across the planes of the other two vectors
+AnalysisTools::StructureFactor::StructureFactor(Atoms* a, dataT* d) {
+	const boxT& box = a->getBox();
+	double wMax = 0.0;
+	kMax = 0.0;
+	for (int k = 0; k < 3; k++) {
+		double w = box.getWidth(k);
+		M[k] = FFT3D::nextPowerOfTwo(static_cast<int>(
+			ceil(2.0 * d->sqKMax * w / M_PI)));
+		double kHalf = 0.5 * M_PI * M[k] / w;
+		kMax = k == 0 ? kHalf : fmin(kMax, kHalf);
+		wMax = fmax(wMax, w);
+	}
+	kMax = fmin(kMax, d->sqKMax);
+	// The shells are as wide as the smallest spacing of the k-vectors, and
+	// only whole shells are averaged
+	dk = 2.0 * M_PI / wMax;
+	int nShells = max(1, static_cast<int>(kMax / dk));
+	kMax = fmin(kMax, nShells * dk);
+	sum.assign(nShells, 0.0);
+	count.assign(nShells, 0);
+	fft = new FFT3D(M[0], M[1], M[2]);
+	density.resize((size_t)M[0] * M[1] * M[2]);
+	grid.resize(density.size());
+	cout << "S(k) grid: " << M[0] << "x" << M[1] << "x" << M[2]
+		<< ", k up to " << kMax << endl;
+}
+
+AnalysisTools::StructureFactor::~StructureFactor() {
+	delete fft;
+}
+
+// Each atom adds the products of its linear weights to the 8 grid points
+// around it. The k-vector of the grid index m is 2 pi m h^-1, and the shot
+// noise of the assignment is prod_a (1 - 2/3 sin^2(pi m_a / M_a)).
+void AnalysisTools::StructureFactor::update(const vector<double>& r,
+	const boxT& box) {
+	int n = static_cast<int>(r.size() / 3);
+	int gridSize = static_cast<int>(density.size());
+	fill(density.begin(), density.end(), 0.0);
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < n; i++) {
+		double s[3];
+		box.toFractional(&r[3 * (size_t)i], s);
+		int i0[3];
+		double f[3];
+		for (int k = 0; k < 3; k++) {
+			double u = (s[k] - floor(s[k])) * M[k];
+			i0[k] = static_cast<int>(u);
+			f[k] = u - i0[k];
+		}
+		for (int c = 0; c < 8; c++) {
+			double w = 1.0;
+			int idx = 0;
+			for (int k = 0; k < 3; k++) {
+				int up = (c >> (2 - k)) & 1;
+				w *= up ? f[k] : 1.0 - f[k];
+				idx = idx * M[k] + (i0[k] + up) % M[k];
+			}
+			#pragma omp atomic
+			density[idx] += w;
+		}
+	}
+	#pragma omp parallel for schedule(static)
+	for (int idx = 0; idx < gridSize; idx++) {
+		grid[idx] = complex<double>(density[idx], 0.0);
+	}
+	fft->forward(grid);
+
+	int nShells = static_cast<int>(sum.size());
+	int nThreads = 1;
+#ifdef _OPENMP
+	nThreads = omp_get_max_threads();
+#endif
+	vector<vector<double>> threadSum(nThreads, vector<double>(nShells, 0.0));
+	vector<vector<long long>> threadCount(nThreads,
+		vector<long long>(nShells, 0));
+	#pragma omp parallel
+	{
+		int t = 0;
+#ifdef _OPENMP
+		t = omp_get_thread_num();
+#endif
+		#pragma omp for schedule(static)
+		for (int idx = 1; idx < gridSize; idx++) {
+			int g[3] = { idx / (M[1] * M[2]), (idx / M[2]) % M[1],
+				idx % M[2] };
+			double m[3], C = 1.0;
+			for (int a = 0; a < 3; a++) {
+				m[a] = g[a] <= M[a] / 2 ? g[a] : g[a] - M[a];
+				double sn = sin(M_PI * m[a] / M[a]);
+				C *= 1.0 - 2.0 / 3.0 * sn * sn;
+			}
+			double kv[3];
+			for (int b = 0; b < 3; b++) {
+				kv[b] = 2.0 * M_PI * (m[0] * box.hInv[0][b]
+					+ m[1] * box.hInv[1][b] + m[2] * box.hInv[2][b]);
+			}
+			double k = sqrt(kv[0] * kv[0] + kv[1] * kv[1] + kv[2] * kv[2]);
+			if (k >= kMax) continue;
+			int shell = static_cast<int>(k / dk);
+			threadSum[t][shell] += norm(grid[idx]) / C / n;
+			threadCount[t][shell]++;
+		}
+	}
+	for (int t = 0; t < nThreads; t++) {
+		for (int b = 0; b < nShells; b++) {
+			sum[b] += threadSum[t][b];
+			count[b] += threadCount[t][b];
+		}
+	}
+}
+
+// The |k| of a shell is the middle of the shell
+vector<vector<double>> AnalysisTools::StructureFactor::getSk() {
+	vector<vector<double>> Sk;
+	for (int b = 0; b < static_cast<int>(sum.size()); b++) {
+		if (count[b] == 0) continue;
+		Sk.push_back({ (b + 0.5) * dk, sum[b] / count[b] });
+	}
+	return Sk;
+}
+
+
+// The tail correction is N^2 / V times a constant, so an inserted atom
+// changes it by 2 N / V times the constant
+AnalysisTools::WidomInsertion::WidomInsertion(Atoms* a, Potential* p,
+	dataT* d)
+	: rng(static_cast<uint64_t>(d->seed))
+{
+	pot = p;
+	apm = a->getApm();
+	nInsertions = max(1, d->widomInsertions);
+	T = d->T_s;
+	double N = a->getSize();
+	tail = pot->getEnergyCorrection() * a->getBox().getVolume() / (N * N);
+	if (a->hasCharges()) {
+		cout << "The Widom insertions leave out the electrostatics" << endl;
+	}
+
+	ghost.assign(3 * (size_t)apm, 0.0);
+	double C[3] = { 0.0, 0.0, 0.0 };
+	for (int i = 0; i < 3 * apm; i++) {
+		ghost[i] = d->pos[i] / d->sigma;
+		C[i % 3] += ghost[i] / apm;
+	}
+	for (int i = 0; i < 3 * apm; i++) {
+		ghost[i] -= C[i % 3];
+	}
+	for (int i = 0; i < apm; i++) {
+		ghostTypes.push_back(a->getType(i));
+	}
+}
+
+// The atoms are binned into a grid of cells as wide as the cut-off, which is
+// only read by the insertions. Every insertion has its own counter for the
+// random numbers, so the result doesn't depend on the number of threads.
+void AnalysisTools::WidomInsertion::update(const vector<double>& r,
+	const vector<int>& types, const boxT& box) {
+	int N = static_cast<int>(r.size() / 3);
+	double r_c = pot->getCutoff();
+	CellGrid grid(box, r_c);
+	for (int j = 0; j < N; j++) {
+		grid.add(j, &r[3 * (size_t)j]);
+	}
+
+	double V = box.getVolume();
+	double dUtail = 2.0 * apm * tail * N / V;
+	double sum = 0.0;
+	#pragma omp parallel for schedule(dynamic, 16) reduction(+:sum)
+	for (int i = 0; i < nInsertions; i++) {
+		// A uniform position, and a uniform rotation
+		double u[4], rot[3][3];
+		rng.uniform(i, 2 * frame, CounterRNG::WIDOM, u);
+		rng.rotation(i, 2 * frame + 1, CounterRNG::WIDOM, rot);
+		double R[3];
+		box.toCartesian(u, R);
+
+		double dU = dUtail;
+		for (int a = 0; a < apm; a++) {
+			double p[3];
+			for (int k = 0; k < 3; k++) {
+				p[k] = R[k] + rot[k][0] * ghost[3 * a] + rot[k][1]
+					* ghost[3 * a + 1] + rot[k][2] * ghost[3 * a + 2];
+			}
+			for (int cell : grid.getCellsAround(grid.getCellIndex(p))) {
+				for (int j : grid.getPoints(cell)) {
+					double d[3];
+					for (int k = 0; k < 3; k++) {
+						d[k] = p[k] - r[3 * (size_t)j + k];
+					}
+					box.minimumImage(d);
+					double rr = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+					if (r_c != 0.0 && rr >= r_c * r_c) continue;
+					dU += pot->getPairEnergy(ghostTypes[a], types[j], sqrt(rr));
+				}
+			}
+		}
+		sum += exp(-dU / T);
+	}
+	frame++;
+	Vw.addPoint(V * sum / nInsertions);
+	sumV += V;
+}
+
+double AnalysisTools::WidomInsertion::getChemicalPotential() {
+	return -T * log(Vw.getMean() * frame / sumV);
+}
+
+// The error of the logarithm follows from the relative error of the mean
+double AnalysisTools::WidomInsertion::getError() {
+	return T * Vw.getError() / Vw.getMean();
+}
@@ -1,7 +1,11 @@
 #ifndef _analysistools_h
 #define _analysistools_h
 #include <vector>
+#include <complex>
 #include "Atoms.h"
+#include "FFT.h"
+#include "Potential.h"
+#include "Random.h"
 #include "dataType.h"
 
 
@@ -9,7 +13,8 @@
 class AnalysisTools
 {
 public:
-	// A linear regression class
+	// A linear regression class. The means and the co-moments are updated
+	// with Welford's algorithm, so long series don't lose precision.
 	class LinearRegressor
 	{
 	public:
@@ -26,11 +31,88 @@ public:
 		void printSums();
 
 	private:
-		double sumX = 0;	// sum of x
-		double sumXX = 0;	// sum of x * x
-		double sumXY = 0;	// sum of x * y
-		double sumY = 0;	// sum of y
-		int elements = 0;	// the number of points in the regression
+		double meanX = 0;	// mean of x
+		double meanY = 0;	// mean of y
+		double coXX = 0;	// sum of (x - mean x)^2
+		double coXY = 0;	// sum of (x - mean x) * (y - mean y)
+		long long elements = 0;	// the number of points in the regression
+	};
+
+
+	// Streaming block averaging of a correlated time series (Flyvbjerg and
+	// Petersen, J. Chem. Phys. 91, 461). The series is blocked repeatedly by
+	// averaging pairs of neighbouring blocks, and the mean and variance of
+	// every blocking level are accumulated with Welford's algorithm, so only
+	// O(log n) numbers are kept. The standard error grows with the block size,
+	// until the blocks are longer than the correlation time, where it reaches
+	// a plateau.
+	class BlockAverage
+	{
+	public:
+		// Constructor
+		BlockAverage();
+
+		// Add a sample to the series
+		void addPoint(double x);
+		// Get the mean of all the samples
+		double getMean();
+		// Get the standard error of the mean at the plateau. Without a
+		// plateau it's the largest error of the levels with enough blocks,
+		// which is a lower bound.
+		double getError();
+		// Has the error reached a plateau?
+		bool isConverged();
+		// Get the number of samples
+		long long getSamples();
+
+	private:
+		// A blocking level with blocks of 2^level samples
+		struct levelT {
+			long long n = 0;		// Number of blocks
+			double mean = 0;		// Mean of the blocks
+			double m2 = 0;			// Sum of squared deviations from the mean
+			bool hasPending = false;	// Is a block waiting for its pair?
+			double pending = 0;		// The block waiting for its pair
+		};
+
+		static const int minBlocks = 32;	// Blocks for a usable level
+		vector<levelT> levels;
+
+		// Add a block to a level, and pass the pairs on to the next level
+		void addBlock(int level, double x);
+		// Get the standard error of the mean from a level
+		double getLevelError(int level);
+		// Get the first level of the plateau (-1 if there is none)
+		int findPlateau();
+	};
+
+
+	// Detection of the end of the equilibration by the marginal standard
+	// error rule (MSER-5, White, Simulation 69, 323). The samples of every
+	// series are averaged in batches of five, and the truncation point is the
+	// number of leading batches, which minimizes the squared standard error
+	// of the remaining batch means. A series is stationary, when the
+	// truncation point is in the first half of the series.
+	class EquilibrationDetector
+	{
+	public:
+		// Constructor takes the number of series to watch
+		EquilibrationDetector(int nSeries);
+
+		// Add a sample of every series
+		void addPoint(const vector<double>& x);
+		// Are all the series stationary after their truncation points?
+		bool isEquilibrated();
+		// Get the truncation point of series s in samples
+		int getTruncation(int s);
+
+	private:
+		static const int batchSize = 5;		// Samples per batch
+		static const int minBatches = 20;	// Batches before any decision
+		int nSeries;						// Number of series
+		vector<vector<double>> batchMeans;	// Batch means of every series
+		vector<double> batchSum;			// Sums of the current batch
+		int inBatch = 0;					// Samples in the current batch
 	};
 
 
@@ -40,23 +122,106 @@ public:
 	public:
 		// Constructor
 		RadDistribFunc(Atoms* atoms, dataT* data);
+		// Constructor without the atoms for n atoms at the number density
+		// rhoN up to rMax, so stored frames can be analysed. Only the update
+		// with a snapshot can be used.
+		RadDistribFunc(int n, double rhoN, double rMax,
+			double binWidth = defaultBinWidth);
 		// Destructor
 		~RadDistribFunc();
 		// Build histogram
 		void update();
+		// Build histogram from a snapshot of the positions (x, y, z of the
+		// atoms after each other) in the box, so it doesn't read the atoms
+		void update(const vector<double>& r, const boxT& box);
+		void update(const double* r, const boxT& box);
+		// Add the histogram of another one with the same bins, so frames can
+		// be binned in parallel
+		void merge(const RadDistribFunc& other);
 		// Get radial distribution function
 		vector<vector<double>> getRDF();
 
+		static constexpr double defaultBinWidth = 0.02;	// Reduced
+
 	private:
 		double dr;			// Delta r is the size of a bin
 		int nt = 0;				// Counter for number of recorded configs. 
-		vector<int> hist;	// Histogram
+		vector<long long> hist;	// Histogram
 		double rhoN;		// Number density
-		Atoms* atoms;
+		Atoms* atoms = nullptr;
+		int nAtoms;
 		double rMax;
 	};
 
 
+	// Static structure factor S(k) = <|rho(k)|^2> / N on the reciprocal
+	// lattice of the box. The atoms are binned on a grid with cloud-in-cell
+	// weights, so rho(k) of all the k-vectors comes from one FFT, and the
+	// shot noise of the assignment is divided out (Jing, ApJ 620, 559). S(k)
+	// is averaged over spherical shells of |k| up to half the Nyquist wave
+	// number, where the aliasing is small.
+	class StructureFactor
+	{
+	public:
+		// Constructor chooses the grid, so it reaches the largest |k| of the
+		// data along every cell vector
+		StructureFactor(Atoms* atoms, dataT* data);
+		// Destructor
+		~StructureFactor();
+		// Add the structure factor of a snapshot of the positions (x, y, z of
+		// the atoms after each other) in the box
+		void update(const vector<double>& r, const boxT& box);
+		// Get the spherical average as (|k|, S(k)) of the non-empty shells
+		vector<vector<double>> getSk();
+
+	private:
+		int M[3];						// Grid points along each cell vector
+		FFT3D* fft;
+		vector<double> density;			// The binned atoms
+		vector<complex<double>> grid;	// The transformed density
+		double dk;						// Width of a shell
+		double kMax;					// The largest |k| in the average
+		vector<double> sum;				// Sum of S(k) of every shell
+		vector<long long> count;		// k-vectors added to every shell
+	};
+
+
+	// Excess chemical potential by Widom test particle insertion,
+	// mu_ex = -T ln(<V exp(-dU / T)> / <V>), where dU is the energy of a
+	// ghost molecule at a random position and orientation. The ghost has the
+	// geometry of the molecule in the input (pos), and its energy is summed
+	// over the atoms in the neighbouring cells of a grid with cells of at
+	// least the cut-off, plus the change of the tail correction. The
+	// insertions of a frame run in parallel (OpenMP).
+	class WidomInsertion
+	{
+	public:
+		// Constructor takes the pair energies and the cut-off from the
+		// Potential, which is only read
+		WidomInsertion(Atoms* atoms, Potential* pot, dataT* data);
+		// Insert the ghosts into a snapshot of the positions (x, y, z of the
+		// atoms after each other) with the types of the atoms in the box
+		void update(const vector<double>& r, const vector<int>& types,
+			const boxT& box);
+		// Get the excess chemical potential and its standard error (reduced)
+		double getChemicalPotential();
+		double getError();
+
+	private:
+		Potential* pot;
+		int apm;
+		int nInsertions;				// Insertions per frame
+		double T;						// The reduced temperature
+		vector<double> ghost;			// The ghost relative to its center
+		vector<int> ghostTypes;			// The types of the ghost atoms
+		double tail;					// Tail correction * V / N^2
+		uint64_t frame = 0;				// The number of frames so far
+		CounterRNG rng;
+		BlockAverage Vw;				// V times the mean Boltzmann factor
+		double sumV = 0.0;				// Sum of the volumes of the frames
+	};
+
+
 	// Self-diffussion Coefficient
 	class Diffusion
 	{
@@ -69,6 +234,9 @@ public:
 		void start(double time);
 		// Get diffusion coefficients
 		double getDiffu(double time);
+		// Get the standard error of the last diffusion coefficient from the
+		// spread of the molecules, which move independently
+		double getError();
 	private:
 		Atoms* atoms;
 		dataT* data;
@@ -0,0 +1,86 @@
+#include "Arena.h"
+#include <iostream>
+#include <cstdlib>
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+using namespace std;
+
+bool Arena::hugePages = false;
+
+Arena::Arena(size_t bytes) {
+	capacity = bytes;
+	if (capacity == 0) return;
+	size_t align = alignment;
+	if (hugePages) {
+		// Whole huge pages, so the block can be backed by them
+		align = hugePageSize;
+		capacity = (capacity + hugePageSize - 1) / hugePageSize * hugePageSize;
+	}
+#ifdef _WIN32
+	block = static_cast<char*>(_aligned_malloc(capacity, align));
+#else
+	void* p = nullptr;
+	if (posix_memalign(&p, align, capacity) != 0) {
+		p = nullptr;
+	}
+	block = static_cast<char*>(p);
+#ifdef MADV_HUGEPAGE
+	if (hugePages && block != nullptr) {
+		madvise(block, capacity, MADV_HUGEPAGE);
+	}
+#endif
+#endif
+	if (block == nullptr) {
+		cout << "Couldn't allocate " << capacity << " bytes for the arrays"
+			<< endl;
+		exit(-1);
+	}
+}
+
+Arena::~Arena() {
+#ifdef _WIN32
+	_aligned_free(block);
+#else
+	free(block);
+#endif
+}
+
+// The array is zeroed by the threads in the same static partition of the
+// items as the loops, which use it. The pages aren't touched before, since
+// the block is only reserved.
+double* Arena::allocate(size_t n, int stride) {
+	size_t bytes = getBytes(n);
+	if (used + bytes > capacity) {
+		return nullptr;
+	}
+	double* a = reinterpret_cast<double*>(block + used);
+	used += bytes;
+	int items = static_cast<int>(n / stride);
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < items; i++) {
+		for (int k = 0; k < stride; k++) {
+			a[(size_t)i * stride + k] = 0.0;
+		}
+	}
+	for (size_t j = (size_t)items * stride; j < n; j++) {
+		a[j] = 0.0;
+	}
+	return a;
+}
+
+void Arena::reset() {
+	used = 0;
+}
+
+// Every array is padded to a whole number of cache lines
+size_t Arena::getBytes(size_t n) {
+	return (n * sizeof(double) + alignment - 1) / alignment * alignment;
+}
+
+void Arena::setHugePages(bool on) {
+	hugePages = on;
+}
@@ -0,0 +1,48 @@
+#ifndef _arena_h
+#define _arena_h
+
+#include <cstddef>
+
+// A block of memory, which the per-atom and per-step arrays are carved from.
+// Every array starts on a 64-byte cache line, so no two threads share a line
+// at the borders of their parts, and the arrays can be loaded with aligned
+// vector instructions. The pages of an array are touched first by the
+// threads, which use them in the loops with a static schedule, so on a
+// NUMA machine they are placed in the memory of those threads (when the
+// threads are pinned, e.g. with OMP_PROC_BIND). With huge pages the block is
+// aligned to 2 MB and advised to use transparent huge pages, which reduces
+// the TLB misses (Linux only).
+class Arena
+{
+public:
+	// Constructor reserves a block of the given number of bytes
+	Arena(size_t bytes);
+	// Destructor releases the block with all its arrays
+	virtual ~Arena();
+
+	// Get a zeroed array of n doubles, which is first touched in parallel
+	// over items of 'stride' doubles with a static schedule. Returns nullptr,
+	// if the block is full.
+	double* allocate(size_t n, int stride = 1);
+	// Release all the arrays, so the block can be reused
+	void reset();
+	// Get the number of bytes, which an array of n doubles takes up
+	static size_t getBytes(size_t n);
+	// Turn transparent huge pages on or off for the following arenas
+	static void setHugePages(bool on);
+
+	static const size_t alignment = 64;				// Cache line size
+	static const size_t hugePageSize = 2 << 20;		// 2 MB
+
+private:
+	char* block = nullptr;	// The memory block
+	size_t capacity = 0;	// The size of the block in bytes
+	size_t used = 0;		// The bytes given out
+	static bool hugePages;	// Use transparent huge pages?
+
+	// Copy of an arena would free the block twice
+	Arena(const Arena&);
+	Arena& operator=(const Arena&);
+};
+
+#endif // !_arena_h
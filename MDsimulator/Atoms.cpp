@@ -2,27 +2,31 @@
 #include <iostream>
 #include "dataType.h"
 
-// The constructor initializes the position and velocity vectors and the
-// distance matrix to the right size
+// The constructor initializes the position and velocity vectors to the right
+// size
 Atoms::Atoms(int natoms, double m)
-	: pos(natoms, vector<double>(3, 0)),
-	vel(natoms, vector<double>(3, 0)),
-	distances(natoms, vector<double>(natoms, 0)),
+	: originalIndex(natoms, 0),
+	types(natoms, 0),
+	masses{ 1.0 },
 	reducedBondMatrix(natoms, vector<int>(natoms, 0)),
-	bondTypes{}
+	bondTypes{},
+	charges{}
 {
 	// Initialize the number of atoms and the cell size
+	nAtoms = 0;
+	allocate(natoms);
 	nAtoms = natoms;
-	cellLength = 0.0;
+	box.ctor(0.0, 0.0, 0.0);
 	mass = m;
 	apm = natoms;
+	for (int i = 0; i < natoms; i++) {
+		originalIndex[i] = i;
+	}
 }
 
 // The destructor deletes the memory of the position and velocity vectors
 Atoms::~Atoms() {
-	vector<vector<double>>().swap(pos);
-	vector<vector<double>>().swap(vel);
-	vector<vector<double>>().swap(distances);
+	delete arena;
 	vector<vector<int>>().swap(reducedBondMatrix);
 }
 
@@ -31,10 +35,10 @@ void Atoms::print() {
 	// Create average vector
 	vector<double> R = { 0.0, 0.0, 0.0 };
 	// Run through all positions
-	for (vector<double> p : pos) {
+	for (int j = 0; j < nAtoms; j++) {
 		for (int i = 0; i < 3; i++) {
-			R[i] += p[i];
-			cout << p[i] << ", ";
+			R[i] += pos[3 * (size_t)j + i];
+			cout << pos[3 * (size_t)j + i] << ", ";
 		}
 		cout << endl;
 	}
@@ -51,10 +55,10 @@ void Atoms::printVel() {
 	// Create average vector
 	vector<double> av = { 0.0, 0.0, 0.0 };
 	// Run through all velocities
-	for (vector<double> v : vel) {
+	for (int j = 0; j < nAtoms; j++) {
 		for (int i = 0; i < 3; i++) {
-			av[i] += v[i];
-			cout << v[i] << ", ";
+			av[i] += vel[3 * (size_t)j + i];
+			cout << vel[3 * (size_t)j + i] << ", ";
 		}
 		cout << "\n";
 	}
@@ -66,69 +70,26 @@ void Atoms::printVel() {
 	cout << endl;
 }
 
-// Helper function for printing the distance matrix to the console
-void Atoms::printDistances() {
-	if (positionsChanged) {
-		distances = this->getDistances();
-	}
-	for (vector<double> p : distances) {
-		for (double d : p) {
-			cout << d << ", ";
-		}
-		cout << "\n";
-	}
-}
-
-// The getDistances() function calculates all interatomic distances with
-// periodic boundary conditions and returns these. The calculation is only
-// performed, if the atomic positions have changed
-vector<vector<double>> Atoms::getDistances() {
-	// Don't recalculate, if the positions are the same
-	if (!positionsChanged) {
-		return distances;
-	}
-
-	// Run through each pair and calculate the distances
-	for (int i = 0; i < nAtoms - 1; i++) {
-		for (int j = i + 1; j < nAtoms; j++) {
-			double r = 0.0;  // distance
-			for (int k = 0; k < 3; k++) {
-				double diff = pos[i][k] - pos[j][k];
-				// Periodic Boundary Condition distance
-				double pbc_dist = diff - cellLength	* round(diff / cellLength);
-				// square the cartesian distance
-				r += pbc_dist * pbc_dist;
-			}
-			r = pow(r, 0.5);  // euclidean space r = (x^2 + y^2 + z^2)^(1/2)
-			// Add the distance to both sides of the matrix
-			distances[i][j] = r;
-			distances[j][i] = r;
-		}
-	}
-	// The positions are now not changed
-	positionsChanged = false;
-	return distances;
-}
-
 // The center() function makes the average position of all the atoms (0, 0, 0)
 void Atoms::center() {
 	vector<double> R = { 0.0, 0.0, 0.0 };
 	double M = 0;
 	// find the center of mass (COM)
-	for (vector<double> p : pos) {
+	for (int j = 0; j < nAtoms; j++) {
 		for (int i = 0; i < 3; i++) {
-			R[i] += mass * p[i];
+			R[i] += getMass(j) * pos[3 * (size_t)j + i];
 		}
-		M += mass;
+		M += getMass(j);
 	}
 	for (int i = 0; i < 3; i++) {
 		R[i] /= M;
 	}
 
 	// Adjust all positions, so they lie around COM
-	for (vector<double> &p : pos) {
+	#pragma omp parallel for schedule(static)
+	for (int j = 0; j < nAtoms; j++) {
 		for (int i = 0; i < 3; i++)	{
-			p[i] -= R[i];
+			pos[3 * (size_t)j + i] -= R[i];
 		}
 	}
 }
@@ -138,20 +99,21 @@ void Atoms::centerVel() {
 	vector<double> av = { 0.0, 0.0, 0.0 };
 	double M = 0.0;
 	// Find the mass-weigthed center of velocity (COV)
-	for (vector<double> v : vel) {
+	for (int j = 0; j < nAtoms; j++) {
 		for (int i = 0; i < 3; i++)	{
-			av[i] += mass * v[i];
+			av[i] += getMass(j) * vel[3 * (size_t)j + i];
 		}
-		M += mass;
+		M += getMass(j);
 	}
 	for (int i = 0; i < 3; i++) {
 		av[i] /= M;
 	}
 
 	// Adjust all velocities, so they lie around COV
-	for (vector<double> &v : vel) {
+	#pragma omp parallel for schedule(static)
+	for (int j = 0; j < nAtoms; j++) {
 		for (int i = 0; i < 3; i++)	{
-			v[i] -= av[i];
+			vel[3 * (size_t)j + i] -= av[i];
 		}
 	}
 }
@@ -172,9 +134,9 @@ int Atoms::getNM() {
 	return nAtoms / apm;
 }
 
-// Simple getter for the cell size
-double Atoms::getCellLength() {
-	return cellLength;
+// Simple getter for the cell
+const boxT& Atoms::getBox() {
+	return box;
 }
 
 // Simple getter for the mass
@@ -182,30 +144,90 @@ double Atoms::getMass() {
 	return mass;
 }
 
+// The mass of an atom is the mass of its type
+double Atoms::getMass(int i) {
+	return masses[types[i]];
+}
+
+double Atoms::getTotalMass() {
+	double M = 0.0;
+	for (int i = 0; i < nAtoms; i++) {
+		M += getMass(i);
+	}
+	return M;
+}
+
+int Atoms::getType(int i) {
+	return types[i];
+}
+
+int Atoms::getNumberOfTypes() {
+	return static_cast<int>(masses.size());
+}
+
 // Getter for the position vector of atom i
 vector<double> Atoms::getPos(int i) {
-	return pos[i];
+	return vector<double>(pos + 3 * (size_t)i, pos + 3 * (size_t)i + 3);
 }
 
 // Getter for the velocity vector of atom i
 vector<double> Atoms::getVel(int i) {
-	return vel[i];
+	return vector<double>(vel + 3 * (size_t)i, vel + 3 * (size_t)i + 3);
+}
+
+const double* Atoms::getPositions() {
+	return pos;
+}
+
+double* Atoms::getVelocities() {
+	return vel;
+}
+
+// The center of mass of a molecule (repeated unit)
+vector<double> Atoms::getMoleculeCenter(int m) {
+	vector<double> R = { 0.0, 0.0, 0.0 };
+	double M = 0.0;
+	for (int i = m * apm; i < (m + 1) * apm; i++) {
+		for (int k = 0; k < 3; k++) {
+			R[k] += getMass(i) * pos[3 * (size_t)i + k];
+		}
+		M += getMass(i);
+	}
+	for (int k = 0; k < 3; k++) {
+		R[k] /= M;
+	}
+	return R;
 }
 
 // The getEnergy() function returns the kinetic energy of all the atoms
 double Atoms::getEnergy() {
 	double K = 0.0;
-	// Run over all cartesian coordinates of the atoms and add the velocity
-	// squared to the kinetic energy
-	for (vector<double> v : vel) {
-		for (double vj : v) {
-			K += vj * vj;
+	// Run over all cartesian coordinates of the atoms and add the mass times
+	// the velocity squared to the kinetic energy
+	for (int i = 0; i < nAtoms; i++) {
+		for (int k = 0; k < 3; k++) {
+			double vj = vel[3 * (size_t)i + k];
+			K += getMass(i) * vj * vj;
 		}
 	}
 	// Multiply by the factor of a half
 	return K / 2.0;
 }
 
+// The kinetic part of the pressure tensor. The trace is twice the energy.
+vector<vector<double>> Atoms::getKineticTensor() {
+	vector<vector<double>> T(3, vector<double>(3, 0));
+	for (int i = 0; i < nAtoms; i++) {
+		for (int a = 0; a < 3; a++) {
+			for (int b = 0; b < 3; b++) {
+				T[a][b] += getMass(i) * vel[3 * (size_t)i + a]
+					* vel[3 * (size_t)i + b];
+			}
+		}
+	}
+	return T;
+}
+
 // Only works if the atoms are not bonded in between the subcells
 bool Atoms::isBonded(int i, int j) {
 	int col_i = static_cast<int>(i / apm);
@@ -224,17 +246,34 @@ bool Atoms::isBonded(int i, int j) {
 double Atoms::getBondEnergy(int i, int j) {
 	if (!isBonded(i, j)) return 0.0;
 	bondT b = getBond(i, j);
-	return b.getEnergy(distances[i][j]);
+	return b.getEnergy(getBondLength(i, j));
 }
 
 vector<double> Atoms::getBondForce(int i, int j) {
 	if (!isBonded(i, j)) return { 0.0, 0.0, 0.0 };
 	bondT b = getBond(i, j);
-	return b.getForce(distances[i][j], pos[i], pos[j]);
+	return b.getForce(getBondLength(i, j), getPos(i), getPos(j));
+}
+
+// The charges are stored for the repeated unit, like the bonds
+double Atoms::getCharge(int i) {
+	if (charges.size() == 0) return 0.0;
+	return charges[i % apm];
+}
+
+bool Atoms::hasCharges() {
+	for (double q : charges) {
+		if (q != 0.0) return true;
+	}
+	return false;
+}
+
+unsigned long long Atoms::getPositionVersion() {
+	return positionVersion;
 }
 
-bool Atoms::hasChangedPositions() {
-	return positionsChanged;
+int Atoms::getOriginalIndex(int i) {
+	return originalIndex[i];
 }
 
 // Casts the indexes into the reduced matrix
@@ -245,22 +284,87 @@ bondT Atoms::getBond(int i, int j) {
 	return bondTypes[mIdx];
 }
 
+double Atoms::getBondLength(int i, int j) {
+	double r = 0.0;
+	for (int k = 0; k < 3; k++) {
+		double d = pos[3 * (size_t)i + k] - pos[3 * (size_t)j + k];
+		r += d * d;
+	}
+	return pow(r, 0.5);
+}
+
 // Setter for the position vector of atom i
 void Atoms::setPos(int i, vector<double> r) {
-	positionsChanged = true;
-	pos[i] = r;
+	positionVersion++;
+	for (int k = 0; k < 3; k++) {
+		pos[3 * (size_t)i + k] = r[k];
+	}
+}
+
+// The atoms of a molecule are moved to the periodic image closest to its
+// first atom, as the bonds are calculated without the minimum image
+void Atoms::setPositions(const vector<double>& r) {
+	#pragma omp parallel for schedule(static)
+	for (int m = 0; m < getNM(); m++) {
+		int first = m * apm;
+		for (int i = first; i < first + apm; i++) {
+			double d[3];
+			for (int k = 0; k < 3; k++) {
+				d[k] = r[3 * (size_t)i + k] - r[3 * (size_t)first + k];
+			}
+			if (box.getVolume() > 0.0) {
+				box.minimumImage(d);
+			}
+			for (int k = 0; k < 3; k++) {
+				pos[3 * (size_t)i + k] = r[3 * (size_t)first + k] + d[k];
+			}
+		}
+	}
+	positionVersion++;
 }
 
 // Setter for the velocity vector of atom i
 void Atoms::setVel(int i, vector<double> r) {
-	vel[i] = r;
+	for (int k = 0; k < 3; k++) {
+		vel[3 * (size_t)i + k] = r[k];
+	}
 }
 
 // Setter for the cell size
 void Atoms::setCellLength(double length) {
 	// Ensure that the length is a positive number
 	if (length > 0.0) {
-		cellLength = length;
+		box.ctor(length, length, length);
+		positionVersion++;
+	}
+}
+
+// The minimum images change with the box
+void Atoms::setBox(const boxT& b) {
+	box = b;
+	positionVersion++;
+}
+
+// The molecules are translated as rigid units, so the centers are scaled
+// while the bonds keep their lengths.
+void Atoms::rescale(double mu) {
+	for (int m = 0; m < getNM(); m++) {
+		vector<double> R = getMoleculeCenter(m);
+		for (int i = m * apm; i < (m + 1) * apm; i++) {
+			for (int k = 0; k < 3; k++) {
+				pos[3 * (size_t)i + k] += (mu - 1.0) * R[k];
+			}
+		}
+	}
+	box.scale(mu);
+	positionVersion++;
+}
+
+void Atoms::scaleVelocities(double f) {
+	int n = 3 * getSize();
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < n; i++) {
+		vel[i] *= f;
 	}
 }
 
@@ -293,28 +397,40 @@ void Atoms::setBonds(vector<int> bonds, vector<double> ks, vector<double> r_es)
 	}
 }
 
-// Repeat the atoms object in the 3 cartesian direction, resulting in a
-// NxNxN times bigger object.
+void Atoms::setCharges(vector<double> q) {
+	charges = q;
+}
+
+// Every molecule gets the types of the repeated unit
+void Atoms::setTypes(vector<int> t, vector<double> typeMasses) {
+	masses = typeMasses;
+	for (int i = 0; i < nAtoms; i++) {
+		types[i] = t[i % apm];
+	}
+}
+
+void Atoms::setType(int i, int t) {
+	types[i] = t;
+}
+
+// Repeat the atoms object along the 3 cell vectors, resulting in a
+// NxNxN times bigger object. Replica c = (x * N + y) * N + z is the block of
+// atoms from c * size, so the replicas are written in parallel straight into
+// the arrays.
 void Atoms::repeat(int N) {
 	if (N == 1) return;
 	int size = nAtoms;
-	int new_nMols = size / apm * N * N * N;
 	resize(size / apm * N * N * N);
-	int index = size;
-	for (int x = 0; x < N; x++) {
-		for (int y = 0; y < N; y++) {
-			for (int z = 0; z < N; z++) {
-				if (x + y + z == 0) continue;
-				for (int i = 0; i < size; i++) {
-					vector<double> p = pos[i];
-					vector<double> t = {x * cellLength,
-						y * cellLength, z * cellLength };
-					for (int k = 0; k < 3; k++) {
-						p[k] += t[k];
-					}
-					pos[index] = p;
-					index++;
-				}
+	int replicas = N * N * N;
+	#pragma omp parallel for schedule(static)
+	for (int c = 1; c < replicas; c++) {
+		double s[3] = { double(c / (N * N)), double(c / N % N), double(c % N) };
+		double t[3];
+		box.toCartesian(s, t);
+		size_t first = (size_t)c * size;
+		for (int i = 0; i < size; i++) {
+			for (int k = 0; k < 3; k++) {
+				pos[3 * (first + i) + k] = pos[3 * (size_t)i + k] + t[k];
 			}
 		}
 	}
@@ -323,12 +439,76 @@ void Atoms::repeat(int N) {
 // Resizes the Atoms object and makes sure everything affected is updated
 void Atoms::resize(int nMols) {
 	int new_nAtoms = apm * nMols;
+	allocate(new_nAtoms);
 	nAtoms = new_nAtoms;
-	pos.resize(new_nAtoms, vector<double>(3, 0));
-	vel.resize(new_nAtoms, vector<double>(3, 0));
-	distances.clear();
-	distances.resize(new_nAtoms, vector<double>(new_nAtoms, 0));
-	positionsChanged = true;
+	int oldSize = static_cast<int>(originalIndex.size());
+	originalIndex.resize(new_nAtoms);
+	types.resize(new_nAtoms);
+	// The new molecules are copies of the repeated unit
+	#pragma omp parallel for schedule(static)
+	for (int i = oldSize; i < new_nAtoms; i++) {
+		originalIndex[i] = i;
+		types[i] = types[i % apm];
+	}
+	positionVersion++;
+}
+
+// Reorder the positions, velocities, types and the original indices. The
+// charges and bonds are stored for the repeated unit, so they don't need
+// reordering.
+void Atoms::reorder(const vector<int>& order) {
+	reorderMolecules(pos, order, apm);
+	reorderMolecules(vel, order, apm);
+	vector<int> oldIndex = originalIndex;
+	vector<int> oldTypes = types;
+	for (int m = 0; m < static_cast<int>(order.size()); m++) {
+		for (int j = 0; j < apm; j++) {
+			originalIndex[m * apm + j] = oldIndex[order[m] * apm + j];
+			types[m * apm + j] = oldTypes[order[m] * apm + j];
+		}
+	}
+	positionVersion++;
+}
+
+// The arena is replaced by one of the new size, and the kept atoms are copied
+void Atoms::allocate(int n) {
+	Arena* next = new Arena(2 * Arena::getBytes(3 * (size_t)n));
+	double* nextPos = next->allocate(3 * (size_t)n, 3);
+	double* nextVel = next->allocate(3 * (size_t)n, 3);
+	int kept = n < nAtoms ? n : nAtoms;
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < kept; i++) {
+		for (int k = 0; k < 3; k++) {
+			nextPos[3 * (size_t)i + k] = pos[3 * (size_t)i + k];
+			nextVel[3 * (size_t)i + k] = vel[3 * (size_t)i + k];
+		}
+	}
+	delete arena;
+	arena = next;
+	pos = nextPos;
+	vel = nextVel;
+}
+
+void Atoms::reorderMolecules(double* data, const vector<int>& order,
+	int apm) {
+	size_t n = 3 * order.size() * apm;
+	vector<double> old(data, data + n);
+	#pragma omp parallel for schedule(static)
+	for (int m = 0; m < static_cast<int>(order.size()); m++) {
+		for (int j = 0; j < 3 * apm; j++) {
+			data[3 * (size_t)m * apm + j] = old[3 * (size_t)order[m] * apm + j];
+		}
+	}
+}
+
+void Atoms::reorderMolecules(vector<vector<double>>& data,
+	const vector<int>& order, int apm) {
+	vector<vector<double>> old = data;
+	for (int m = 0; m < static_cast<int>(order.size()); m++) {
+		for (int j = 0; j < apm; j++) {
+			data[m * apm + j] = old[order[m] * apm + j];
+		}
+	}
 }
 
 void Atoms::validateBonds() {
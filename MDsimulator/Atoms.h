@@ -3,12 +3,16 @@
 
 #include <vector>
 #include "bondType.h"
+#include "boxType.h"
+#include "Arena.h"
 
 using namespace std;
 
 // A class that works as a container for single atoms, so can be a representation
 // of any number of atoms and/or molecules. It keeps track of position, velocity
-// and maybe mass at some point.
+// and the type of every atom, which gives its mass. The positions and
+// velocities are contiguous arrays (x, y, z of the atoms after each other) in
+// an aligned arena, which is first touched by the threads that use them.
 class Atoms {
 public:
 	// Constructor and destructor for object. The constructur takes the number of
@@ -21,59 +25,109 @@ public:
 	void center();
 	void centerVel();
 
-	// Functions for printing the positions, velocities and distances to the console
+	// Functions for printing the positions and velocities to the console
 	void print();
 	void printVel();
-	void printDistances();
-
-	// Function for calculating all the interatomic distances
-	vector<vector<double>> getDistances();
 
 	// Getter functions for the object members
 	int getSize();  // Get number of atoms
 	int getApm();  // Get the number of atoms per molecule (initial size)
 	int getNM();  // Get the number of molecules (repeated units)
-	double getCellLength();  // Get the side length of the cell [dimensionless]
-	double getMass();  // Get the mass of the atoms
+	const boxT& getBox();  // Get the periodic cell [dimensionless]
+	double getMass();  // Get the mass of the reference type [amu]
+	double getMass(int i);  // Get the (reduced) mass of atom i
+	double getTotalMass();  // Get the (reduced) mass of all the atoms
+	int getType(int i);  // Get the type index of atom i
+	int getNumberOfTypes();  // Get the number of atom types
 	vector<double> getPos(int i);  // Get the position vector of atom i
 	vector<double> getVel(int i);  // Get the velocity vector of atom i
+	const double* getPositions();  // Get the positions of all the atoms
+	double* getVelocities();  // Get the velocities of all the atoms (writable)
+	vector<double> getMoleculeCenter(int m);  // Get the center of molecule m
 	double getEnergy();  // Get the kinetic energy of all the atoms
+	vector<vector<double>> getKineticTensor();  // Get sum of m * v_a * v_b
 	bool isBonded(int i, int j);  // Are the two atoms bonded?
 	double getBondEnergy(int i, int j);  // Get the bond energy between atom i and j
 	vector<double> getBondForce(int i, int j);  // Get the bond force between atom i and j
-	bool hasChangedPositions();  // Get whether or not the positions have changed
+	double getCharge(int i);  // Get the (reduced) partial charge of atom i
+	bool hasCharges();  // Does any of the atoms carry a partial charge?
+	// Get a counter, which increases every time the positions change
+	unsigned long long getPositionVersion();
+	// Get the index atom i had before any reordering
+	int getOriginalIndex(int i);
 
 	// Setter functions for the object members
 	void setPos(int i, vector<double> r);  // Set the position vector of atom i as r
 	void setVel(int i, vector<double> r);  // Set the velocity vector of atom i as r
-	void setCellLength(double length);  // Set the side length of the cell
+	// Set all the positions from x, y, z of the atoms after each other. The
+	// molecules are made whole, if the periodic boundaries split them.
+	void setPositions(const vector<double>& r);
+	void setCellLength(double length);  // Set a cubic cell with the side length
+	void setBox(const boxT& b);  // Set the periodic cell
+	// Scale the cell and the molecular centers by mu (keeps bond lengths)
+	void rescale(double mu);
+	// Scale all the velocities by f
+	void scaleVelocities(double f);
 	// set all the bonds. Overrides existing bonds
 	void setBonds(vector<int> bonds, vector<double> ks, vector<double> r_es);
+	// Set the partial charges of the atoms in a molecule (repeated unit)
+	void setCharges(vector<double> q);
+	// Set the types of the atoms in a molecule (repeated unit) for all the
+	// molecules, and the reduced mass of every type
+	void setTypes(vector<int> t, vector<double> typeMasses);
+	// Set the type of a single atom
+	void setType(int i, int t);
 
 	// Change the number of molecules in the Atoms object. Please only increase the number.
 	void resize(int newSize);
 
 	void validateBonds();
 
-	// Repeat the unit cell the given number of times in the directions.
+	// Repeat the unit cell the given number of times along the cell vectors.
 	void repeat(int N);
 
+	// Reorder the molecules, so molecule m becomes molecule order[m]. The
+	// atoms of a molecule stay together, so the bonds are unchanged.
+	void reorder(const vector<int>& order);
+	// Apply the same molecule reordering to any per-atom array
+	static void reorderMolecules(vector<vector<double>>& data,
+		const vector<int>& order, int apm);
+	// Apply the molecule reordering to a contiguous array of 3 values per atom
+	static void reorderMolecules(double* data, const vector<int>& order,
+		int apm);
+
 private:
-	// Used for determining when to recalculate distance matrix
-	bool positionsChanged = true;
+	// Increases, whenever the positions change, so results can be cached
+	unsigned long long positionVersion = 0;
 	int nAtoms;  // The number of atoms
 	int apm;  // number of atoms per repeated cell
-	double mass;  // The mass of the atoms
-	double cellLength;  // The side length of the cell
-	vector<vector<double>> pos, vel;  // Position and velocity vectors
-	vector<vector<double>> distances;
+	double mass;  // The mass of the reference type [amu]
+	boxT box;  // The periodic cell
+	Arena* arena = nullptr;  // The memory of the positions and velocities
+	double* pos = nullptr;  // Positions, x, y, z of the atoms after each other
+	double* vel = nullptr;  // Velocities in the same layout
+	vector<int> originalIndex;  // The index before any reordering
+	vector<int> types;  // The type index of every atom
+	vector<double> masses;  // The reduced mass of every type
 
 	// containers for the bonding parameters
 	vector<vector<int>> reducedBondMatrix;
 	vector<bondT> bondTypes;
 
+	// The partial charges of the atoms in the repeated unit
+	vector<double> charges;
+
+	// Move the positions and velocities to an arena for n atoms. The first
+	// atoms are kept, and the new ones are zero.
+	void allocate(int n);
+	// Copy of the atoms would share the arena
+	Atoms(const Atoms&);
+	Atoms& operator=(const Atoms&);
 	// Helper for getting a bond between two of the atoms.
 	bondT getBond(int i, int j);
+	// Helper for the length of a bond. Molecules are never split by the
+	// periodic boundaries, so no minimum image is needed.
+	double getBondLength(int i, int j);
 };
 
 #endif // !_atoms_h
\ No newline at end of file
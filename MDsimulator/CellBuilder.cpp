@@ -1,52 +1,114 @@
 #include "CellBuilder.h"
 #include <iostream>
 #include <cmath>
+#include <algorithm>
 #include "math.h"
+#include "Random.h"
+#include "CellList.h"
 
 // The static buildCell() function determines the correct lattice sytem to
 // build and sends the necessary parameters on to the proper functions
 void CellBuilder::buildCell(Atoms* atoms, int nMols, double density) {
 	int N = nMols;  // the number of molecules
-	double n = pow(N, (1.0 / 3.0));  // the cube root of N
 	// Calculate the cell length as described in the Atoms object
 	double cellLength = pow(N / density, (1.0 / 3.0));
 
-	// The following determines the correct system to build by calculating
-	// the prefactor in the equation
-	//		N = c * n^3
-	// where c = 1 for a sc system, c = 2 for bcc, and c = 4 for fcc, and then
-	// determines when (n/c)^(1/3) is an integer.
-	// The use of modulos (modf) is to determine when (n/c)^(1/3) is an integer,
-	// since modf(double d, double* i) returns the fractional part of d, and
-	// places the integral part in i. So if modf(n * c^(1/3)) << 1, we have
-	// found the correct system. The small added number is to ensure we don't
-	// get modf(n * c^(1/3)) = 0.9999...
+	int n = 0;
+	switch (getCubicLattice(N, &n))
+	{
+	case 1:
+		BuildSCUnitCell(atoms, n, cellLength);
+		break;
+	case 2:
+		buildBCCUnitCell(atoms, n, cellLength);
+		break;
+	case 4:
+		buildFCCUnitCell(atoms, n, cellLength);
+		break;
+	// If N is not a magic number, an FCC supercell with vacancies is used
+	default: {
+		boxT cube;
+		cube.ctor(cellLength, cellLength, cellLength);
+		buildSupercell(atoms, N, cube, 4);
+		return;
+	}
+	}
+	// Give the cell size to the Atoms object
+	atoms->setCellLength(cellLength);
+	// Center the atoms
+	atoms->center();
+}
 
+void CellBuilder::buildLattice(Atoms* atoms, int nMols, const boxT& box,
+	LatticeType type, int seed) {
+	switch (type)
+	{
+	case LatticeType::SC:
+		buildSupercell(atoms, nMols, box, 1);
+		break;
+	case LatticeType::BCC:
+		buildSupercell(atoms, nMols, box, 2);
+		break;
+	case LatticeType::RANDOM:
+		insertRandom(atoms, nMols, box, seed);
+		break;
+	// default is an FCC lattice
+	default:
+		buildSupercell(atoms, nMols, box, 4);
+		break;
+	}
+}
+
+// The following determines the correct system to build by calculating
+// the prefactor in the equation
+//		N = c * n^3
+// where c = 1 for a sc system, c = 2 for bcc, and c = 4 for fcc, and then
+// determines when (n/c)^(1/3) is an integer.
+// The use of modulos (modf) is to determine when (n/c)^(1/3) is an integer,
+// since modf(double d, double* i) returns the fractional part of d, and
+// places the integral part in i. So if modf(n * c^(1/3)) << 1, we have
+// found the correct system. The small added number is to ensure we don't
+// get modf(n * c^(1/3)) = 0.9999...
+int CellBuilder::getCubicLattice(int N, int* nCells) {
+	double n = pow(N, (1.0 / 3.0));  // the cube root of N
 	double temp = 0.0;  // the integer
+	int basis = 0;
 	if (abs(modf(n + 0.0001, &temp)) < 0.001) {
-		BuildSCUnitCell(atoms, temp, cellLength);
+		basis = 1;
 	}
 	else if (abs(modf(n * bccFactor + 0.001, &temp)) < 0.01) {
-		buildBCCUnitCell(atoms, temp, cellLength);
+		basis = 2;
 	}
 	else if (abs(modf(n * fccFactor + 0.001, &temp)) < 0.01) {
-		buildFCCUnitCell(atoms, temp, cellLength);
+		basis = 4;
 	}
-	// If c is neither 1, 2 or 4, we can assume, that the number is not a
-	// magic number, and we just round N down to the nearest sc system.
-	else {
-		N = int(pow(floor(n), 3.0));
-		cout << "Number of atoms is not a magic number! using "
-			<< N << " instead." << endl;
+	*nCells = static_cast<int>(temp);
+	return basis;
+}
+
 
-		// Resize the atoms object and calculate the new cell length.
-		double new_n = pow(N, (1.0 / 3.0));
-		cellLength = pow(N / density, (1.0 / 3.0));  // new cell size
-		BuildSCUnitCell(atoms, new_n, cellLength);
+// The lattice is centered around the origin, so the fractional coordinates
+// in the cube are shifted by a half
+void CellBuilder::fitToBox(Atoms* atoms, const boxT& box) {
+	boxT cube = atoms->getBox();
+	int apm = atoms->getApm();
+	for (int m = 0; m < atoms->getNM(); m++) {
+		vector<double> R = atoms->getMoleculeCenter(m);
+		double s[3], newR[3];
+		cube.toFractional(&R[0], s);
+		for (int k = 0; k < 3; k++) {
+			s[k] += 0.5;
+		}
+		box.toCartesian(s, newR);
+		for (int i = m * apm; i < (m + 1) * apm; i++) {
+			vector<double> p = atoms->getPos(i);
+			for (int k = 0; k < 3; k++) {
+				p[k] += newR[k] - R[k];
+			}
+			atoms->setPos(i, p);
+		}
 	}
-	// Give the cell size to the Atoms object
-	atoms->setCellLength(cellLength);
-	// Center the atoms
+	atoms->setBox(box);
 	atoms->center();
 }
 
@@ -105,4 +167,199 @@ void CellBuilder::buildFCCUnitCell(Atoms* atoms, double N, double length) {
 	atoms->setCellLength(2.0 * dHalfCell);
 	atoms->repeat(n);
 	cout << "Chose FCC!" << endl;
-}
\ No newline at end of file
+}
+// Molecule m is placed on site m * sites / N, so the empty sites are spread
+// evenly through the box. Every molecule is placed independently, so they
+// are written in parallel.
+void CellBuilder::buildSupercell(Atoms* atoms, int nMols, const boxT& box,
+	int basis) {
+	// The fractional positions of the sites in the unit cell
+	vector<vector<double>> cell = { { 0.0, 0.0, 0.0 } };
+	string name = "SC";
+	if (basis == 2) {
+		cell.push_back({ 0.5, 0.5, 0.5 });
+		name = "BCC";
+	} else if (basis == 4) {
+		cell.push_back({ 0.0, 0.5, 0.5 });
+		cell.push_back({ 0.5, 0.0, 0.5 });
+		cell.push_back({ 0.5, 0.5, 0.0 });
+		name = "FCC";
+	}
+	int n[3];
+	getSupercellSize(nMols, basis, box, n);
+	long long nSites = (long long)basis * n[0] * n[1] * n[2];
+
+	// The repeated unit is translated to every occupied site
+	int apm = atoms->getApm();
+	vector<vector<double>> unit(apm);
+	for (int i = 0; i < apm; i++) {
+		unit[i] = atoms->getPos(i);
+	}
+	vector<double> r(3 * (size_t)nMols * apm);
+	#pragma omp parallel for schedule(static)
+	for (int m = 0; m < nMols; m++) {
+		long long site = (long long)m * nSites / nMols;
+		int b = static_cast<int>(site % basis);
+		long long c = site / basis;
+		long long idx[3] = { c / ((long long)n[1] * n[2]), c / n[2] % n[1],
+			c % n[2] };
+		double s[3], t[3];
+		for (int k = 0; k < 3; k++) {
+			s[k] = (idx[k] + cell[b][k]) / n[k];
+		}
+		box.toCartesian(s, t);
+		for (int i = 0; i < apm; i++) {
+			for (int k = 0; k < 3; k++) {
+				r[3 * ((size_t)m * apm + i) + k] = unit[i][k] + t[k];
+			}
+		}
+	}
+	atoms->resize(nMols);
+	atoms->setBox(box);
+	atoms->setPositions(r);
+	atoms->center();
+	cout << "Chose " << n[0] << "x" << n[1] << "x" << n[2] << " " << name
+		<< " supercell with " << nSites - nMols << " empty sites!" << endl;
+}
+
+// The ideal number of unit cells along cell vector k is proportional to its
+// length. Around it, the number along the first two vectors is searched, and
+// the third is the smallest that gives room for all the molecules. Among the
+// supercells with spacings that differ by at most maxAnisotropy the one with
+// the fewest empty sites is chosen, and otherwise the most isotropic one.
+void CellBuilder::getSupercellSize(int nMols, int basis, const boxT& box,
+	int* n) {
+	const double maxAnisotropy = 1.2;
+	double L[3];
+	for (int k = 0; k < 3; k++) {
+		L[k] = box.getLength(k);
+	}
+	double cells = double(nMols) / basis;
+	double scale = pow(cells / (L[0] * L[1] * L[2]), 1.0 / 3.0);
+	int maxX = max(1, static_cast<int>(ceil(2.0 * L[0] * scale)));
+	int maxY = max(1, static_cast<int>(ceil(2.0 * L[1] * scale)));
+	bool bestOk = false;
+	long long bestEmpty = -1;
+	double bestAniso = 0.0;
+	for (int nx = 1; nx <= maxX; nx++) {
+		for (int ny = 1; ny <= maxY; ny++) {
+			long long nz = max(1LL, static_cast<long long>(
+				ceil(cells / ((double)nx * ny) - 1e-9)));
+			long long empty = (long long)basis * nx * ny * nz - nMols;
+			if (empty < 0) {
+				nz++;
+				empty = (long long)basis * nx * ny * nz - nMols;
+			}
+			double a[3] = { L[0] / nx, L[1] / ny, L[2] / nz };
+			double aniso = fmax(a[0], fmax(a[1], a[2]))
+				/ fmin(a[0], fmin(a[1], a[2]));
+			bool ok = aniso <= maxAnisotropy;
+			bool better;
+			if (bestEmpty < 0) {
+				better = true;
+			} else if (ok != bestOk) {
+				better = ok;
+			} else if (ok) {
+				better = empty < bestEmpty
+					|| (empty == bestEmpty && aniso < bestAniso);
+			} else {
+				better = aniso < bestAniso;
+			}
+			if (better) {
+				bestOk = ok;
+				bestEmpty = empty;
+				bestAniso = aniso;
+				n[0] = nx;
+				n[1] = ny;
+				n[2] = static_cast<int>(nz);
+			}
+		}
+	}
+}
+
+// A trial places the center of the repeated unit at a uniform random point
+// of the box with a uniform random rotation (a normalized quaternion of
+// normal numbers). It is accepted, if none of its atoms is closer than the
+// insertion distance to an atom of the molecules placed before. The atoms
+// are kept in a grid of cells at least that wide, so only the atoms of the
+// neighbouring cells are checked. If a molecule doesn't fit, the distance is
+// lowered, so a dense system can always be filled.
+void CellBuilder::insertRandom(Atoms* atoms, int nMols, const boxT& box,
+	int seed) {
+	int apm = atoms->getApm();
+	int N = nMols * apm;
+	// The repeated unit relative to its geometric center
+	vector<vector<double>> unit(apm);
+	double C[3] = { 0.0, 0.0, 0.0 };
+	for (int i = 0; i < apm; i++) {
+		unit[i] = atoms->getPos(i);
+		for (int k = 0; k < 3; k++) {
+			C[k] += unit[i][k] / apm;
+		}
+	}
+	for (int i = 0; i < apm; i++) {
+		for (int k = 0; k < 3; k++) {
+			unit[i][k] -= C[k];
+		}
+	}
+
+	double dmin = insertionDistance;
+	CellGrid grid(box, dmin);
+	vector<double> r(3 * (size_t)N);
+
+	CounterRNG rng(static_cast<uint64_t>(seed));
+	vector<double> p(3 * (size_t)apm);
+	for (int m = 0; m < nMols; m++) {
+		for (int trial = 0; ; trial++) {
+			if (trial > 0 && trial % insertionTrials == 0) {
+				dmin *= 0.95;
+			}
+			double u[4], rot[3][3];
+			rng.uniform(m, 2 * (uint64_t)trial, CounterRNG::INSERTION, u);
+			rng.rotation(m, 2 * (uint64_t)trial + 1, CounterRNG::INSERTION, rot);
+			double R[3];
+			box.toCartesian(u, R);
+			bool overlap = false;
+			for (int i = 0; i < apm && !overlap; i++) {
+				for (int a = 0; a < 3; a++) {
+					p[3 * i + a] = R[a];
+					for (int b = 0; b < 3; b++) {
+						p[3 * i + a] += rot[a][b] * unit[i][b];
+					}
+				}
+				int c = grid.getCellIndex(&p[3 * i]);
+				for (int cell : grid.getCellsAround(c)) {
+					for (int j : grid.getPoints(cell)) {
+						double d[3];
+						for (int k = 0; k < 3; k++) {
+							d[k] = p[3 * i + k] - r[3 * (size_t)j + k];
+						}
+						box.minimumImage(d);
+						if (d[0] * d[0] + d[1] * d[1] + d[2] * d[2]
+							< dmin * dmin) {
+							overlap = true;
+							break;
+						}
+					}
+					if (overlap) break;
+				}
+			}
+			if (overlap) continue;
+			// Accept the molecule, and add its atoms to the cells
+			for (int i = 0; i < apm; i++) {
+				int a = m * apm + i;
+				for (int k = 0; k < 3; k++) {
+					r[3 * (size_t)a + k] = p[3 * i + k];
+				}
+				grid.add(a, &p[3 * i]);
+			}
+			break;
+		}
+	}
+	atoms->resize(nMols);
+	atoms->setBox(box);
+	atoms->setPositions(r);
+	atoms->center();
+	cout << "Inserted " << nMols << " molecules at random with a closest "
+		<< "distance of " << dmin << " sigma!" << endl;
+}
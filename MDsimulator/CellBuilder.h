@@ -3,26 +3,62 @@
 
 #include "Atoms.h"
 
+// Enumerator containing the ways of placing the molecules. AUTO chooses the
+// cubic lattice, which fits the number of molecules, and else FCC.
+enum class LatticeType { AUTO, SC, BCC, FCC, RANDOM };
+
 // Static class used for building the atomic lattice. Automatically detects the
 // lattice type as either simple cubic, body centered cubic or face-centered cubic
-// depending on the number of atoms. If the number fits none of these, the number 
-// of atoms will be rounded down to fit the nearest simple cubic system.
+// depending on the number of atoms. If the number fits none of these, an FCC
+// supercell with nx x ny x nz unit cells is built with the surplus sites left
+// empty, so the number of molecules is always the one asked for.
 class CellBuilder
 {
 public:
 	// Static function for building the atomic system. Takes the Atoms object
 	// to populate (as a pointer) and the number density of the system.
 	static void buildCell(Atoms* atoms, int nMolecules, double density);
+	// Static function for placing exactly nMolecules molecules in the box on
+	// a supercell of the lattice type, or by random insertion without
+	// overlaps. The seed is used for the random insertion.
+	static void buildLattice(Atoms* atoms, int nMolecules, const boxT& box,
+		LatticeType type, int seed);
+	// Get the number of sites in the unit cell (1 = SC, 2 = BCC, 4 = FCC) of
+	// the cubic lattice with exactly nMolecules molecules, and the number of
+	// unit cells along each side in n. Returns 0, if there is none.
+	static int getCubicLattice(int nMolecules, int* n);
+	// Static function for deforming the cubic lattice into a box with the
+	// same volume. The centers of the molecules keep their fractional
+	// coordinates, and the molecules are moved as rigid units.
+	static void fitToBox(Atoms* atoms, const boxT& box);
 
 private:
 	// Constants for the detection algorithm
 	static constexpr double bccFactor = 0.7937005259841;  // cube root of 1/2
 	static constexpr double fccFactor = 0.6299605249474;  // cube root of 1/4
 
+	// The closest distance between atoms of different molecules, which the
+	// random insertion starts out with (reduced)
+	static constexpr double insertionDistance = 0.85;
+	// Trials for a molecule, before the distance is lowered by 5 %
+	static const int insertionTrials = 1000;
+
 	// Functions that build unit cell of the given system
 	static void BuildSCUnitCell(Atoms* atoms, double N, double length);
 	static void buildBCCUnitCell(Atoms* atoms, double N, double length);
 	static void buildFCCUnitCell(Atoms* atoms, double N, double length);
+
+	// Place the molecules on the sites of a supercell with the given number
+	// of sites per unit cell
+	static void buildSupercell(Atoms* atoms, int nMolecules, const boxT& box,
+		int basis);
+	// Find the number of unit cells along the cell vectors, which has room for
+	// nMolecules and the most equal spacings along the three directions
+	static void getSupercellSize(int nMolecules, int basis, const boxT& box,
+		int* n);
+	// Insert the molecules one by one with random positions and orientations
+	static void insertRandom(Atoms* atoms, int nMolecules, const boxT& box,
+		int seed);
 };
 
 #endif // !_cellbuilder_h
@@ -0,0 +1,277 @@
+#include "CellList.h"
+#include <cmath>
+#include <algorithm>
+
+// The constructor builds the grid for the current box
+CellList::CellList(Atoms* a, double cutoff)
+	: cellStart(0), cellAtoms(0)
+{
+	atoms = a;
+	r_c = cutoff;
+	build();
+}
+
+// The destructor releases the memory of the internal vectors
+CellList::~CellList() {
+	vector<int>().swap(cellStart);
+	vector<int>().swap(cellAtoms);
+	vector<vector<int>>().swap(halfShells);
+	vector<vector<int>>().swap(neighbours);
+}
+
+// The atoms are counted per cell, the counts are turned into start indices,
+// and the atoms are placed in their cells in order of their index
+void CellList::build() {
+	// The cells are as wide as the cut-off perpendicular to their faces
+	int n[3];
+	for (int k = 0; k < 3; k++) {
+		n[k] = static_cast<int>(floor(atoms->getBox().getWidth(k) / r_c));
+	}
+	if (n[0] != nc[0] || n[1] != nc[1] || n[2] != nc[2]) {
+		setupGrid(n);
+	}
+	if (!isUsable()) return;
+
+	int N = atoms->getSize();
+	int nCells = getNumberOfCells();
+	vector<int> atomCell(N);
+	cellStart.assign(nCells + 1, 0);
+	for (int i = 0; i < N; i++) {
+		atomCell[i] = getCellIndex(atoms->getPos(i));
+		cellStart[atomCell[i] + 1]++;
+	}
+	for (int c = 0; c < nCells; c++) {
+		cellStart[c + 1] += cellStart[c];
+	}
+	vector<int> fill(cellStart.begin(), cellStart.end() - 1);
+	cellAtoms.resize(N);
+	for (int i = 0; i < N; i++) {
+		cellAtoms[fill[atomCell[i]]++] = i;
+	}
+}
+
+bool CellList::isUsable() {
+	return nc[0] >= 3 && nc[1] >= 3 && nc[2] >= 3;
+}
+
+int CellList::getCellsPerAxis(int axis) {
+	return nc[axis];
+}
+
+int CellList::getNumberOfCells() {
+	return nc[0] * nc[1] * nc[2];
+}
+
+// The positions are not wrapped in the Atoms object, so it is done here in
+// fractional coordinates
+int CellList::getCellIndex(vector<double> p) {
+	double s[3];
+	atoms->getBox().toFractional(&p[0], s);
+	int c[3];
+	for (int k = 0; k < 3; k++) {
+		s[k] -= floor(s[k]);
+		c[k] = min(static_cast<int>(s[k] * nc[k]), nc[k] - 1);
+	}
+	return (c[0] * nc[1] + c[1]) * nc[2] + c[2];
+}
+
+int CellList::getCellStart(int c) {
+	return cellStart[c];
+}
+
+int CellList::getAtom(int k) {
+	return cellAtoms[k];
+}
+
+vector<int>& CellList::getHalfShell(int c) {
+	return halfShells[c];
+}
+
+vector<int>& CellList::getNeighbours(int c) {
+	return neighbours[c];
+}
+
+// The cells are ordered along the Morton curve, and the molecules are placed
+// in the order of the cell of their molecular center. Molecules in the same cell
+// keep their relative order, so the bonds within molecules are unaffected.
+vector<int> CellList::getMortonOrder() {
+	int nM = atoms->getNM();
+	vector<unsigned long long> codes(nM);
+	for (int m = 0; m < nM; m++) {
+		int c = getCellIndex(atoms->getMoleculeCenter(m));
+		int z = c % nc[2], y = (c / nc[2]) % nc[1], x = c / (nc[1] * nc[2]);
+		codes[m] = mortonCode(x, y, z);
+	}
+	vector<int> order(nM);
+	for (int m = 0; m < nM; m++) {
+		order[m] = m;
+	}
+	stable_sort(order.begin(), order.end(),
+		[&codes](int a, int b) { return codes[a] < codes[b]; });
+	return order;
+}
+
+// The 26 neighbours are found from the periodic offsets. The half shell holds
+// the 13 offsets which are lexicographically positive.
+void CellList::setupGrid(const int* n) {
+	for (int k = 0; k < 3; k++) {
+		nc[k] = n[k];
+	}
+	if (!isUsable()) return;
+	int nCells = getNumberOfCells();
+	halfShells.assign(nCells, vector<int>());
+	neighbours.assign(nCells, vector<int>());
+	for (int x = 0; x < nc[0]; x++) {
+		for (int y = 0; y < nc[1]; y++) {
+			for (int z = 0; z < nc[2]; z++) {
+				int c = (x * nc[1] + y) * nc[2] + z;
+				for (int dx = -1; dx <= 1; dx++) {
+					for (int dy = -1; dy <= 1; dy++) {
+						for (int dz = -1; dz <= 1; dz++) {
+							if (dx == 0 && dy == 0 && dz == 0) continue;
+							int nb = (((x + dx + nc[0]) % nc[0]) * nc[1]
+								+ (y + dy + nc[1]) % nc[1]) * nc[2]
+								+ (z + dz + nc[2]) % nc[2];
+							neighbours[c].push_back(nb);
+							if (dx > 0 || (dx == 0 && dy > 0)
+								|| (dx == 0 && dy == 0 && dz > 0)) {
+								halfShells[c].push_back(nb);
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+// Spread the lowest 21 bits of each coordinate to every third bit
+unsigned long long CellList::mortonCode(int x, int y, int z) {
+	unsigned long long code = 0;
+	for (int b = 0; b < 21; b++) {
+		unsigned long long bit = 1ULL << b;
+		code |= ((x & bit) << (2 * b + 2)) | ((y & bit) << (2 * b + 1))
+			| ((z & bit) << (2 * b));
+	}
+	return code;
+}
+
+
+CellGrid::CellGrid() {}
+
+CellGrid::CellGrid(const boxT& b, double minWidth) {
+	setup(b, minWidth);
+}
+
+// The cells around a cell are searched with the offsets -1, 0 and 1 along an
+// axis of three cells or more, 0 and 1 along an axis of two, and only 0 along
+// an axis of one, so no cell is searched twice. The stencils only change with
+// the number of cells.
+void CellGrid::setup(const boxT& b, double minWidth, bool even,
+	const double* s) {
+	box = b;
+	int n[3];
+	for (int k = 0; k < 3; k++) {
+		n[k] = minWidth <= 0.0 ? 1
+			: max(1, static_cast<int>(box.getWidth(k) / minWidth));
+		if (even && n[k] > 1) {
+			n[k] -= n[k] % 2;
+		}
+		shift[k] = s != nullptr ? s[k] : 0.0;
+	}
+	if (n[0] != nc[0] || n[1] != nc[1] || n[2] != nc[2]) {
+		for (int k = 0; k < 3; k++) {
+			nc[k] = n[k];
+		}
+		vector<vector<int>> offsets(3);
+		for (int k = 0; k < 3; k++) {
+			if (nc[k] >= 3) offsets[k] = { -1, 0, 1 };
+			else if (nc[k] == 2) offsets[k] = { 0, 1 };
+			else offsets[k] = { 0 };
+		}
+		int nCells = getNumberOfCells();
+		around.assign(nCells, vector<int>());
+		for (int c = 0; c < nCells; c++) {
+			int x = c / (nc[1] * nc[2]), y = (c / nc[2]) % nc[1], z = c % nc[2];
+			for (int ox : offsets[0]) {
+				for (int oy : offsets[1]) {
+					for (int oz : offsets[2]) {
+						around[c].push_back((((x + ox + nc[0]) % nc[0]) * nc[1]
+							+ (y + oy + nc[1]) % nc[1]) * nc[2]
+							+ (z + oz + nc[2]) % nc[2]);
+					}
+				}
+			}
+		}
+		points.assign(nCells, vector<int>());
+	} else {
+		for (vector<int>& p : points) {
+			p.clear();
+		}
+	}
+	cellOf.clear();
+	slotOf.clear();
+}
+
+int CellGrid::getCellsPerAxis(int axis) {
+	return nc[axis];
+}
+
+int CellGrid::getNumberOfCells() {
+	return nc[0] * nc[1] * nc[2];
+}
+
+int CellGrid::getCellIndex(const double* p) const {
+	double s[3];
+	box.toFractional(p, s);
+	int c[3];
+	for (int k = 0; k < 3; k++) {
+		s[k] += shift[k];
+		c[k] = min(nc[k] - 1, static_cast<int>((s[k] - floor(s[k])) * nc[k]));
+	}
+	return (c[0] * nc[1] + c[1]) * nc[2] + c[2];
+}
+
+// The colour is the parity of the cell along each axis
+int CellGrid::getColour(int c) const {
+	return (((c / (nc[1] * nc[2])) % 2) << 2)
+		| ((((c / nc[2]) % nc[1]) % 2) << 1) | ((c % nc[2]) % 2);
+}
+
+const vector<int>& CellGrid::getCellsAround(int c) const {
+	return around[c];
+}
+
+int CellGrid::add(int j, const double* p) {
+	if (j >= static_cast<int>(cellOf.size())) {
+		cellOf.resize(j + 1, -1);
+		slotOf.resize(j + 1, -1);
+	}
+	int c = getCellIndex(p);
+	cellOf[j] = c;
+	slotOf[j] = static_cast<int>(points[c].size());
+	points[c].push_back(j);
+	return c;
+}
+
+// The point leaves its cell by swapping places with the last one
+void CellGrid::move(int j, int c) {
+	int old = cellOf[j];
+	if (c == old) return;
+	vector<int>& from = points[old];
+	int last = from.back();
+	from[slotOf[j]] = last;
+	slotOf[last] = slotOf[j];
+	from.pop_back();
+	slotOf[j] = static_cast<int>(points[c].size());
+	points[c].push_back(j);
+	cellOf[j] = c;
+}
+
+int CellGrid::getCell(int j) const {
+	return cellOf[j];
+}
+
+const vector<int>& CellGrid::getPoints(int c) const {
+	return points[c];
+}
@@ -0,0 +1,106 @@
+#ifndef _celllist_h
+#define _celllist_h
+
+#include "Atoms.h"
+
+// A cell list divides the periodic cell into nx x ny x nz cells along the cell
+// vectors, with a width of at least the cut-off, so all interaction partners
+// of an atom are found in its own cell and the 26 surrounding ones. The atoms
+// are binned by their fractional coordinates with a counting sort, so
+// building the list is O(N). The grid only changes when the number of cells
+// along an axis does, so a rescaled cell (NPT) keeps the neighbour stencils.
+class CellList
+{
+public:
+	// Constructor takes the Atoms object and the interaction cut-off
+	CellList(Atoms* atoms, double cutoff);
+	~CellList();
+
+	// Bin the atoms into the cells for the current positions and box
+	void build();
+	// The cell list only pays off (and is only correct with the half shell)
+	// with at least three cells per axis
+	bool isUsable();
+
+	// Getters for the grid
+	int getCellsPerAxis(int axis);
+	int getNumberOfCells();
+	// Get the cell index of a position (wrapped into the periodic cell)
+	int getCellIndex(vector<double> p);
+	// The atoms in cell c are getAtom(getCellStart(c)) to
+	// getAtom(getCellStart(c + 1) - 1)
+	int getCellStart(int c);
+	int getAtom(int k);
+	// The 13 neighbour cells in the forward half shell of cell c, so every
+	// pair of neighbouring cells is visited once
+	vector<int>& getHalfShell(int c);
+	// All 26 neighbour cells of cell c
+	vector<int>& getNeighbours(int c);
+
+	// Get an ordering of the molecules along a Morton (Z-order) curve over
+	// the cells: order[new index] = old index
+	vector<int> getMortonOrder();
+
+private:
+	Atoms* atoms;
+	double r_c;				// The cut-off
+	int nc[3] = {};			// The number of cells along each axis
+	vector<int> cellStart;	// Start of each cell in cellAtoms (size cells + 1)
+	vector<int> cellAtoms;	// The atom indices sorted by cell
+	vector<vector<int>> halfShells;	// The forward neighbour cells
+	vector<vector<int>> neighbours;	// All the neighbour cells
+
+	// Set up the neighbour stencils for n[k] cells along axis k
+	void setupGrid(const int* n);
+	// Interleave the bits of the three cell coordinates
+	static unsigned long long mortonCode(int x, int y, int z);
+};
+
+// A periodic grid of cells for any points (atoms, or the centers of the
+// molecules), which are added and moved one at a time. Unlike the CellList,
+// it has any number of cells along an axis, and the cells around a cell are
+// each found once, when there are less than three.
+class CellGrid
+{
+public:
+	// Constructors set up the grid, or leave it empty for a later setup()
+	CellGrid();
+	CellGrid(const boxT& box, double minWidth);
+
+	// Divide the box into cells of at least minWidth (one cell without a
+	// width), and remove all the points. With even, the cells along an axis
+	// are an even number (unless there is one), so the neighbours have
+	// different colours. The grid starts at the fractional shift.
+	void setup(const boxT& box, double minWidth, bool even = false,
+		const double* shift = nullptr);
+
+	// Getters for the grid
+	int getCellsPerAxis(int axis);
+	int getNumberOfCells();
+	// Get the cell index of a position (wrapped into the periodic cell)
+	int getCellIndex(const double* p) const;
+	// Get the colour (0 to 7) of cell c on a 2 x 2 x 2 checkerboard
+	int getColour(int c) const;
+	// Get the cells around cell c, itself included
+	const vector<int>& getCellsAround(int c) const;
+
+	// Add point j at position p. Returns its cell.
+	int add(int j, const double* p);
+	// Move point j to cell c
+	void move(int j, int c);
+	// Get the cell of point j
+	int getCell(int j) const;
+	// Get the points in cell c
+	const vector<int>& getPoints(int c) const;
+
+private:
+	boxT box;
+	int nc[3] = {};				// The number of cells along each axis
+	double shift[3] = {};		// The fractional origin of the grid
+	vector<vector<int>> around;	// The cells around every cell
+	vector<vector<int>> points;	// The points in every cell
+	vector<int> cellOf;			// The cell of every point
+	vector<int> slotOf;			// The place of every point in its cell
+};
+
+#endif // !_celllist_h
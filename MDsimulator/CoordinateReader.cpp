@@ -0,0 +1,272 @@
+#include "CoordinateReader.h"
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "MappedFile.h"
+
+// The format is chosen from the extension, and the positions are checked for
+// being complete
+vector<double> CoordinateReader::read(string filename, double* L,
+	vector<string>* elements) {
+	MappedFile file(filename);
+	*L = 0;
+	elements->clear();
+	string ext = filename.substr(filename.find_last_of('.') + 1);
+	vector<double> r;
+	if (ext.compare("xyz") == 0 || ext.compare("XYZ") == 0) {
+		r = readXYZ(file.data, file.size, L, elements);
+	} else if (ext.compare("pdb") == 0 || ext.compare("PDB") == 0) {
+		r = readPDB(file.data, file.size, L, elements);
+	} else if (ext.compare("bin") == 0) {
+		r = readBinary(file.data, file.size, L);
+	} else {
+		cout << "Unknown configuration file format '" << ext
+			<< "'. Use .xyz, .pdb or .bin" << endl;
+		exit(-1);
+	}
+	if (r.size() == 0) {
+		cout << "No atoms found in '" << filename << "'" << endl;
+		exit(-1);
+	}
+	return r;
+}
+
+// The first two lines are the header, the rest are atoms
+vector<double> CoordinateReader::readXYZ(const char* data, size_t size,
+	double* L, vector<string>* elements) {
+	const char* end = data + size;
+	const char* line1 = data == NULL ? end
+		: static_cast<const char*>(memchr(data, '\n', size));
+	const char* line2 = line1 == NULL || line1 == end ? NULL
+		: static_cast<const char*>(memchr(line1 + 1, '\n', end - line1 - 1));
+	if (line2 == NULL) {
+		cout << "The xyz file has no atoms after the header" << endl;
+		exit(-1);
+	}
+	long long n = atoll(string(data, line1).c_str());
+	// The comment may start with the box length
+	const char* c = line1 + 1;
+	while (c < line2 && (*c == ' ' || *c == '\t')) c++;
+	const char* cEnd = c;
+	while (cEnd < line2 && *cEnd != ' ' && *cEnd != '\t' && *cEnd != '\r') {
+		cEnd++;
+	}
+	double box;
+	if (parseNumber(c, cEnd, &box)) {
+		*L = box;
+	}
+
+	vector<double> r = parseLines(line2 + 1, end, isAtomLineXYZ, parseLineXYZ,
+		elements);
+	if (static_cast<long long>(r.size() / 3) != n) {
+		cout << "The xyz file should have " << n << " atoms, but has "
+			<< r.size() / 3 << endl;
+		exit(-1);
+	}
+	return r;
+}
+
+// The box is the first number of the CRYST1 record. The record is found
+// before the atoms are parsed, since it's near the top.
+vector<double> CoordinateReader::readPDB(const char* data, size_t size,
+	double* L, vector<string>* elements) {
+	const char* end = data + size;
+	const char* line = data;
+	while (line != NULL && line < end) {
+		const char* next = static_cast<const char*>(
+			memchr(line, '\n', end - line));
+		const char* lineEnd = next == NULL ? end : next;
+		if (lineEnd - line >= 15 && strncmp(line, "CRYST1", 6) == 0) {
+			parseNumber(line + 6, line + 15, L);
+			break;
+		}
+		if (lineEnd - line >= 4 && (strncmp(line, "ATOM", 4) == 0
+			|| strncmp(line, "HETA", 4) == 0)) {
+			break;  // No box before the first atom
+		}
+		line = next == NULL ? NULL : next + 1;
+	}
+	return parseLines(data, end, isAtomLinePDB, parseLinePDB, elements);
+}
+
+// The binary coordinates are copied directly
+vector<double> CoordinateReader::readBinary(const char* data, size_t size,
+	double* L) {
+	size_t header = 8 + sizeof(int64_t) + sizeof(double);
+	if (size < header || strncmp(data, "MDCOORD", 7) != 0) {
+		cout << "The binary configuration file has no MDCOORD header" << endl;
+		exit(-1);
+	}
+	int64_t n;
+	memcpy(&n, data + 8, sizeof(int64_t));
+	memcpy(L, data + 8 + sizeof(int64_t), sizeof(double));
+	if (n < 0 || size < header + 3 * n * sizeof(double)) {
+		cout << "The binary configuration file is shorter than the "
+			<< n << " atoms in its header" << endl;
+		exit(-1);
+	}
+	vector<double> r(3 * n);
+	int nThreads = 1;
+#ifdef _OPENMP
+	nThreads = omp_get_max_threads();
+#endif
+	// Each thread copies a contiguous block of the file (first touch)
+	#pragma omp parallel for schedule(static)
+	for (int t = 0; t < nThreads; t++) {
+		size_t from = 3 * n * t / nThreads;
+		size_t to = 3 * n * (t + 1) / nThreads;
+		if (to > from) {
+			memcpy(&r[from], data + header + from * sizeof(double),
+				(to - from) * sizeof(double));
+		}
+	}
+	return r;
+}
+
+// The file is split into equally large chunks, which start after a line
+// break. A first pass counts the atom lines in each chunk, and a second
+// pass parses them into their place in the output.
+vector<double> CoordinateReader::parseLines(const char* begin,
+	const char* end, bool (*filter)(const char*, const char*),
+	bool (*parse)(const char*, const char*, double*, string*),
+	vector<string>* elements) {
+	int nChunks = 1;
+#ifdef _OPENMP
+	nChunks = omp_get_max_threads();
+#endif
+	size_t size = end - begin;
+	vector<const char*> chunkStart(nChunks + 1, end);
+	chunkStart[0] = begin;
+	for (int t = 1; t < nChunks; t++) {
+		const char* p = begin + size * t / nChunks;
+		// Move the start to the beginning of the next line
+		if (p > chunkStart[t - 1] && p[-1] != '\n') {
+			const char* nl = static_cast<const char*>(
+				memchr(p, '\n', end - p));
+			p = nl == NULL ? end : nl + 1;
+		}
+		chunkStart[t] = p < chunkStart[t - 1] ? chunkStart[t - 1] : p;
+	}
+
+	// Count the atoms in each chunk
+	vector<long long> counts(nChunks + 1, 0);
+	#pragma omp parallel for schedule(static)
+	for (int t = 0; t < nChunks; t++) {
+		const char* line = chunkStart[t];
+		while (line < chunkStart[t + 1]) {
+			const char* nl = static_cast<const char*>(
+				memchr(line, '\n', chunkStart[t + 1] - line));
+			const char* lineEnd = nl == NULL ? chunkStart[t + 1] : nl;
+			if (filter(line, lineEnd)) counts[t + 1]++;
+			line = lineEnd + 1;
+		}
+	}
+	for (int t = 0; t < nChunks; t++) {
+		counts[t + 1] += counts[t];
+	}
+
+	// Parse the atoms into their place
+	vector<double> r(3 * counts[nChunks]);
+	elements->resize(counts[nChunks]);
+	int failed = 0;
+	#pragma omp parallel for schedule(static) reduction(+:failed)
+	for (int t = 0; t < nChunks; t++) {
+		long long atom = counts[t];
+		const char* line = chunkStart[t];
+		while (line < chunkStart[t + 1]) {
+			const char* nl = static_cast<const char*>(
+				memchr(line, '\n', chunkStart[t + 1] - line));
+			const char* lineEnd = nl == NULL ? chunkStart[t + 1] : nl;
+			if (filter(line, lineEnd)) {
+				if (!parse(line, lineEnd, &r[3 * atom], &(*elements)[atom])) {
+					failed++;
+				}
+				atom++;
+			}
+			line = lineEnd + 1;
+		}
+	}
+	if (failed > 0) {
+		cout << failed << " atom lines in the configuration file couldn't be"
+			<< " read" << endl;
+		exit(-1);
+	}
+	return r;
+}
+
+// Every line that is not blank is an atom
+bool CoordinateReader::isAtomLineXYZ(const char* line, const char* end) {
+	for (const char* c = line; c < end; c++) {
+		if (*c != ' ' && *c != '\t' && *c != '\r') return true;
+	}
+	return false;
+}
+
+bool CoordinateReader::isAtomLinePDB(const char* line, const char* end) {
+	return end - line >= 6 && (strncmp(line, "ATOM  ", 6) == 0
+		|| strncmp(line, "HETATM", 6) == 0);
+}
+
+// The element is the first word, and the next three are the coordinates
+bool CoordinateReader::parseLineXYZ(const char* line, const char* end,
+	double* r, string* element) {
+	const char* c = line;
+	for (int word = 0; word < 4; word++) {
+		while (c < end && (*c == ' ' || *c == '\t')) c++;
+		const char* wordEnd = c;
+		while (wordEnd < end && *wordEnd != ' ' && *wordEnd != '\t'
+			&& *wordEnd != '\r') {
+			wordEnd++;
+		}
+		if (wordEnd == c) return false;
+		if (word == 0) {
+			element->assign(c, wordEnd);
+		} else if (!parseNumber(c, wordEnd, &r[word - 1])) {
+			return false;
+		}
+		c = wordEnd;
+	}
+	return true;
+}
+
+// The coordinates are in the columns 31-38, 39-46 and 47-54, and the element
+// in 77-78. Without an element the atom name in 13-16 is used.
+bool CoordinateReader::parseLinePDB(const char* line, const char* end,
+	double* r, string* element) {
+	if (end - line < 54) return false;
+	const char* from = line + 12;
+	const char* to = line + 16;
+	if (end - line >= 78 && (line[76] != ' ' || line[77] != ' ')) {
+		from = line + 76;
+		to = line + 78;
+	}
+	while (from < to && *from == ' ') from++;
+	while (to > from && (to[-1] == ' ' || to[-1] == '\r')) to--;
+	element->assign(from, to);
+	for (int k = 0; k < 3; k++) {
+		if (!parseNumber(line + 30 + 8 * k, line + 38 + 8 * k, &r[k])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool CoordinateReader::parseNumber(const char* begin, const char* end,
+	double* x) {
+	char buffer[64];
+	size_t n = end - begin;
+	if (n == 0 || n >= sizeof(buffer)) return false;
+	memcpy(buffer, begin, n);
+	buffer[n] = '\0';
+	char* stop;
+	double value = strtod(buffer, &stop);
+	// Allow trailing white space, but nothing else
+	while (*stop == ' ' || *stop == '\t' || *stop == '\r') stop++;
+	if (stop == buffer || *stop != '\0') return false;
+	*x = value;
+	return true;
+}
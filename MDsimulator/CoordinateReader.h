@@ -0,0 +1,64 @@
+#ifndef _coordinatereader_h
+#define _coordinatereader_h
+
+#include <vector>
+#include <string>
+
+using namespace std;
+
+// Static class for reading an initial configuration from an external file, so
+// large systems don't have to be built from the lattice. The file is memory
+// mapped and the lines are parsed in parallel chunks (OpenMP). The format is
+// chosen from the file extension:
+//	.xyz	the atom count, a comment line and one "element x y z" line per
+//			atom. If the comment starts with a number, it is the cubic box
+//			length.
+//	.pdb	the ATOM and HETATM records (fixed columns). The box length is
+//			taken from the CRYST1 record, if there is one.
+//	.bin	an 8 byte "MDCOORD" tag, the number of atoms (64 bit integer), the
+//			box length (double) and then x, y, z of every atom (doubles).
+// All lengths are in Angstrom. The text formats also give the element of every
+// atom (the first word of an xyz line, and the element or atom name columns of
+// a pdb record), which can be mapped to the atom types.
+class CoordinateReader
+{
+public:
+	// Read the positions as x, y, z of all atoms after each other. The box
+	// length is 0, if the file doesn't contain one. The elements are empty
+	// for the binary format.
+	static vector<double> read(string filename, double* boxLength,
+		vector<string>* elements);
+
+private:
+	// Parsers for the different formats. Take the mapped file content.
+	static vector<double> readXYZ(const char* data, size_t size,
+		double* boxLength, vector<string>* elements);
+	static vector<double> readPDB(const char* data, size_t size,
+		double* boxLength, vector<string>* elements);
+	static vector<double> readBinary(const char* data, size_t size,
+		double* boxLength);
+
+	// Split the lines from begin to the end into one chunk per thread, and
+	// parse every line that passes the filter into 3 coordinates and an
+	// element. The lines that pass are counted first, so each chunk knows
+	// where to write.
+	static vector<double> parseLines(const char* begin, const char* end,
+		bool (*filter)(const char* line, const char* end),
+		bool (*parse)(const char* line, const char* end, double* r,
+			string* element),
+		vector<string>* elements);
+
+	// Line filters and parsers for the text formats
+	static bool isAtomLineXYZ(const char* line, const char* end);
+	static bool isAtomLinePDB(const char* line, const char* end);
+	static bool parseLineXYZ(const char* line, const char* end, double* r,
+		string* element);
+	static bool parseLinePDB(const char* line, const char* end, double* r,
+		string* element);
+
+	// Parse the number in the characters from begin to end. The number is
+	// copied to a terminated buffer, since the mapped file isn't terminated.
+	static bool parseNumber(const char* begin, const char* end, double* x);
+};
+
+#endif // !_coordinatereader_h
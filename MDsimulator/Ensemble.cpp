@@ -1,57 +1,57 @@
 #include "Ensemble.h"
 #include <iostream>
+#include "MonteCarlo.h"
+#include "PerfCounters.h"
 
 // Constructor for any Ensemble, which assigns the Atoms object and creates
 // the wanted Potential and Integrator objects with the needed parameters.
 Ensemble::Ensemble(Atoms* a, dataT* d)
-	: forces(a->getSize(), vector<double>(3, 0))  // initialize forces vector
 {
 	atoms = a;  // Assign Atoms pointer
-	// Switch on the Potential type, and create the proper one
-	switch (d->PT)
-	{
-	case PotType::LJ:
-		Pot = new LJ(atoms, d->rhoN, d->r_co);
-		break;
-	// default is a Lennard-Jones Potential
-	default:
-		Pot = new LJ(atoms, d->rhoN, d->r_co);
-		break;
-	}
+	// Create the proper Potential
+	Pot = Potential::createPotential(atoms, d);
 
 	// Get the forces from the Potential
-	forces = Pot->getForces();
+	const double* forces = Pot->calculateForces();
 
 	// Switch on the Integrator type and create the proper one
 	switch (d->IT)
 	{
 	case InteType::VERLET:
-		InteEngine = new Verlet(atoms, &forces, d->dt_s);
+		InteEngine = new Verlet(atoms, forces, d->dt_s);
 		break;
 	case InteType::VELVERLET:
 		InteEngine = new VelVerlet(atoms, d->T_s, d->dt_s, d->tau_s_s);
 		break;
+	case InteType::LANGEVIN:
+		InteEngine = new Langevin(atoms, d->T_s, d->dt_s, d->tau_s_s, d->seed);
+		break;
 	// Default is the Verlet, which is only really for NVE
 	default:
-		InteEngine = new Verlet(atoms, &forces, d->dt_s);
+		InteEngine = new Verlet(atoms, forces, d->dt_s);
 		break;
 	}
 }
 
-// Destructor that deletes the forces vector and the Potential and Integrator
-// objects
+// Destructor that deletes the Potential and Integrator objects
 Ensemble::~Ensemble() {
-	vector<vector<double>>().swap(forces);
-	delete &Pot, &InteEngine;
+	delete Pot;
+	delete InteEngine;
 }
 
 Ensemble* Ensemble::createEnsemble(Atoms* a, dataT* d) {
+	// Monte Carlo samples the NVT or the NPT ensemble without dynamics
+	if (d->monteCarlo != 0) {
+		return new MonteCarlo(a, d);
+	}
 	switch (d->ET)
 	{
 	case EnsType::NVE:
 		return new NVE(a, d);
 	case EnsType::NVT:
 		return new NVT(a, d);
+	case EnsType::NPT:
+		return new NPT(a, d);
 	default:
 		return new NVE(a, d);
 	}
@@ -60,29 +60,67 @@ Ensemble* Ensemble::createEnsemble(Atoms* a, dataT* d) {
 // Ask the Potential to calculate the distances between atoms, so the potential
 // energy and the forces can be calculated
 double Ensemble::calculate() {
-	forces = Pot->getForces();
+	PerfCounters::Scope scope(PerfCounters::FORCES);
+	Pot->calculateForces();
 	return Pot->getEnergy();
 }
 
+Potential* Ensemble::getPotential() {
+	return Pot;
+}
+
 double Ensemble::getPressure() {
 	return (2 * atoms->getEnergy() + Pot->getSumForcesInteraction())
-		/ (3 * pow(atoms->getCellLength(), 3.0))
+		/ (3 * atoms->getBox().getVolume())
 		+ Pot->getPressureCorrection();
 }
 
-// Wrapper for getting the forces from the potential, when the stored forces
-// are not the ones needed
-vector<vector<double>> Ensemble::getForces() {
-	return Pot->getForces();
+// P_ab = (sum_i v_ia v_ib + W_ab) / V, plus the tail correction on the diagonal
+vector<vector<double>> Ensemble::getPressureTensor() {
+	vector<vector<double>> P = atoms->getKineticTensor();
+	vector<vector<double>> W = Pot->getVirialTensor();
+	double V = atoms->getBox().getVolume();
+	for (int a = 0; a < 3; a++) {
+		for (int b = 0; b < 3; b++) {
+			P[a][b] = (P[a][b] + W[a][b]) / V;
+		}
+		P[a][a] += Pot->getPressureCorrection();
+	}
+	return P;
+}
+
+// Wrapper for getting the forces from the potential, which are only
+// recalculated, if the positions have changed
+const double* Ensemble::getForces() {
+	PerfCounters::Scope scope(PerfCounters::FORCES);
+	return Pot->calculateForces();
+}
+
+const double* Ensemble::getForceArray() {
+	return Pot->getForceArray();
+}
+
+// The Integrator sets them, since Verlet carries them in its stored positions
+void Ensemble::setVelocities(const double* v) {
+	InteEngine->setVelocities(atoms, v);
+}
+
+// The order comes from the cell grid of the Potential
+void Ensemble::reorder() {
+	vector<int> order = Pot->getSpatialOrder();
+	atoms->reorder(order);
+	Pot->reorder(order);
+	InteEngine->reorder(order, atoms->getApm());
 }
 
 // Simple printing function for printing the forces to the console
 void Ensemble::printForces() {
 	vector<double> av = { 0.0, 0.0, 0.0 };
-	for (vector<double> f : forces) {
+	const double* F = Pot->getForceArray();
+	for (int j = 0; j < atoms->getSize(); j++) {
 		for (int i = 0; i < 3; i++) {
-			av[i] += f[i];
-			cout << f[i] << ", ";
+			av[i] += F[3 * j + i];
+			cout << F[3 * j + i] << ", ";
 		}
 		cout << endl;
 	}
@@ -100,7 +138,7 @@ NVE::NVE(Atoms* a, dataT* d)
 
 // The update() function asks the Integrator to update
 double NVE::update() {
-	InteEngine->update(atoms, &forces, this);
+	InteEngine->update(atoms, Pot->getForceArray(), this);
 	return 0;  // There is no extended system for NVE, so return zero
 }
 
@@ -115,8 +153,57 @@ NVT::NVT(Atoms* a, dataT* d)
 // The update() function asks the Integrator to update, and the returns the
 // energy of the extended system
 double NVT::update() {
-	InteEngine->update(atoms, &forces, this);
+	InteEngine->update(atoms, Pot->getForceArray(), this);
 	// add the energy from the extended system
 	InteEngine->updateNvtParameters(&ln_s, &zeta);
-	return zeta * zeta * Ms / 2.0 + 3.0 * atoms->getSize() * T * ln_s;
+	return zeta * zeta * Ms / 2.0 + 3.0 * atoms->getSize() * T * ln_s
+		+ InteEngine->getReservoirEnergy();
+}
+
+double NVT::getTemperature() {
+	return T;
+}
+
+// The velocities are scaled by sqrt(T_new / T_old), so the kinetic energy
+// fits the new temperature (Sugita and Okamoto, Chem. Phys. Lett. 314, 141).
+// The thermal mass, the scaling and the friction go with the temperature.
+// The Integrator scales the velocities, since Verlet carries them in its
+// stored positions.
+void NVT::exchangeThermostat(NVT* other) {
+	thermostatT mine = InteEngine->getThermostat();
+	thermostatT theirs = other->InteEngine->getThermostat();
+	InteEngine->scaleVelocities(atoms, sqrt(other->T / T));
+	other->InteEngine->scaleVelocities(other->atoms, sqrt(T / other->T));
+	InteEngine->setThermostat(theirs);
+	other->InteEngine->setThermostat(mine);
+	swap(T, other->T);
+	swap(Ms, other->Ms);
+	swap(ln_s, other->ln_s);
+	swap(zeta, other->zeta);
+}
+
+// The constructor for NPT calls the NVT constructor
+NPT::NPT(Atoms* a, dataT* d)
+	: NVT(a, d)
+{
+	P = d->P_s;
+	kappa = d->kappa_s;
+	tau_p = d->tau_p_s;
+	dt = d->dt_s;
+}
+
+// The update() function lets NVT advance the system, and then applies the
+// Berendsen scaling mu = [1 - kappa * dt / tau_p * (P - P(t))]^(1/3) to the
+// cell. The geometry of the Integrator and the Potential is rescaled in place.
+double NPT::update() {
+	double Hx = NVT::update();
+	if (tau_p <= 0.0) {
+		return Hx;  // The barostat is switched off
+	}
+	double mu = pow(1.0 - kappa * dt / tau_p * (P - getPressure()), 1.0 / 3.0);
+	// The Integrator needs the unscaled positions to shift its own memory
+	InteEngine->rescale(atoms, mu);
+	atoms->rescale(mu);
+	Pot->rescale(mu);
+	return Hx;
 }
@@ -5,7 +5,7 @@
 #include "Integrator.h"
 #include "dataType.h"
 
-enum class EnsType { NVE, NVT };
+enum class EnsType { NVE, NVT, NPT };
 
 // Class representing any ensemble (NVE, NVT, ...), which works as an interface
 // with a few functions, which it passes on to its children.
@@ -23,18 +23,31 @@ public:
 	double calculate();
 	// Calculate the pressure of the system
 	double getPressure();
-	// Public function for getting the forces from the Potential
-	vector<vector<double>> getForces();
+	// Calculate the full pressure tensor of the system from the virial tensor
+	// of the last force calculation. The trace / 3 is getPressure().
+	vector<vector<double>> getPressureTensor();
+	// Public function for getting the forces from the Potential as x, y, z
+	// of the atoms after each other
+	const double* getForces();
+	// Get the forces of the last calculation as x, y, z of the atoms after
+	// each other, without a copy
+	const double* getForceArray();
 	// Print the forces vector to std::out
 	void printForces();
+	// Get the Potential of the ensemble
+	Potential* getPotential();
+	// Set the velocities of the Atoms as x, y, z of the atoms after each
+	// other, so the Integrator continues from them
+	void setVelocities(const double* v);
+	// Reorder the molecules spatially for cache locality. All per-atom data
+	// of the Atoms, the Integrator and the forces are permuted together.
+	void reorder();
 
 	// Abstract function for updating the positions and velocities of the Atoms
 	// object to the next time step. Must be implemented by children
 	virtual double update() = 0;
 
 protected:
-	// The forces vector
-	vector<vector<double>> forces;
 	// Pointers to the inherent Atoms, Potential and Integrator objects
 	Atoms* atoms;
 	Potential* Pot;
@@ -66,6 +79,12 @@ public:
 	// extended system
 	double update();
 
+	// Get the reduced temperature of the thermostat
+	double getTemperature();
+	// Swap the temperature and the thermostat state with another replica,
+	// while both keep their configurations
+	void exchangeThermostat(NVT* other);
+
 private:
 	double ln_s = 0;	// the natural logrithm of the scaling factor
 	double zeta = 0;	// the friction coefficient
@@ -73,4 +92,26 @@ private:
 	double T;			// the reduced temperature
 };
 
+// Implementation of an NPT ensemble, which inherits from NVT. The temperature
+// is controlled as in NVT, while a Berendsen barostat rescales the cell and
+// the molecular centers of mass towards the target pressure after each step.
+class NPT :
+	public NVT
+{
+public:
+	// Constructor
+	NPT(Atoms* atoms, dataT* data);
+
+	// Implementation of the abstract function update()
+	// Updates the positions and velocities, rescales the cell, and returns
+	// the energy of the extended system of the thermostat
+	double update();
+
+private:
+	double P;		// the reduced target pressure
+	double kappa;	// the reduced isothermal compressibility
+	double tau_p;	// the reduced barostat relaxation time
+	double dt;		// the reduced time step
+};
+
 #endif // !_ensemble_h
@@ -0,0 +1,123 @@
+#define _USE_MATH_DEFINES
+#include "FFT.h"
+#include <cmath>
+#include <iostream>
+
+// The constructor checks the grid sizes and precalculates the twiddle factors
+// and the bit reversal permutation for each of the three axes
+FFT3D::FFT3D(int n1, int n2, int n3)
+	: twiddles(3), bitReversed(3)
+{
+	n[0] = n1;
+	n[1] = n2;
+	n[2] = n3;
+	for (int a = 0; a < 3; a++) {
+		if (n[a] < 1 || nextPowerOfTwo(n[a]) != n[a]) {
+			cout << "FFT grid size " << n[a] << " is not a power of two!"
+				<< endl;
+			exit(-1);
+		}
+		// exp(2 pi i j / n) for j < n / 2 covers all the butterflies
+		twiddles[a].resize(n[a] / 2 + 1);
+		for (int j = 0; j < n[a] / 2 + 1; j++) {
+			double phi = 2.0 * M_PI * j / n[a];
+			twiddles[a][j] = complex<double>(cos(phi), sin(phi));
+		}
+		// The bit reversed index of every element on the line
+		int bits = 0;
+		while ((1 << bits) < n[a]) bits++;
+		bitReversed[a].resize(n[a]);
+		for (int j = 0; j < n[a]; j++) {
+			int r = 0;
+			for (int b = 0; b < bits; b++) {
+				if (j & (1 << b)) r |= 1 << (bits - 1 - b);
+			}
+			bitReversed[a][j] = r;
+		}
+	}
+}
+
+// Empty destructor, since the vectors release their own memory
+FFT3D::~FFT3D() {}
+
+void FFT3D::forward(vector<complex<double>>& grid) {
+	for (int a = 0; a < 3; a++) {
+		transformAxis(grid, a, false);
+	}
+}
+
+void FFT3D::backward(vector<complex<double>>& grid) {
+	for (int a = 0; a < 3; a++) {
+		transformAxis(grid, a, true);
+	}
+}
+
+int FFT3D::getSize(int axis) {
+	return n[axis];
+}
+
+int FFT3D::nextPowerOfTwo(int N) {
+	int p = 1;
+	while (p < N) p *= 2;
+	return p;
+}
+
+// The lines along an axis are independent, so they are distributed over the
+// threads. Lines that are not contiguous in memory are copied to a buffer
+// before the transform and back afterwards.
+void FFT3D::transformAxis(vector<complex<double>>& grid, int a, bool inverse) {
+	// The memory distance between two consecutive elements on the line
+	int stride = 1;
+	for (int b = a + 1; b < 3; b++) {
+		stride *= n[b];
+	}
+	int nLines = n[0] * n[1] * n[2] / n[a];
+
+	#pragma omp parallel
+	{
+		vector<complex<double>> buffer(n[a]);
+		#pragma omp for schedule(static)
+		for (int l = 0; l < nLines; l++) {
+			// The first element of line l: the lines are numbered by the
+			// index before the axis (outer) and after the axis (inner)
+			int outer = l / stride;
+			int inner = l % stride;
+			complex<double>* start = &grid[0] + outer * n[a] * stride + inner;
+			if (stride == 1) {
+				transformLine(start, a, inverse);
+				continue;
+			}
+			for (int j = 0; j < n[a]; j++) {
+				buffer[j] = start[j * stride];
+			}
+			transformLine(&buffer[0], a, inverse);
+			for (int j = 0; j < n[a]; j++) {
+				start[j * stride] = buffer[j];
+			}
+		}
+	}
+}
+
+// Iterative radix-2 decimation in time Cooley-Tukey transform
+void FFT3D::transformLine(complex<double>* x, int a, bool inverse) {
+	int N = n[a];
+	// Permute the elements into bit reversed order
+	for (int j = 0; j < N; j++) {
+		int r = bitReversed[a][j];
+		if (j < r) swap(x[j], x[r]);
+	}
+	// Combine the transforms of doubling length
+	for (int len = 2; len <= N; len *= 2) {
+		int step = N / len;
+		for (int s = 0; s < N; s += len) {
+			for (int j = 0; j < len / 2; j++) {
+				complex<double> w = twiddles[a][j * step];
+				if (inverse) w = conj(w);
+				complex<double> u = x[s + j];
+				complex<double> v = x[s + j + len / 2] * w;
+				x[s + j] = u + v;
+				x[s + j + len / 2] = u - v;
+			}
+		}
+	}
+}
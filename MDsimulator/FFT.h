@@ -0,0 +1,45 @@
+#ifndef _fft_h
+#define _fft_h
+
+#include <vector>
+#include <complex>
+
+using namespace std;
+
+// Built-in three-dimensional fast Fourier transform on a periodic grid. Every
+// axis must have a length that is a power of two (see nextPowerOfTwo()), as
+// the transform is a radix-2 Cooley-Tukey along each axis. The grid is stored
+// with the last axis running fastest: index = (i * n2 + j) * n3 + k. The lines
+// along each axis are transformed in parallel (OpenMP).
+class FFT3D
+{
+public:
+	// Constructor precalculates the twiddle factors and bit reversal tables
+	FFT3D(int n1, int n2, int n3);
+	~FFT3D();
+
+	// Forward transform: F(m) = sum_k Q(k) exp(2 pi i m.k / n)
+	void forward(vector<complex<double>>& grid);
+	// Backward transform: Q(k) = sum_m F(m) exp(-2 pi i m.k / n). The result
+	// is not normalized by the number of grid points.
+	void backward(vector<complex<double>>& grid);
+
+	// Get the size of an axis
+	int getSize(int axis);
+
+	// Get the smallest power of two that is larger than or equal to n
+	static int nextPowerOfTwo(int n);
+
+private:
+	int n[3];	// The number of grid points along each axis
+	// The twiddle factors exp(2 pi i j / n) and bit reversal tables per axis
+	vector<vector<complex<double>>> twiddles;
+	vector<vector<int>> bitReversed;
+
+	// Transform all the lines along one axis in the given direction
+	void transformAxis(vector<complex<double>>& grid, int axis, bool inverse);
+	// In-place radix-2 transform of a single contiguous line
+	void transformLine(complex<double>* line, int axis, bool inverse);
+};
+
+#endif // !_fft_h
@@ -2,10 +2,13 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <cctype>
+#include <algorithm>
 
 // Constructor populates the alias map
-InputParser::InputParser(std::vector<std::vector<std::string>> kam) :
-	aliasMap(), valueMap() {
+InputParser::InputParser(std::vector<std::vector<std::string>> kam,
+	std::vector<std::string> raw) :
+	aliasMap(), valueMap(), rawKeys(raw.begin(), raw.end()) {
 	for (std::vector<std::string> aList : kam) {
 		std::string key = aList[0];
 		for (std::string s : aList) {
@@ -17,46 +20,70 @@ InputParser::InputParser(std::vector<std::vector<std::string>> kam) :
 // empty destructor
 InputParser::~InputParser() {}
 
-// Parse a file by casting to one string, and extracting tokens (words),
-// which are then added as key-value pairs to the value map.
+// Parse a file by reading it into one string, and extracting tokens (words)
+// in a single pass, which are then added as key-value pairs to the value map.
 void InputParser::parseFile(std::string filename) {
-	std::ifstream input(filename);
+	std::ifstream input(filename, std::ios::binary);
 	if (!input.is_open()) {
 		std::cout << "File not found!" << std::endl;
 		exit(-1);
 	}
-	// Read the entire file into a string
-	std::string t(
-		static_cast<std::stringstream const&>(std::stringstream()
-			<< input.rdbuf()).str());
+	// Read the entire file into a string in one go
+	input.seekg(0, std::ios::end);
+	std::string t(static_cast<size_t>(input.tellg()), '\0');
+	input.seekg(0, std::ios::beg);
+	input.read(&t[0], t.size());
 	
 	// The input is no longer needed, so we close it.
 	input.close();
 
-	// Create a stringstream to check the input character-wise for any
-	// delimiters, which are ignored in the output but used for defining
-	// the tokens.
-	std::stringstream ssm;
-	std::string delimiters = " ,-!\t\n\r()[]{}";
-	for (char& c : t) {
-		// Only add the character to the active token, if it's not a delimiter
-		if (delimiters.find(c) == std::string::npos) {
-			ssm << c;
-		} else {  // End the token, if we get to a delimiter
-			if (ssm.str().size() > 0) {  // Parse the token iff it has content
-				parseToken(ssm.str());
-				ssm.str("");  // Clear the token
+	// A lookup table of the delimiters, which are ignored in the output but
+	// used for defining the tokens
+	bool isDelimiter[256] = {};
+	for (unsigned char c : std::string(" ,-!\t\n\r()[]{}")) {
+		isDelimiter[c] = true;
+	}
+	// A token is the range between two delimiters, so only its start has to
+	// be remembered
+	size_t tokenStart = 0;
+	for (size_t i = 0; i < t.size(); i++) {
+		unsigned char c = t[i];
+		// A minus in front of a number is a sign (or exponent), not a delimiter
+		bool isSign = c == '-' && i + 1 < t.size()
+			&& (isdigit(t[i + 1]) || t[i + 1] == '.');
+		if (isDelimiter[c] && !isSign) {
+			// End the token, and parse it iff it has content
+			if (i > tokenStart) {
+				parseToken(t.substr(tokenStart, i - tokenStart));
+				// The value of a raw key is the rest of the line without the
+				// surrounding white space, so a path keeps its '-' and '()'
+				if (activeValue.empty() && rawKeys.count(activeKey) > 0) {
+					size_t end = t.find_first_of("\n\r", i);
+					end = end == std::string::npos ? t.size() : end;
+					size_t first = t.find_first_not_of(" \t", i);
+					size_t last = t.find_last_not_of(" \t", end - 1);
+					if (first < end && last != std::string::npos
+						&& last >= first) {
+						valueMap[activeKey] = t.substr(first, last + 1 - first)
+							+ ",";
+					}
+					i = end;
+				}
 			}
+			tokenStart = i + 1;
 		}
 	}
 	// Make sure the last token gets processed, if there is not trailing white
 	// space in the input.
-	valueMap[activeKey] = activeValue + ssm.str();
+	std::string tail = t.substr(std::min(tokenStart, t.size()));
+	if (!activeValue.empty() || !tail.empty()) {
+		valueMap[activeKey] = activeValue + tail;
+	}
 }
 
 // Parse the tokens into the value map. The token is checked against the
 // alias map to determine, if it's a keyword. If not, it's added to the value.
-void InputParser::parseToken(std::string token) {
+void InputParser::parseToken(const std::string& token) {
 	// Is the token a keyword
 	if (aliasMap.count(token) > 0) {
 		// If it's not the first token, then add the key value pair
@@ -178,6 +205,24 @@ std::vector<int> InputParser::getVectorI(std::string key) {
 	return v;
 }
 
+std::vector<std::string> InputParser::getVectorS(std::string key) {
+	// Uses a stringstream to populate a vector by using the comma
+	// as a delimiter.
+	std::vector<std::string> v;
+	std::stringstream ss(getValue(key));
+	std::string item;
+	// Pass an empty vector on properly
+	if (ss.str().compare(",") == 0) {
+		return std::vector<std::string>(0);
+	}
+
+	// Turn the string vector into a std::vector
+	while (getline(ss, item, ',')) {
+		v.push_back(item);
+	}
+	return v;
+}
+
 // Print the key-value pairs of the alias map
 void InputParser::printAliasMap() {
 	std::cout << "Aliases in use are:" << std::endl;
@@ -2,13 +2,16 @@
 #define _inputparser_h
 
 #include <map>
+#include <set>
 #include <vector>
 #include <string>
 
 class InputParser {
 public:
 	// Constructor takes the alias matrix to establish keywords and their aliases.
-	InputParser(std::vector<std::vector<std::string>> keyAliasMatrix);
+	// The values of the raw keys (like file names) are the rest of their line.
+	InputParser(std::vector<std::vector<std::string>> keyAliasMatrix,
+		std::vector<std::string> rawKeys = {});
 	virtual ~InputParser();
 
 	// Initiate the parsing of the inputted file.
@@ -23,6 +26,7 @@ public:
 	std::string getString(std::string key);
 	std::vector<double> getVectorD(std::string key);
 	std::vector<int> getVectorI(std::string key);
+	std::vector<std::string> getVectorS(std::string key);
 
 	// Debug functions which print the contents to the console
 	void printAliasMap();
@@ -36,9 +40,11 @@ private:
 	std::map<std::string, std::string> aliasMap;
 	// Keeps track of key-value pairs for the inputted parameters.
 	std::map<std::string, std::string> valueMap;
+	// The keywords, whose values aren't split into tokens
+	std::set<std::string> rawKeys;
 
 	// Helper function in scanning of file
-	void parseToken(std::string token);
+	void parseToken(const std::string& token);
 	// Helper function in retrieving a value
 	std::string getValue(std::string key);
 };
@@ -1,4 +1,5 @@
 #include "Integrator.h"
+#include <algorithm>
 #include "Ensemble.h"
 
 
@@ -7,9 +8,42 @@ void Integrator::updateNvtParameters(double* _ln_s, double* _zeta) {
 	*_zeta = zeta;
 }
 
+thermostatT Integrator::getThermostat() {
+	return thermostatT{ T, Ms, ln_s, zeta };
+}
+
+void Integrator::setThermostat(const thermostatT& th) {
+	T = th.T;
+	Ms = th.Ms;
+	ln_s = th.ln_s;
+	zeta = th.zeta;
+}
+
+// Most integrators only keep velocities or accelerations, which are not
+// affected by the rescaling, so the default is to do nothing
+void Integrator::rescale(Atoms*, double) {}
+
+// The accelerations and buffers of most integrators are recalculated from the
+// forces every step, so the default is to do nothing
+void Integrator::reorder(const vector<int>&, int) {}
+
+// Most integrators take the velocities from the Atoms in the next update
+void Integrator::scaleVelocities(Atoms* a, double f) {
+	a->scaleVelocities(f);
+}
+
+void Integrator::setVelocities(Atoms* a, const double* v) {
+	copy(v, v + 3 * (size_t)a->getSize(), a->getVelocities());
+}
+
+// Deterministic integrators don't exchange energy with a reservoir
+double Integrator::getReservoirEnergy() {
+	return 0.0;
+}
+
 
 // The constructor initializes and populates the new and old positions vectors
-Verlet::Verlet(Atoms* a, vector<vector<double>>* F, double diff_t)
+Verlet::Verlet(Atoms* a, const double* F, double diff_t)
 	: oldPos(a->getSize(), vector<double>(3, 0)),
 	nextPos(a->getSize(), vector<double>(3, 0))
 {
@@ -17,7 +51,7 @@ Verlet::Verlet(Atoms* a, vector<vector<double>>* F, double diff_t)
 	for (int i = 0; i < a->getSize(); i++) {
 		vector<double> q = vector<double>(3, 0);
 		for (int j = 0; j < 3; j++) {
-			double acc = (*F)[i][j];
+			double acc = F[3 * i + j] / a->getMass(i);
 			oldPos[i][j] = a->getPos(i)[j] - a->getVel(i)[j] * dt
 				+ 1.0 / 2.0 * acc * dt * dt;
 			nextPos[i][j] = advancePos(a->getPos(i)[j], oldPos[i][j], acc);
@@ -32,14 +66,14 @@ Verlet::~Verlet() {
 }
 
 // The update leaves the positions and the velocities at the same time step.
-void Verlet::update(Atoms* a, vector<vector<double>>* F, Ensemble* ens) {
+void Verlet::update(Atoms* a, const double*, Ensemble* ens) {
 	// Update the positions
 	for (int i = 0; i < a->getSize(); i++) {
 		oldPos[i] = a->getPos(i);	// q(t - dt) = q(t)
 		a->setPos(i, nextPos[i]);	// q(t) = q(t + dt)
 	}
 	// Calculate new forces
-	vector<vector<double>> forces = ens->getForces();
+	const double* forces = ens->getForces();
 
 	// Run through all the atoms and calculate new positions and velocities
 	for (int i = 0; i < a->getSize(); i++) {
@@ -47,7 +81,7 @@ void Verlet::update(Atoms* a, vector<vector<double>>* F, Ensemble* ens) {
 		vector<double> v = vector<double>(3, 0);
 		for (int j = 0; j < 3; j++) {
 			nextPos[i][j] = advancePos(a->getPos(i)[j], oldPos[i][j],
-				forces[i][j]);		// q(t + dt)
+				forces[3 * i + j] / a->getMass(i));		// q(t + dt)
 			v[j] = advanceVel(nextPos[i][j], oldPos[i][j]);
 		}
 
@@ -56,6 +90,58 @@ void Verlet::update(Atoms* a, vector<vector<double>>* F, Ensemble* ens) {
 	}
 }
 
+// The atoms are moved by the shift of their molecular center of mass, so the
+// same shift is applied to the positions at the previous and next time step
+void Verlet::rescale(Atoms* a, double mu) {
+	for (int m = 0; m < a->getNM(); m++) {
+		vector<double> shift = a->getMoleculeCenter(m);
+		for (int k = 0; k < 3; k++) {
+			shift[k] *= mu - 1.0;
+		}
+		for (int i = m * a->getApm(); i < (m + 1) * a->getApm(); i++) {
+			for (int k = 0; k < 3; k++) {
+				oldPos[i][k] += shift[k];
+				nextPos[i][k] += shift[k];
+			}
+		}
+	}
+}
+
+void Verlet::reorder(const vector<int>& order, int apm) {
+	Atoms::reorderMolecules(oldPos, order, apm);
+	Atoms::reorderMolecules(nextPos, order, apm);
+}
+
+// The velocity is (q(t + dt) - q(t - dt)) / 2dt, and the acceleration term
+// is q(t + dt) - 2q(t) + q(t - dt), which is kept, so only the velocity part
+// of the steps is scaled
+void Verlet::scaleVelocities(Atoms* a, double f) {
+	a->scaleVelocities(f);
+	for (int i = 0; i < a->getSize(); i++) {
+		vector<double> q = a->getPos(i);
+		for (int k = 0; k < 3; k++) {
+			double half = 0.5 * (nextPos[i][k] - oldPos[i][k]);
+			double accTerm = 0.5 * (nextPos[i][k] + oldPos[i][k]) - q[k];
+			oldPos[i][k] = q[k] + accTerm - f * half;
+			nextPos[i][k] = q[k] + accTerm + f * half;
+		}
+	}
+}
+
+// The velocity is (next - old) / 2dt, so the steps to the old and next
+// positions become v dt, and the acceleration term stays
+void Verlet::setVelocities(Atoms* a, const double* v) {
+	Integrator::setVelocities(a, v);
+	for (int i = 0; i < a->getSize(); i++) {
+		vector<double> q = a->getPos(i);
+		for (int k = 0; k < 3; k++) {
+			double accTerm = 0.5 * (nextPos[i][k] + oldPos[i][k]) - q[k];
+			oldPos[i][k] = q[k] + accTerm - v[3 * i + k] * dt;
+			nextPos[i][k] = q[k] + accTerm + v[3 * i + k] * dt;
+		}
+	}
+}
+
 double Verlet::advancePos(double q, double oldq, double acc) {
 	// q(t + dt) = 2q(t) - q(t - dt) + a(t) * dt * dt
 	return 2.0 * q - oldq + acc * dt * dt;
@@ -85,39 +171,39 @@ VelVerlet::~VelVerlet() {
 // The update() function works for both NVE and NVT, i.e. in NVT reduecs to
 // NVE when zeta = 0. So regardsless of the value of zeta, the function updates
 // the positions and velocities to the next time step
-void VelVerlet::update(Atoms* a, vector<vector<double>>* F, Ensemble* ens) {
+void VelVerlet::update(Atoms* a, const double* F, Ensemble* ens) {
 	// Calculate all the accelarations
 	calculateAcceleration(a, F);
 	if (Ms != 0.0) {  // if we are not using NVT, we just don't update zeta
-		updateZeta(a, F);
+		updateZeta(a);
 	}
 	// Update the postions in the Atoms object
 	updatePos(a);
 	// The Velocity Verlet method use the forces from the next iteration, so
 	// we recalculate the forces from the now updated positions
-	vector<vector<double>> nextForces = ens->getForces();
+	const double* nextForces = ens->getForces();
 	updateVel(a, nextForces);
 }
 
 // Function for calculating all the accelerations
-void VelVerlet::calculateAcceleration(Atoms* a, vector<vector<double>>* F) {
+void VelVerlet::calculateAcceleration(Atoms* a, const double* F) {
 	// In the case of NVE, zeta = 0, so the calculation reduces to a = F / m
 	for (int i = 0; i < a->getSize(); i++) {
 		vector<double> v = a->getVel(i);
 		for (int j = 0; j < 3; j++) {
-			acc[i][j] = (*F)[i][j] - zeta * v[j];
+			acc[i][j] = F[3 * i + j] / a->getMass(i) - zeta * v[j];
 		}
 	}
 }
 
 // Function for updating the friction coefficient
-void VelVerlet::updateZeta(Atoms* a, vector<vector<double>>* F) {
-	// Calculate the sum of velocity times acceleration
+void VelVerlet::updateZeta(Atoms* a) {
+	// Calculate the sum of mass times velocity times acceleration
 	double forcepos = 0;
 	for (int i = 0; i < a->getSize(); i++) {
 		vector<double> v = a->getVel(i);
 		for (int j = 0; j < 3; j++)	{
-			forcepos += v[j] * acc[i][j];
+			forcepos += a->getMass(i) * v[j] * acc[i][j];
 		}
 	}
 	// Calculate the rate of change of zeta
@@ -145,16 +231,81 @@ void VelVerlet::updatePos(Atoms* a) {
 }
 
 // Function for updating the velocities
-void VelVerlet::updateVel(Atoms* a, vector<vector<double>> nF) {
+void VelVerlet::updateVel(Atoms* a, const double* nF) {
 	for (int i = 0; i < a->getSize(); i++) {
 		vector<double> nextv = { 0.0, 0.0, 0.0 };
 		vector<double> v = a->getVel(i);
 		for (int j = 0; j < 3; j++) {
 			// v(t + dt) = (v(t) + 0.5 * dt * (a(t) + a(t + dt)) 
 			//    / (1 + zeta(t + dt) * 0.5 * dt
-			nextv[j] = (v[j] + dt / 2.0 * (acc[i][j] + nF[i][j]))
+			nextv[j] = (v[j] + dt / 2.0 * (acc[i][j] + nF[3 * i + j] / a->getMass(i)))
 				/ (1.0 + zeta * dt / 2.0);
 		}
 		a->setVel(i, nextv);
 	}
 }
+
+
+// The constructor calculates the damping factors of the O step
+Langevin::Langevin(Atoms* a, double temperature, double diff_t, double rel_t,
+	uint64_t seed)
+	: rng(seed),
+	newPos(a->getSize(), vector<double>(3, 0))
+{
+	dt = diff_t;
+	T = temperature;
+	double gamma = rel_t > 0.0 ? 1.0 / rel_t : 0.0;  // no friction gives NVE
+	c1 = exp(-gamma * dt);
+	c2 = pow(1.0 - c1 * c1, 0.5);
+}
+
+// The destructor releases the memory of the position buffer
+Langevin::~Langevin() {
+	vector<vector<double>>().swap(newPos);
+}
+
+// The update() function takes the forces at the current positions and
+// performs B-A-O-A, then gets the new forces and does the final B
+void Langevin::update(Atoms* a, const double* F, Ensemble* ens) {
+	double dK = 0.0;  // The kinetic energy added in the O step
+	#pragma omp parallel for reduction(+:dK) schedule(static)
+	for (int i = 0; i < a->getSize(); i++) {
+		vector<double> q = a->getPos(i);
+		vector<double> v = a->getVel(i);
+		double m = a->getMass(i);
+		double sigma = pow(T / m, 0.5);  // the thermal velocity, sqrt(kT / m)
+		double g[4];
+		rng.gaussian(i, step, CounterRNG::THERMOSTAT, g);
+		for (int j = 0; j < 3; j++) {
+			v[j] += 0.5 * dt * F[3 * i + j] / m;		// B
+			q[j] += 0.5 * dt * v[j];				// A
+			double vOld = v[j];
+			v[j] = c1 * v[j] + c2 * sigma * g[j];	// O
+			dK += 0.5 * m * (v[j] * v[j] - vOld * vOld);
+			q[j] += 0.5 * dt * v[j];				// A
+		}
+		a->setVel(i, v);
+		newPos[i] = q;
+	}
+	// Setting the positions flags the Atoms, so it is done by one thread
+	for (int i = 0; i < a->getSize(); i++) {
+		a->setPos(i, newPos[i]);
+	}
+	reservoir -= dK;
+	step++;
+
+	// The final half kick uses the forces at the new positions
+	const double* nextForces = ens->getForces();
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < a->getSize(); i++) {
+		vector<double> v = a->getVel(i);
+		for (int j = 0; j < 3; j++) {
+			v[j] += 0.5 * dt * nextForces[3 * i + j] / a->getMass(i);	// B
+		}
+		a->setVel(i, v);
+	}
+}
+
+double Langevin::getReservoirEnergy() {
+	return reservoir;
+}
@@ -2,26 +2,60 @@
 #define _integrator_h
 
 #include "Atoms.h"
+#include "Random.h"
 
 // The Integrator class needs to know about the Ensemble class, but an include
 // breaks things (circular inclusion), so instead we forward declare it
 class Ensemble;
 
 // Enumerator for all the implemented integrators
-enum class InteType { VERLET, VELVERLET };
+enum class InteType { VERLET, VELVERLET, LANGEVIN };
+
+// Structure class for the state of the thermostat, so replicas at different
+// temperatures can exchange it
+struct thermostatT {
+	double T;		// temperature (reduced)
+	double Ms;		// thermal mass (reduced)
+	double ln_s;	// natural log of scaling
+	double zeta;	// 'friction' coefficient
+};
 
 // Abstract class for an integrator for positions and velocities. Implementing
 // classes must implement update()
 class Integrator
 {
 public:
-	// Abstract function for updating positions and velocities to next time step
-	virtual void update(Atoms* atoms, vector<vector<double>>* forces,
-		Ensemble* ens) = 0;
+	// Virtual destructor, so the implementing classes are deleted properly
+	virtual ~Integrator() {}
+
+	// Abstract function for updating positions and velocities to next time
+	// step with the forces at the current positions (x, y, z of the atoms
+	// after each other)
+	virtual void update(Atoms* atoms, const double* forces, Ensemble* ens) = 0;
 
 	// Functions for sending internal parameters up the chain for support for
 	// a wide variety of ensembles
 	void updateNvtParameters(double* ln_s, double* zeta);
+	// Get and set the state of the thermostat
+	thermostatT getThermostat();
+	void setThermostat(const thermostatT& th);
+
+	// Called before the Atoms are rescaled by a barostat, so any stored
+	// positions can be moved along with the atoms
+	virtual void rescale(Atoms* atoms, double mu);
+	// Called when the molecules are reordered, so any stored per-atom data
+	// can follow them
+	virtual void reorder(const vector<int>& order, int apm);
+	// Scale the velocities by f, including any stored positions, which the
+	// next velocities are found from
+	virtual void scaleVelocities(Atoms* atoms, double f);
+	// Set the velocities (x, y, z of the atoms after each other), including
+	// any stored positions, which the next velocities are found from
+	virtual void setVelocities(Atoms* atoms, const double* v);
+
+	// Get the energy that a stochastic heat bath has removed from the system,
+	// so the sum with the energy of the system is conserved
+	virtual double getReservoirEnergy();
 
 protected:
 	// The time step
@@ -40,11 +74,20 @@ class Verlet :
 {
 public:
 	// Constructor and destructor
-	Verlet(Atoms* atoms, vector<vector<double>>* forces, double dt);
+	Verlet(Atoms* atoms, const double* forces, double dt);
 	~Verlet();
 
 	// Implementation of the abstract update() function
-	void update(Atoms* atoms, vector<vector<double>>* forces, Ensemble* ens);
+	void update(Atoms* atoms, const double* forces, Ensemble* ens);
+
+	// Shift the old and next positions like the current ones
+	void rescale(Atoms* atoms, double mu);
+	// Reorder the old and next positions like the current ones
+	void reorder(const vector<int>& order, int apm);
+	// Scale the steps to the old and next positions
+	void scaleVelocities(Atoms* atoms, double f);
+	// Set the steps to the old and next positions from the velocities
+	void setVelocities(Atoms* atoms, const double* v);
 
 private:
 	// The old and next positions have to be saved for the Verlet engine to have
@@ -68,16 +111,47 @@ public:
 	virtual ~VelVerlet();
 
 	// Implementation of the abstract update() function
-	void update(Atoms* atoms, vector<vector<double>>* forces, Ensemble* ens);
+	void update(Atoms* atoms, const double* forces, Ensemble* ens);
 
 private:
 	vector<vector<double>> acc;  // saving the acceleration, since it's used often
 
 	// Private functions for making the update work
-	void calculateAcceleration(Atoms* atoms, vector<vector<double>>* forces);
-	void updateZeta(Atoms* atoms, vector<vector<double>>* forces);
+	void calculateAcceleration(Atoms* atoms, const double* forces);
+	void updateZeta(Atoms* atoms);
 	void updatePos(Atoms* atoms);
-	void updateVel(Atoms* atoms, vector<vector<double>> nextForces);
+	void updateVel(Atoms* atoms, const double* nextForces);
+};
+
+// Implementation of the BAOAB Langevin integrator (Leimkuhler and Matthews,
+// Appl. Math. Res. Express 2013, 34). The velocities get a half kick (B), the
+// positions a half drift (A), the velocities are damped and given a random
+// kick (O), then another half drift and a half kick with the new forces. The
+// O step is local to each atom, so no global reduction is needed to control
+// the temperature, and the random numbers come from a counter-based generator.
+class Langevin :
+	public Integrator
+{
+public:
+	// Constructor and destructor. The friction is the inverse of the
+	// relaxation time.
+	Langevin(Atoms* atoms, double T, double dt, double relaxation_time,
+		uint64_t seed);
+	virtual ~Langevin();
+
+	// Implementation of the abstract update() function
+	void update(Atoms* atoms, const double* forces, Ensemble* ens);
+
+	// The energy removed by the friction and random kicks
+	double getReservoirEnergy();
+
+private:
+	double c1;			// exp(-gamma * dt), the velocity damping
+	double c2;			// sqrt(1 - c1^2), the scaling of the random kick
+	uint64_t step = 0;	// The step counter for the random numbers
+	double reservoir = 0.0;	// The energy removed by the O step
+	CounterRNG rng;
+	vector<vector<double>> newPos;	// Positions after the drift
 };
 
 #endif // !_integrator_h
@@ -4,27 +4,48 @@
 #include <iostream>
 #include <fstream>
 #include <iomanip>
+#include <algorithm>
+#include <memory>
+#include <atomic>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "Atoms.h"
-#include "CellBuilder.h"
-#include "VelocityManager.h"
+#include "Setup.h"
 #include "Ensemble.h"
 #include "dataType.h"
 #include "Analysis.h"
-#include "Parser.h"
+#include "TaskScheduler.h"
+#include "ReplicaExchange.h"
+#include "MonteCarlo.h"
+#include "PerfCounters.h"
+#include "ObservableStore.h"
+#include "Trajectory.h"
 using namespace std;
 
 // Define important constants
-const double kB = 1.38064852e-23;  // Boltzmann's constant
-const double kBeV = 8.6173303360e-5;  //Boltzmann's constant in eV/K
-const double AVOGADRO = 6.022045e+23;  // Avogadro's constant
 const string INFILE = "params.in";  // Name of the input file - should be sysarg at some point.
 const string OUTFILE = "sim.out";  // Name of output file - should be sysarg at some point.
 
+// An immutable copy of the results of a step, which the analysis and output
+// tasks work on, while the next step is calculated
+struct snapshotT {
+	double t, U, K, Hx;			// Time [ps] and energies [eV]
+	vector<vector<double>> P;	// Pressure tensor (reduced)
+	double rhoN;				// Number density (reduced)
+	vector<double> r;			// Positions for the RDF (production only)
+	vector<int> types;			// Atom types for the Widom insertions
+	vector<double> frame;		// Positions in the original order
+	boxT box;					// The box of the positions
+};
+
 // Function prototypes for main
-void GetParameters(dataT* data);
-void InitializeSetup(Atoms* atoms, dataT* data);
 void saveXYZ(Atoms* atoms, dataT* data, string out);
+void logPressureTensor(ofstream& logger, vector<vector<double>> P, double unit);
+vector<double> getObservableRow(double t, double U, double K, double Hx,
+	const vector<vector<double>>& P, double unit);
+void printAverage(string name, AnalysisTools::BlockAverage* av, string unit);
 
 
 // Main program execution routine
@@ -41,13 +62,41 @@ int main()
 
 	// Create the data container and populate it
 	dataT dataContainer;
-	GetParameters(&dataContainer);
+	GetParameters(&dataContainer, INFILE);
+
+	// The analysis runs on worker threads, and the force calculation on the
+	// rest of the threads. The thread count is set before any arrays are
+	// allocated, so they are first touched by the threads that use them.
+	// Every worker is one of the analysis threads, so the parallel loops of
+	// S(k) and the Widom insertions don't add teams next to the forces.
+	TaskScheduler tasks(dataContainer.analysisThreads, 1);
+#ifdef _OPENMP
+	if (dataContainer.analysisThreads > 0) {
+		omp_set_num_threads(max(1,
+			omp_get_max_threads() - dataContainer.analysisThreads));
+	}
+#endif
+	Arena::setHugePages(dataContainer.hugePages != 0);
+	// The hardware counters are opened after the analysis workers, which
+	// open their own, and before the OpenMP threads, which inherit them
+	if (dataContainer.perfCounters != 0) {
+		PerfCounters::enable();
+	}
+
+	// Parallel tempering runs its own loop over the replicas
+	if (dataContainer.nReplicas > 1) {
+		ReplicaExchange rex(&dataContainer);
+		rex.run(logger);
+		logger.close();
+		rex.printSummary();
+		return 0;
+	}
 
 	// Initialize the Atoms object
 	Atoms atoms(dataContainer.apm, dataContainer.mass);
 	// Create the setup of the initial system
 	InitializeSetup(&atoms, &dataContainer);
-	
+
 	// Create an Ensemble object, passing the Atoms object and data container
 	Ensemble* ens = Ensemble::createEnsemble(&atoms, &dataContainer); // should take the Ensemble type as parameter
 
@@ -56,17 +105,75 @@ int main()
 	AnalysisTools::LinearRegressor reg = AnalysisTools::LinearRegressor();
 	AnalysisTools::RadDistribFunc rdf = AnalysisTools::RadDistribFunc(&atoms, &dataContainer);
 	AnalysisTools::Diffusion dico = AnalysisTools::Diffusion(&atoms, &dataContainer);
+	// The structure factor needs an FFT grid, so it is only made on request
+	unique_ptr<AnalysisTools::StructureFactor> sq;
+	if (dataContainer.sqStride > 0) {
+		sq.reset(new AnalysisTools::StructureFactor(&atoms, &dataContainer));
+	}
+	unique_ptr<AnalysisTools::WidomInsertion> widom;
+	if (dataContainer.widomStride > 0) {
+		widom.reset(new AnalysisTools::WidomInsertion(&atoms,
+			ens->getPotential(), &dataContainer));
+	}
+
+	// The potential energy, kinetic energy and pressure are watched for the
+	// end of the equilibration, if it is detected
+	AnalysisTools::EquilibrationDetector eq(3);
+	// The production starts after the equilibration steps at the latest
+	int prodStart = dataContainer.eqSteps + 1;
+	bool production = false;
+	// The observables of the production are averaged with streaming block
+	// averages, which give their errors without storing the series
+	AnalysisTools::BlockAverage Uav, Kav, pav, Z, rhoAv;
+	// The last submitted task of every kind, and whether the requested errors
+	// have been reached
+	int lastLog = -1, lastRDF = -1, lastSq = -1, lastWidom = -1;
+	int lastAverage = -1, lastTraj = -1;
+	atomic<bool> targetReached(false);
+	const int maxPending = 12;  // Unfinished tasks before the simulation waits
 
 	// Initialize the potential and kinetic energy, pressure and the time
 	double U, K, Hx, t = 0;
-	double avPressure = 0;
+	double pressureUnit = dataContainer.epsK * kB
+		/ pow(dataContainer.sigma, 3.0) * 1e30;  // in Pa
+
+	// The observables also go to the columnar binary store, if it is on,
+	// which is read with the MDpost tool
+	unique_ptr<ObservableWriter> obs;
+	if (dataContainer.obsFile.compare("") != 0) {
+		obs.reset(new ObservableWriter(dataContainer.obsFile,
+			{ "t", "U", "K", "Hx", "H", "P", "Pxy", "Pxz", "Pyz" }));
+	}
+	bool text = dataContainer.textLog != 0;
+	// The frames of the production are stored for the analysis with MDpost
+	unique_ptr<TrajectoryWriter> traj;
+	if (dataContainer.trajStride > 0) {
+		traj.reset(new TrajectoryWriter(dataContainer.trajFile,
+			atoms.getSize(), atoms.getApm(), dataContainer.sigma));
+	}
 
 	// Log the header
-	logger << "t\tU\tK\tHx\tH" << endl;
+	if (text) {
+		logger << "t\tU\tK\tHx\tH";
+		if (dataContainer.logPressure) {
+			logger << "\tP\tPxy\tPxz\tPyz";
+		}
+		logger << endl;
+	}
 	// Calculate and log the initial values
 	U = ens->calculate() * dataContainer.eps;  // in eV
 	K = atoms.getEnergy() * dataContainer.eps;  // in eV
-	logger << t << "\t" << U << "\t" << K << "\t" << 0.0 << "\t" << K + U << endl;
+	if (text) {
+		logger << t << "\t" << U << "\t" << K << "\t" << 0.0 << "\t" << K + U;
+		if (dataContainer.logPressure) {
+			logPressureTensor(logger, ens->getPressureTensor(), pressureUnit);
+		}
+		logger << endl;
+	}
+	if (obs) {
+		obs->addRow(getObservableRow(t, U, K, 0.0, ens->getPressureTensor(),
+			pressureUnit));
+	}
 
 	// Add the first point to the regressor
 	reg.addPoint(t, K + U);  // Hx = 0 in the start
@@ -74,44 +181,192 @@ int main()
 	for (int i = 1; i <= dataContainer.simSteps; i++)
 	{
 		// Make the Ensemble update the positions and velocities of the Atoms object
-		Hx = ens->update() * dataContainer.eps;
+		{
+			PerfCounters::Scope scope(PerfCounters::INTEGRATION);
+			Hx = ens->update() * dataContainer.eps;
+		}
 		// Calculate energies
 		U = ens->calculate() * dataContainer.eps;
 		K = atoms.getEnergy() * dataContainer.eps;
 
 		// Log the time and energies
 		t += dataContainer.dt_ps;  // actual time
-		logger << t << "\t" << U << "\t" << K << "\t" << Hx << "\t" 
-			<< K + U + Hx << endl;
-		
+		// The production starts: register start time and positions for
+		// self-diffusion
+		if (i == prodStart) {
+			production = true;
+			dico.start(t * dataContainer.dt_s / dataContainer.dt_ps);
+		}
+		// The pressure tensor comes from the virial of the force calculation
+		bool detecting = !production && dataContainer.eqAuto != 0;
+		vector<vector<double>> P;
+		if (dataContainer.logPressure || production || detecting || obs) {
+			P = ens->getPressureTensor();
+		}
+
 		// Add the time-energy point to the regressor
 		reg.addPoint(t, K + U + Hx);
-		if (i > 10000) {
-			rdf.update();
-			avPressure += ens->getPressure();
+		if (detecting) {
+			eq.addPoint({ U, K, P[0][0] + P[1][1] + P[2][2] });
+			// The truncation points are searched every 100 steps
+			if (i % 100 == 0 && eq.isEquilibrated()) {
+				prodStart = i + 1;
+				cout << "Equilibrated after " << i << " steps" << endl;
+			}
 		}
 
-		// Register start time and positions for self-diffusion
-		if (i == 10001)	{
-			dico.start(t * dataContainer.dt_s / dataContainer.dt_ps);
+		// Submit the output and the analysis of the step as tasks on its
+		// snapshot. Every kind of task depends on the one of the step before,
+		// so the log lines and the samples stay in order.
+		shared_ptr<snapshotT> s = make_shared<snapshotT>();
+		s->t = t;
+		s->U = U;
+		s->K = K;
+		s->Hx = Hx;
+		s->P = P;
+		s->box = atoms.getBox();
+		s->rhoN = atoms.getNM() / s->box.getVolume();
+		lastLog = tasks.submit([&logger, &dataContainer, &obs, text,
+			pressureUnit, s]() {
+			PerfCounters::Scope scope(PerfCounters::ANALYSIS);
+			if (text) {
+				logger << s->t << "\t" << s->U << "\t" << s->K << "\t" << s->Hx
+					<< "\t" << s->K + s->U + s->Hx;
+				if (dataContainer.logPressure) {
+					logPressureTensor(logger, s->P, pressureUnit);
+				}
+				logger << endl;
+			}
+			if (obs) {
+				obs->addRow(getObservableRow(s->t, s->U, s->K, s->Hx, s->P,
+					pressureUnit));
+			}
+		}, { lastLog });
+
+		if (production) {
+			s->r.resize(3 * (size_t)atoms.getSize());
+			for (int j = 0; j < atoms.getSize(); j++) {
+				vector<double> p = atoms.getPos(j);
+				for (int k = 0; k < 3; k++) {
+					s->r[3 * (size_t)j + k] = p[k];
+				}
+			}
+			lastRDF = tasks.submit([&rdf, s]() {
+				PerfCounters::Scope scope(PerfCounters::ANALYSIS);
+				rdf.update(s->r, s->box);
+			}, { lastRDF });
+			if (sq && (i - prodStart) % dataContainer.sqStride == 0) {
+				lastSq = tasks.submit([&sq, s]() {
+					PerfCounters::Scope scope(PerfCounters::ANALYSIS);
+					sq->update(s->r, s->box);
+				}, { lastSq });
+			}
+			if (widom && (i - prodStart) % dataContainer.widomStride == 0) {
+				s->types.resize(atoms.getSize());
+				for (int j = 0; j < atoms.getSize(); j++) {
+					s->types[j] = atoms.getType(j);
+				}
+				lastWidom = tasks.submit([&widom, s]() {
+					PerfCounters::Scope scope(PerfCounters::ANALYSIS);
+					widom->update(s->r, s->types, s->box);
+				}, { lastWidom });
+			}
+			// The frames are in the original order, so the atoms can be
+			// followed from frame to frame
+			if (traj && (i - prodStart) % dataContainer.trajStride == 0) {
+				s->frame.resize(s->r.size());
+				for (int j = 0; j < atoms.getSize(); j++) {
+					int o = atoms.getOriginalIndex(j);
+					for (int k = 0; k < 3; k++) {
+						s->frame[3 * (size_t)o + k] = s->r[3 * (size_t)j + k];
+					}
+				}
+				lastTraj = tasks.submit([&traj, s]() {
+					PerfCounters::Scope scope(PerfCounters::ANALYSIS);
+					traj->addFrame(s->t, s->box, s->frame);
+				}, { lastTraj });
+			}
+			lastAverage = tasks.submit([&, s]() {
+				PerfCounters::Scope scope(PerfCounters::ANALYSIS);
+				double p = (s->P[0][0] + s->P[1][1] + s->P[2][2]) / 3.0;
+				Uav.addPoint(s->U);
+				Kav.addPoint(s->K);
+				pav.addPoint(p * pressureUnit);
+				Z.addPoint(p / s->rhoN / dataContainer.T_s);
+				rhoAv.addPoint(s->rhoN);
+				// The errors are only reliable, when they have reached a
+				// plateau
+				bool targetU = dataContainer.targetError > 0.0;
+				bool targetZ = dataContainer.targetErrorZ > 0.0;
+				if ((targetU || targetZ)
+					&& (!targetU || (Uav.isConverged() && Uav.getError()
+						<= dataContainer.targetError * abs(Uav.getMean())))
+					&& (!targetZ || (Z.isConverged()
+						&& Z.getError() <= dataContainer.targetErrorZ))) {
+					targetReached = true;
+				}
+			}, { lastAverage });
 		}
-	}
+		// The analysis may only lag a few steps behind
+		tasks.waitPending(maxPending);
 
-	// Calculate average pressure for the steps after 10000
-	avPressure = avPressure/(dataContainer.simSteps - 10000.0);
+		// Sort the molecules spatially, so the pair loop stays cache friendly
+		if (dataContainer.reorderInterval > 0
+			&& i % dataContainer.reorderInterval == 0) {
+			ens->reorder();
+		}
+
+		// End the production, when the requested errors are small enough.
+		// The analysis may be a few steps behind the simulation.
+		if (targetReached) {
+			break;
+		}
+	}
+	tasks.waitAll();
+	if (targetReached) {
+		cout << "Target error reached after " << Z.getSamples()
+			<< " production steps" << endl;
+	}
 
 	// Close the logger and write regression data to the console
 	logger.close();
+	if (obs) {
+		obs->close();
+	}
+	if (traj) {
+		traj->close();
+	}
 	cout << "dt = " << dataContainer.dt_ps << endl;
 	cout << "a = " << reg.getSlope() << " eV/ps" << endl;
 	cout << "b = " << reg.getIntersect() << " eV" << endl;
-	cout << "p = " << ens->getPressure() * dataContainer.epsK * kB
-		/ pow(dataContainer.sigma, 3.0) * 1e30 << " Pa" << endl;
-	cout << "Z = " << avPressure/dataContainer.rhoN
-		/dataContainer.T_s << endl;
+	// The averages of the production with their standard errors. Errors
+	// without a plateau in the blocking are marked as lower bounds.
+	printAverage("p", &pav, "Pa");
+	printAverage("U", &Uav, "eV");
+	printAverage("K", &Kav, "eV");
+	printAverage("Z", &Z, "");
+	if (dataContainer.ET == EnsType::NPT) {
+		double molMass = atoms.getTotalMass() / atoms.getNM()
+			* dataContainer.mass;
+		double rhoUnit = molMass / AVOGADRO / pow(dataContainer.sigma, 3.0)
+			* 1e24;
+		cout << "rho = " << rhoAv.getMean() * rhoUnit << " +- "
+			<< rhoAv.getError() * rhoUnit << " g/cm^3"
+			<< (rhoAv.isConverged() ? "" : " (lower bound)") << endl;
+	}
+	if (widom) {
+		cout << "mu_ex = " << widom->getChemicalPotential() * dataContainer.eps
+			<< " +- " << widom->getError() * dataContainer.eps << " eV" << endl;
+	}
+	MonteCarlo* mc = dynamic_cast<MonteCarlo*>(ens);
+	if (mc != nullptr) {
+		mc->printAcceptance();
+	}
+	PerfCounters::print(ens->getPotential()->getPairCount());
+	double diffUnit = pow(dataContainer.sigma, 2.0) * 1e-8;
 	cout << "D = " << dico.getDiffu(t* dataContainer.dt_s 
-		/ dataContainer.dt_ps) * pow(dataContainer.sigma, 2.0) * 1e-8
-		<< " m^2/s" << endl;
+		/ dataContainer.dt_ps) * diffUnit << " +- "
+		<< dico.getError() * diffUnit << " m^2/s" << endl;
 	
 	vector<vector<double>> graph = rdf.getRDF();
 	ofstream rdfgraph("rdf.txt");
@@ -128,72 +383,20 @@ int main()
 	}
 	rdfgraph.close();
 
-	return 0;  // End program execution
-}
-
-
-// Function for population the data container from the input file
-void GetParameters(dataT *d) {
-	// Parse the input file
-	Parser ps(INFILE, d);
-
-	// Calculate reduced parameters
-	double mu = (d->mass * d->mass) / (2 * d->mass) 
-		/ (AVOGADRO * 1000.0);
-
-	d->dt_s = pow(d->epsK * kB / (mu * pow(d->sigma, 2)), 0.5) 
-		* 1.0e-12 * 1.0e+10 * d->dt_ps;
-
-	// The reduced temperature is given by T_s = T * kB / eps = T / epsK
-	d->T_s = d->T / d->epsK;
-
-	d->eps = d->epsK * kBeV;
-
-	// The reduced relaxation can be determined from the factor for dt_s
-	d->tau_s_s = d->tau_s * d->dt_s / d->dt_ps;
-
-	// Reduced bond distances and force constants
-	double redFact = d->sigma * d->sigma / d->eps;
-	for (double &k : d->ks) {
-		k *= redFact;
-	}
-
-	for (double &r : d->r_eqs) {
-		r /= d->sigma;
-	}
-}
-
-// Function for creating the initial configuration of the system
-void InitializeSetup(Atoms* a, dataT* d) {
-	if (d->pos.size() != d->apm * 3.0) {
-		string em = "Not enough positions were given! Found: "
-			+ to_string(d->pos.size()) + " , but expected: "
-			+ to_string(d->apm * (__int64)3);
-		cout << em << endl;
-		exit(-1);
-	}
-
-	for (int i = 0; i < d->apm; i++) {
-		a->setPos(i, vector<double>{
-			d->pos[(__int64)3 * i] / d->sigma,
-			d->pos[(__int64)3 * i + (__int64)1] / d->sigma,
-			d->pos[(__int64)3 * i + (__int64)2] / d->sigma
-		});
-	}
-
-	if (d->bonds.size() % 2 == 1) {
-		cout << "Bonds not given as pairs" << endl;
-		exit(-1);
+	if (sq) {
+		ofstream sqgraph("sq.txt");
+		if (!sqgraph.is_open()) {
+			cout << "Couldn't open S(k) output file. Exiting." << endl;
+			return -1;
+		}
+		sqgraph << "k" << "\t" << "S_k" << endl;
+		for (vector<double> c : sq->getSk()) {
+			sqgraph << c[0] << "\t" << c[1] << endl;
+		}
+		sqgraph.close();
 	}
-	a->setBonds(d->bonds, d->ks, d->r_eqs);
 
-	// Calculate number density in m^{-3}
-	double rhoN = AVOGADRO / (d->apm * d->mass) * d->rho * 1e-24 * pow(d->sigma, 3);
-	d->rhoN = rhoN;
-	// Build the cell (with a static call)
-	CellBuilder::buildCell(a, d->nMolecules, rhoN);
-	// Initialize the velocities
-	VelocityManager::initializeVelocities(a, d->T_s);
+	return 0;  // End program execution
 }
 
 
@@ -201,9 +404,14 @@ void saveXYZ(Atoms* a, dataT* d, string out) {
 	ofstream outfile(out + ".xyz");
 	if (outfile.is_open()) {
 		outfile << a->getSize() << endl << endl;
+		// Write the atoms in their original order, regardless of reordering
+		vector<int> current(a->getSize());
+		for (int i = 0; i < a->getSize(); i++) {
+			current[a->getOriginalIndex(i)] = i;
+		}
 		for (int i = 0; i < a->getSize(); i++) {
 			outfile << setw(3) << "Ar";
-			vector<double> q = a->getPos(i);
+			vector<double> q = a->getPos(current[i]);
 			for (int j = 0; j < 3; j++) {
 				outfile << setw(15) << fixed << setprecision(5) 
 					<< q[j] * d->sigma;
@@ -216,4 +424,33 @@ void saveXYZ(Atoms* a, dataT* d, string out) {
 		cout << "Couldn't open output file" << endl;
 		exit(-1);
 	}
-}
\ No newline at end of file
+}
+
+// Write the scalar pressure and the off-diagonal elements of the pressure
+// tensor, which are the input for a Green-Kubo viscosity, to the log
+void logPressureTensor(ofstream& logger, vector<vector<double>> P, double unit) {
+	logger << "\t" << (P[0][0] + P[1][1] + P[2][2]) / 3.0 * unit
+		<< "\t" << P[0][1] * unit << "\t" << P[0][2] * unit
+		<< "\t" << P[1][2] * unit;
+}
+
+// The row of the observable store has the energies, and the pressure and
+// its off-diagonal elements in Pa
+vector<double> getObservableRow(double t, double U, double K, double Hx,
+	const vector<vector<double>>& P, double unit) {
+	return { t, U, K, Hx, K + U + Hx,
+		(P[0][0] + P[1][1] + P[2][2]) / 3.0 * unit,
+		P[0][1] * unit, P[0][2] * unit, P[1][2] * unit };
+}
+
+// Print the mean and the standard error of an observable
+void printAverage(string name, AnalysisTools::BlockAverage* av, string unit) {
+	cout << name << " = " << av->getMean() << " +- " << av->getError();
+	if (unit.compare("") != 0) {
+		cout << " " << unit;
+	}
+	if (!av->isConverged()) {
+		cout << " (lower bound)";
+	}
+	cout << endl;
+}
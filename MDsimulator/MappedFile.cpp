@@ -0,0 +1,58 @@
+#include "MappedFile.h"
+#include <iostream>
+#include <cstdlib>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(string filename, bool sequential) {
+#ifdef _WIN32
+	(void)sequential;
+	HANDLE f = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+		NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (f == INVALID_HANDLE_VALUE) fail(filename);
+	file = f;
+	LARGE_INTEGER length;
+	GetFileSizeEx(f, &length);
+	size = static_cast<size_t>(length.QuadPart);
+	if (size == 0) return;
+	mapping = CreateFileMappingA(f, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL) fail(filename);
+	data = static_cast<const char*>(
+		MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (data == NULL) fail(filename);
+#else
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) fail(filename);
+	struct stat st;
+	fstat(fd, &st);
+	size = static_cast<size_t>(st.st_size);
+	if (size > 0) {
+		void* p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p == MAP_FAILED) fail(filename);
+		data = static_cast<const char*>(p);
+		madvise(p, size, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+	}
+	close(fd);  // The mapping keeps its own reference
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef _WIN32
+	if (data != nullptr) UnmapViewOfFile(data);
+	if (mapping != nullptr) CloseHandle(mapping);
+	if (file != nullptr) CloseHandle(file);
+#else
+	if (data != nullptr) munmap(const_cast<char*>(data), size);
+#endif
+}
+
+void MappedFile::fail(string filename) {
+	cout << "Couldn't open the file '" << filename << "'" << endl;
+	exit(-1);
+}
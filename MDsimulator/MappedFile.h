@@ -0,0 +1,33 @@
+#ifndef _mappedfile_h
+#define _mappedfile_h
+
+#include <string>
+
+using namespace std;
+
+// Read-only memory mapping of a whole file, which is unmapped again when it
+// goes out of scope. The program exits, if the file can't be mapped.
+class MappedFile
+{
+public:
+	// Map the file. A sequential file is read from start to end, so the
+	// system can read ahead, while the others are read in random places.
+	MappedFile(string filename, bool sequential = true);
+	~MappedFile();
+
+	const char* data = nullptr;
+	size_t size = 0;
+
+private:
+	// The handles of the file and the mapping (Windows only)
+	void* file = nullptr;
+	void* mapping = nullptr;
+
+	void fail(string filename);
+
+	// The mapping can't be copied
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+};
+
+#endif // !_mappedfile_h
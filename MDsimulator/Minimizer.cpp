@@ -0,0 +1,209 @@
+#include "Minimizer.h"
+#include <iostream>
+
+// The tolerance is converted to reduced units, and the result is reported in
+// eV and eV/Angstrom. The Potential is only used for the minimization, so the
+// Ensemble creates its own for the new positions afterwards.
+int Minimizer::minimize(Atoms* atoms, dataT* d) {
+	string name;
+	Potential* pot = Potential::createPotential(atoms, d);
+	double fTol = d->minForce * d->sigma / d->eps;
+	int steps = 0;
+	switch (d->MT)
+	{
+	case MinType::FIRE:
+		name = "FIRE";
+		steps = fire(atoms, pot, d->dt_s, fTol, d->minSteps);
+		break;
+	case MinType::CG:
+		name = "CG";
+		steps = conjugateGradient(atoms, pot, fTol, d->minSteps);
+		break;
+	// Nothing to do without a scheme
+	default:
+		delete pot;
+		return 0;
+	}
+	double maxF = getMaxForce(pot->getForces());
+	cout << name << ": U = " << pot->getEnergy() * d->eps << " eV, max force = "
+		<< maxF * d->eps / d->sigma << " eV/Angstrom after " << steps
+		<< " steps" << endl;
+	if (maxF >= fTol) {
+		cout << name << " did not reach the force tolerance of " << d->minForce
+			<< " eV/Angstrom" << endl;
+	}
+	delete pot;
+	// The center of mass may have drifted a bit
+	atoms->center();
+	return steps;
+}
+
+// FIRE 2.0 (Guenole et al., Comput. Mater. Sci. 175, 109584) with the
+// semi-implicit Euler integration. A step uphill stops the atoms, moves
+// them half a step back and restarts with a smaller dt.
+int Minimizer::fire(Atoms* atoms, Potential* pot, double dt, double fTol,
+	int maxSteps) {
+	int N = atoms->getSize();
+	vector<double> x(3 * (size_t)N), v(3 * (size_t)N, 0.0);
+	for (int i = 0; i < N; i++) {
+		vector<double> p = atoms->getPos(i);
+		for (int k = 0; k < 3; k++) {
+			x[3 * (size_t)i + k] = p[k];
+		}
+	}
+	double dtMax = fireMaxDt * dt;
+	double alpha = fireAlpha;
+	int nPositive = 0;
+	vector<vector<double>> F = pot->getForces();
+	int step = 0;
+	for (; step < maxSteps && getMaxForce(F) >= fTol; step++) {
+		double power = 0.0;
+		#pragma omp parallel for schedule(static) reduction(+:power)
+		for (int i = 0; i < N; i++) {
+			for (int k = 0; k < 3; k++) {
+				power += F[i][k] * v[3 * (size_t)i + k];
+			}
+		}
+		if (power > 0.0) {
+			nPositive++;
+			if (nPositive > fireDelay) {
+				dt = fmin(dt * fireInc, dtMax);
+				alpha *= fireAlphaDec;
+			}
+		} else {
+			nPositive = 0;
+			dt *= fireDec;
+			alpha = fireAlpha;
+			for (size_t j = 0; j < x.size(); j++) {
+				x[j] -= 0.5 * dt * v[j];
+				v[j] = 0.0;
+			}
+		}
+
+		// Accelerate, and mix the velocities towards the forces
+		double vv = 0.0, ff = 0.0;
+		#pragma omp parallel for schedule(static) reduction(+:vv,ff)
+		for (int i = 0; i < N; i++) {
+			double m = atoms->getMass(i);
+			for (int k = 0; k < 3; k++) {
+				double& vk = v[3 * (size_t)i + k];
+				vk += dt * F[i][k] / m;
+				vv += vk * vk;
+				ff += F[i][k] * F[i][k];
+			}
+		}
+		double mix = ff > 0.0 ? alpha * sqrt(vv / ff) : 0.0;
+		#pragma omp parallel for schedule(static)
+		for (int i = 0; i < N; i++) {
+			for (int k = 0; k < 3; k++) {
+				size_t j = 3 * (size_t)i + k;
+				v[j] = (1.0 - alpha) * v[j] + mix * F[i][k];
+				x[j] += dt * v[j];
+			}
+		}
+		atoms->setPositions(x);
+		F = pot->getForces();
+	}
+	return step;
+}
+
+// The search direction is mixed from the forces and the last direction. The
+// line search starts from twice the last accepted step, but never moves an
+// atom more than maxStep, and halves the step until the energy has decreased
+// sufficiently.
+int Minimizer::conjugateGradient(Atoms* atoms, Potential* pot, double fTol,
+	int maxSteps) {
+	int N = atoms->getSize();
+	vector<vector<double>> x(N), F = pot->getForces();
+	for (int i = 0; i < N; i++) {
+		x[i] = atoms->getPos(i);
+	}
+	double U = pot->getEnergy();
+	vector<vector<double>> d = F;
+	double lastStep = 0.0;
+	int step = 0;
+	for (; step < maxSteps && getMaxForce(F) >= fTol; step++) {
+		double slope = 0.0;
+		for (int i = 0; i < N; i++) {
+			for (int k = 0; k < 3; k++) {
+				slope += F[i][k] * d[i][k];
+			}
+		}
+		// Restart along the forces, if the direction isn't downhill
+		if (slope <= 0.0) {
+			d = F;
+			slope = 0.0;
+			for (int i = 0; i < N; i++) {
+				for (int k = 0; k < 3; k++) {
+					slope += F[i][k] * F[i][k];
+				}
+			}
+		}
+		double trial = maxStep / getMaxForce(d);
+		if (lastStep > 0.0) {
+			trial = fmin(trial, 2.0 * lastStep);
+		}
+
+		bool accepted = false;
+		vector<vector<double>> F_new;
+		double U_new = U;
+		for (int h = 0; h < maxHalvings && !accepted; h++) {
+			displace(atoms, x, d, trial);
+			F_new = pot->getForces();
+			U_new = pot->getEnergy();
+			if (U_new <= U - armijo * trial * slope) {
+				accepted = true;
+			} else {
+				trial *= 0.5;
+			}
+		}
+		if (!accepted) {
+			// No decrease is possible along the direction
+			displace(atoms, x, d, 0.0);
+			break;
+		}
+		lastStep = trial;
+		for (int i = 0; i < N; i++) {
+			x[i] = atoms->getPos(i);
+		}
+
+		// Polak-Ribiere, which is reset when it becomes negative
+		double num = 0.0, den = 0.0;
+		for (int i = 0; i < N; i++) {
+			for (int k = 0; k < 3; k++) {
+				num += F_new[i][k] * (F_new[i][k] - F[i][k]);
+				den += F[i][k] * F[i][k];
+			}
+		}
+		double beta = den > 0.0 ? fmax(0.0, num / den) : 0.0;
+		for (int i = 0; i < N; i++) {
+			for (int k = 0; k < 3; k++) {
+				d[i][k] = F_new[i][k] + beta * d[i][k];
+			}
+		}
+		F = F_new;
+		U = U_new;
+	}
+	return step;
+}
+
+double Minimizer::getMaxForce(const vector<vector<double>>& F) {
+	double maxF2 = 0.0;
+	for (const vector<double>& f : F) {
+		maxF2 = fmax(maxF2, f[0] * f[0] + f[1] * f[1] + f[2] * f[2]);
+	}
+	return sqrt(maxF2);
+}
+
+void Minimizer::displace(Atoms* atoms, const vector<vector<double>>& from,
+	const vector<vector<double>>& d, double step) {
+	int N = atoms->getSize();
+	vector<double> r(3 * (size_t)N);
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < N; i++) {
+		for (int k = 0; k < 3; k++) {
+			r[3 * (size_t)i + k] = from[i][k] + step * d[i][k];
+		}
+	}
+	atoms->setPositions(r);
+}
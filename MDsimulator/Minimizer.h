@@ -0,0 +1,52 @@
+#ifndef _minimizer_h
+#define _minimizer_h
+
+#include "Potential.h"
+#include "dataType.h"
+
+// Enumerator containing the implemented minimization schemes
+enum class MinType { NONE, FIRE, CG };
+
+// Static class for relaxing the initial configuration to a local minimum of
+// the potential energy, before the velocities are initialized. The lattice
+// of rigid molecules can have large forces, which otherwise require a small
+// time step during the first part of the equilibration. The forces come from
+// the same Potential engine as in the simulation.
+class Minimizer
+{
+public:
+	// Static function for minimizing the energy of the Atoms with the scheme
+	// of the data, until the largest force on an atom is below the tolerance
+	// or the maximum number of steps is reached. Returns the number of steps.
+	static int minimize(Atoms* atoms, dataT* data);
+
+private:
+	// Constants for FIRE (Bitzek et al., Phys. Rev. Lett. 97, 170201)
+	static constexpr int fireDelay = 5;			// Steps before dt grows
+	static constexpr double fireInc = 1.1;		// Growth of dt
+	static constexpr double fireDec = 0.5;		// Reduction of dt
+	static constexpr double fireAlpha = 0.1;	// Initial mixing
+	static constexpr double fireAlphaDec = 0.99;	// Reduction of the mixing
+	static constexpr double fireMaxDt = 10.0;	// The largest dt / initial dt
+
+	// Constants for the line search of the conjugate gradients
+	static constexpr double maxStep = 0.1;		// Largest trial displacement
+	static constexpr double armijo = 1e-4;		// Sufficient decrease
+	static constexpr int maxHalvings = 20;		// Trial steps per line search
+
+	// Fast inertial relaxation: damped dynamics, where the velocities are
+	// mixed towards the forces, while the power F * v is positive
+	static int fire(Atoms* atoms, Potential* pot, double dt, double fTol,
+		int maxSteps);
+	// Polak-Ribiere conjugate gradients with a backtracking line search
+	static int conjugateGradient(Atoms* atoms, Potential* pot, double fTol,
+		int maxSteps);
+
+	// Get the largest force on an atom
+	static double getMaxForce(const vector<vector<double>>& F);
+	// Move every atom by step * d
+	static void displace(Atoms* atoms, const vector<vector<double>>& from,
+		const vector<vector<double>>& d, double step);
+};
+
+#endif // !_minimizer_h
@@ -0,0 +1,290 @@
+#include "MonteCarlo.h"
+#include <iostream>
+#include <algorithm>
+
+// The trial steps are given in Angstrom and reduced here. The extent of the
+// molecules is fixed, since they move as rigid bodies.
+MonteCarlo::MonteCarlo(Atoms* a, dataT* d)
+	: Ensemble(a, d), rng(static_cast<uint64_t>(d->seed))
+{
+	if (a->hasCharges()) {
+		cout << "Monte Carlo doesn't support partial charges" << endl;
+		exit(-1);
+	}
+	isobaric = d->ET == EnsType::NPT;
+	checkerboard = d->mcCheckerboard != 0;
+	T = d->T_s;
+	P = d->P_s;
+	maxDisplacement = d->mcDisplacement / d->sigma;
+	maxLogVolume = d->mcVolume;
+	eqSweeps = d->eqSteps;
+
+	int apm = a->getApm();
+	const double* x = a->getPositions();
+	for (int m = 0; m < a->getNM(); m++) {
+		double C[3] = { 0.0, 0.0, 0.0 };
+		for (int i = m * apm; i < (m + 1) * apm; i++) {
+			for (int k = 0; k < 3; k++) {
+				C[k] += x[3 * (size_t)i + k] / apm;
+			}
+		}
+		for (int i = m * apm; i < (m + 1) * apm; i++) {
+			double rr = 0.0;
+			for (int k = 0; k < 3; k++) {
+				double dk = x[3 * (size_t)i + k] - C[k];
+				rr += dk * dk;
+			}
+			rMol = fmax(rMol, sqrt(rr));
+		}
+	}
+	buildGrid();
+	if (checkerboard && !hasCheckerboard()) {
+		cout << "The box is too small for checkerboard sweeps, so the sweeps "
+			<< "are serial" << endl;
+	}
+}
+
+// The volume move comes first, so the grid is built for the new box
+double MonteCarlo::update() {
+	if (isobaric) {
+		tryVolume();
+	}
+	buildGrid();
+	long long before = accepted;
+	if (checkerboard && hasCheckerboard()) {
+		sweepCheckerboard();
+	} else {
+		sweepSerial();
+	}
+	atoms->setPositions(r);
+
+	// Aim for half of the moves accepted during the equilibration. The step
+	// size is kept fixed afterwards, so the moves stay reversible.
+	if (sweep < static_cast<uint64_t>(eqSweeps)) {
+		double ratio = (accepted - before) / static_cast<double>(atoms->getNM());
+		maxDisplacement *= ratio > 0.5 ? 1.05 : 0.95;
+		maxDisplacement = fmin(maxDisplacement,
+			0.5 * atoms->getBox().getMinimumWidth());
+	}
+	sweep++;
+	return 0.0;
+}
+
+void MonteCarlo::printAcceptance() {
+	cout << "MC acceptance = " << (tried > 0
+		? accepted / static_cast<double>(tried) : 0.0)
+		<< " (largest displacement " << maxDisplacement << " sigma)" << endl;
+	if (isobaric) {
+		cout << "MC volume acceptance = " << (volumeTried > 0
+			? volumeAccepted / static_cast<double>(volumeTried) : 0.0)
+			<< " (largest change of ln V " << maxLogVolume << ")" << endl;
+	}
+}
+
+// The cells are at least r_c + 2 rMol wide, so every atom within the cut-off
+// of a molecule belongs to a molecule in the 27 cells around its center.
+// Without a cut-off all the molecules are in one cell.
+void MonteCarlo::buildGrid() {
+	int apm = atoms->getApm();
+	int nm = atoms->getNM();
+	const double* x = atoms->getPositions();
+	r.assign(x, x + 3 * (size_t)atoms->getSize());
+
+	// The ids of the molecules are used by the moves, so the shift has the
+	// next one. The checkerboard has an even number of cells along each axis,
+	// so neighbouring cells have different colours across the boundary.
+	double shift[4] = { 0.0, 0.0, 0.0, 0.0 };
+	if (checkerboard) {
+		rng.uniform(nm, 3 * sweep, CounterRNG::MONTE_CARLO, shift);
+	}
+	double r_c = Pot->getCutoff();
+	grid.setup(atoms->getBox(), r_c == 0.0 ? 0.0 : r_c + 2.0 * rMol,
+		checkerboard, shift);
+
+	centers.resize(3 * (size_t)nm);
+	for (int m = 0; m < nm; m++) {
+		double* C = &centers[3 * (size_t)m];
+		C[0] = C[1] = C[2] = 0.0;
+		for (int i = m * apm; i < (m + 1) * apm; i++) {
+			for (int k = 0; k < 3; k++) {
+				C[k] += r[3 * (size_t)i + k] / apm;
+			}
+		}
+		grid.add(m, C);
+	}
+}
+
+bool MonteCarlo::hasCheckerboard() {
+	return grid.getCellsPerAxis(0) >= 2 && grid.getCellsPerAxis(1) >= 2
+		&& grid.getCellsPerAxis(2) >= 2;
+}
+
+// The intramolecular energy doesn't change in a rigid move, so only the
+// pairs with the atoms of the other molecules are summed
+double MonteCarlo::getEnergy(int m, const double* p) {
+	int apm = atoms->getApm();
+	const boxT& box = atoms->getBox();
+	double r_c = Pot->getCutoff();
+	double R[3] = { 0.0, 0.0, 0.0 };
+	for (int a = 0; a < apm; a++) {
+		for (int k = 0; k < 3; k++) {
+			R[k] += p[3 * a + k] / apm;
+		}
+	}
+	double U = 0.0;
+	for (int nb : grid.getCellsAround(grid.getCellIndex(R))) {
+		for (int n : grid.getPoints(nb)) {
+			if (n == m) continue;
+			for (int a = 0; a < apm; a++) {
+				for (int j = n * apm; j < (n + 1) * apm; j++) {
+					double d[3];
+					for (int k = 0; k < 3; k++) {
+						d[k] = p[3 * a + k] - r[3 * (size_t)j + k];
+					}
+					box.minimumImage(d);
+					double rr = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+					if (r_c != 0.0 && rr >= r_c * r_c) continue;
+					U += Pot->getPairEnergy(atoms->getType(m * apm + a),
+						atoms->getType(j), sqrt(rr));
+				}
+			}
+		}
+	}
+	return U;
+}
+
+// The center is displaced uniformly within maxDisplacement along each axis,
+// and the molecule is rotated by a vector uniform within maxDisplacement /
+// rMol along each axis, so the reverse move is as likely as the move.
+bool MonteCarlo::tryMove(int m, uint32_t id, bool stayInCell) {
+	int apm = atoms->getApm();
+	double u[4], w[4];
+	rng.uniform(id, 3 * sweep, CounterRNG::MONTE_CARLO, u);
+	rng.uniform(id, 3 * sweep + 1, CounterRNG::MONTE_CARLO, w);
+	const double* C = &centers[3 * (size_t)m];
+	double newC[3];
+	for (int k = 0; k < 3; k++) {
+		newC[k] = C[k] + maxDisplacement * (2.0 * u[k] - 1.0);
+	}
+	int newCell = grid.getCellIndex(newC);
+	if (stayInCell && newCell != grid.getCell(m)) {
+		return false;
+	}
+
+	// Rodrigues' rotation of the atoms about the center
+	double axis[3] = { 0.0, 0.0, 0.0 }, angle = 0.0;
+	if (apm > 1 && rMol > 0.0) {
+		for (int k = 0; k < 3; k++) {
+			axis[k] = maxDisplacement / rMol * (2.0 * w[k] - 1.0);
+			angle += axis[k] * axis[k];
+		}
+		angle = sqrt(angle);
+		for (int k = 0; k < 3; k++) {
+			axis[k] /= angle;
+		}
+	}
+	double cosA = cos(angle), sinA = sin(angle);
+	vector<double> p(3 * (size_t)apm);
+	for (int a = 0; a < apm; a++) {
+		double v[3];
+		for (int k = 0; k < 3; k++) {
+			v[k] = r[3 * ((size_t)m * apm + a) + k] - C[k];
+		}
+		double kv = axis[0] * v[0] + axis[1] * v[1] + axis[2] * v[2];
+		double kxv[3] = { axis[1] * v[2] - axis[2] * v[1],
+			axis[2] * v[0] - axis[0] * v[2], axis[0] * v[1] - axis[1] * v[0] };
+		for (int k = 0; k < 3; k++) {
+			p[3 * a + k] = newC[k] + v[k] * cosA + kxv[k] * sinA
+				+ axis[k] * kv * (1.0 - cosA);
+		}
+	}
+
+	double dU = getEnergy(m, p.data()) - getEnergy(m, &r[3 * (size_t)m * apm]);
+	if (dU > 0.0 && u[3] >= exp(-dU / T)) {
+		return false;
+	}
+	for (int a = 0; a < 3 * apm; a++) {
+		r[3 * (size_t)m * apm + a] = p[a];
+	}
+	for (int k = 0; k < 3; k++) {
+		centers[3 * (size_t)m + k] = newC[k];
+	}
+	grid.move(m, newCell);
+	return true;
+}
+
+// ln V is changed uniformly, and the centers are scaled with the box. The
+// move is accepted with min(1, exp[-(dU + P dV) / T + (N + 1) dlnV]) for N
+// molecules. The energies are the full ones of the Potential, since every
+// pair changes.
+void MonteCarlo::tryVolume() {
+	double u[4];
+	rng.uniform(0, sweep, CounterRNG::VOLUME_MOVE, u);
+	double dlnV = maxLogVolume * (2.0 * u[0] - 1.0);
+	double mu = exp(dlnV / 3.0);
+	double U0 = Pot->getEnergy();
+	boxT box = atoms->getBox();
+	const double* x = atoms->getPositions();
+	vector<double> saved(x, x + 3 * (size_t)atoms->getSize());
+
+	atoms->rescale(mu);
+	Pot->rescale(mu);
+	double U1 = Pot->getEnergy();
+	double dV = atoms->getBox().getVolume() - box.getVolume();
+	double arg = -(U1 - U0 + P * dV) / T + (atoms->getNM() + 1) * dlnV;
+	volumeTried++;
+	bool accept = arg >= 0.0 || u[1] < exp(arg);
+	if (accept) {
+		volumeAccepted++;
+	} else {
+		atoms->setBox(box);
+		atoms->setPositions(saved);
+		Pot->rescale(1.0 / mu);
+	}
+	if (sweep < static_cast<uint64_t>(eqSweeps)) {
+		maxLogVolume *= accept ? 1.05 : 0.95;
+	}
+}
+
+// The molecules are picked at random, so every trial has its own counter
+void MonteCarlo::sweepSerial() {
+	int nm = atoms->getNM();
+	for (int t = 0; t < nm; t++) {
+		double u[4];
+		rng.uniform(t, 3 * sweep + 2, CounterRNG::MONTE_CARLO, u);
+		int m = min(nm - 1, static_cast<int>(u[0] * nm));
+		if (tryMove(m, t, false)) {
+			accepted++;
+		}
+	}
+	tried += nm;
+}
+
+// Every molecule gets one trial, with the counter of the molecule. The cells
+// of a colour are two cells apart, and a move out of its cell is rejected, so
+// the moves of a colour are independent. The reverse of an allowed move stays
+// in the cell too, so the restriction keeps detailed balance, and the random
+// origin of the grid lets the molecules cross the boundaries over the sweeps.
+void MonteCarlo::sweepCheckerboard() {
+	long long acc = 0;
+	int nCells = grid.getNumberOfCells();
+	for (int colour = 0; colour < 8; colour++) {
+		vector<int> active;
+		for (int c = 0; c < nCells; c++) {
+			if (grid.getColour(c) == colour) {
+				active.push_back(c);
+			}
+		}
+		int nActive = static_cast<int>(active.size());
+		#pragma omp parallel for schedule(dynamic) reduction(+:acc)
+		for (int i = 0; i < nActive; i++) {
+			for (int m : grid.getPoints(active[i])) {
+				if (tryMove(m, m, true)) {
+					acc++;
+				}
+			}
+		}
+	}
+	accepted += acc;
+	tried += atoms->getNM();
+}
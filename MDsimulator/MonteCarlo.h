@@ -0,0 +1,77 @@
+#ifndef _montecarlo_h
+#define _montecarlo_h
+
+#include "Ensemble.h"
+#include "CellList.h"
+#include "Random.h"
+#include "dataType.h"
+
+// Metropolis Monte Carlo in the NVT or the NPT ensemble, which works as an
+// Ensemble, so the simulation loop, the logging and the analysis are shared
+// with MD. Every update() is a sweep of one trial move per molecule. The
+// molecules move as rigid bodies (a translation, and a rotation about the
+// center, if they have more than one atom), so only their intermolecular
+// energy changes. The change is found over the molecules in the neighbouring
+// cells of a grid of the molecular centers, with the pair energies of the
+// Potential. Under pressure every sweep starts with a trial change of ln V,
+// which scales the molecular centers (Frenkel and Smit, ch. 5.4).
+//
+// The sweep is either serial over randomly chosen molecules, or parallel on a
+// checkerboard: the cells are coloured in 2 x 2 x 2 sublattices, and the
+// cells of one colour are swept at the same time, with the moves kept inside
+// their cells, so molecules moved at the same time never interact. The grid
+// is shifted by a random fraction of the box every sweep, so the molecules
+// can cross the cell boundaries of the sweeps before. The random numbers are
+// counter-based, so the result doesn't depend on the number of threads.
+class MonteCarlo :
+	public Ensemble
+{
+public:
+	// Constructor sets up the moves from the data
+	MonteCarlo(Atoms* atoms, dataT* data);
+
+	// Implementation of the abstract function update(), which does a sweep.
+	// There is no extended system, so it returns zero.
+	double update();
+
+	// Print the acceptance ratios and the final step sizes
+	void printAcceptance();
+
+private:
+	bool isobaric;				// Are there volume moves?
+	bool checkerboard;			// Parallel sweeps on a checkerboard?
+	double T;					// The reduced temperature
+	double P;					// The reduced pressure
+	double maxDisplacement;		// Largest displacement of a center (reduced)
+	double maxLogVolume;		// Largest change of ln V
+	int eqSweeps;				// The step sizes are adapted until here
+	uint64_t sweep = 0;			// The number of the current sweep
+	long long tried = 0, accepted = 0;	// Molecule moves
+	long long volumeTried = 0, volumeAccepted = 0;
+	CounterRNG rng;
+
+	double rMol = 0.0;			// Largest distance of an atom to its center
+	vector<double> r;			// Working copy of the positions
+	vector<double> centers;		// The geometric centers of the molecules
+	CellGrid grid;				// The centers in cells of r_c + 2 rMol
+
+	// Copy the positions, and bin the centers into the grid. The checkerboard
+	// needs an even number of cells along each axis, and a new random origin
+	// of the grid every sweep.
+	void buildGrid();
+	// Is the grid fine enough for the checkerboard?
+	bool hasCheckerboard();
+	// Get the intermolecular energy of molecule m with its atoms at p
+	double getEnergy(int m, const double* p);
+	// Attempt a move of molecule m with the random numbers of counter id.
+	// Returns whether it was accepted.
+	bool tryMove(int m, uint32_t id, bool stayInCell);
+	// Attempt a change of the volume
+	void tryVolume();
+	// Sweep over randomly chosen molecules
+	void sweepSerial();
+	// Sweep over the colours of the checkerboard
+	void sweepCheckerboard();
+};
+
+#endif // !_montecarlo_h
@@ -0,0 +1,219 @@
+#include "ObservableStore.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+	const char obsTag[8] = "MDOBS01";
+	const size_t headerAlignment = 64;
+
+	// Copy a value of type T from the mapping, which needn't be aligned
+	template <typename T>
+	T load(const char* p) {
+		T v;
+		memcpy(&v, p, sizeof(T));
+		return v;
+	}
+
+	template <typename T>
+	void store(ofstream& out, T v) {
+		out.write(reinterpret_cast<const char*>(&v), sizeof(T));
+	}
+}
+
+// The header is written with zero rows and no index, which are filled in
+// when the store is closed
+ObservableWriter::ObservableWriter(string filename, vector<string> columns,
+	int rowsPerChunk)
+	: out(filename, ios::binary | ios::trunc)
+{
+	if (!out.is_open()) {
+		cout << "Couldn't open the observable file '" << filename << "'"
+			<< endl;
+		exit(-1);
+	}
+	nColumns = static_cast<int>(columns.size());
+	chunkRows = max(1, rowsPerChunk);
+	chunk.resize((size_t)nColumns * chunkRows);
+
+	out.write(obsTag, sizeof(obsTag));
+	store<uint32_t>(out, nColumns);
+	store<uint32_t>(out, chunkRows);
+	store<uint64_t>(out, 0);
+	store<uint64_t>(out, 0);
+	for (const string& name : columns) {
+		store<uint32_t>(out, static_cast<uint32_t>(name.size()));
+		out.write(name.data(), name.size());
+	}
+	// The chunks start on a cache line, so the mapped columns are aligned
+	size_t header = static_cast<size_t>(out.tellp());
+	size_t padding = (headerAlignment - header % headerAlignment)
+		% headerAlignment;
+	out.write(string(padding, '\0').data(), padding);
+}
+
+ObservableWriter::~ObservableWriter() {
+	close();
+}
+
+void ObservableWriter::addRow(const vector<double>& values) {
+	for (int c = 0; c < nColumns; c++) {
+		chunk[(size_t)c * chunkRows + rows] = c < (int)values.size()
+			? values[c] : 0.0;
+	}
+	rows++;
+	if (rows == chunkRows) {
+		writeChunk();
+	}
+}
+
+void ObservableWriter::writeChunk() {
+	if (rows == 0) return;
+	obsChunkT entry;
+	entry.offset = static_cast<uint64_t>(out.tellp());
+	entry.rows = rows;
+	entry.tFirst = chunk[0];
+	entry.tLast = chunk[rows - 1];
+	index.push_back(entry);
+	// A short chunk only writes its rows of every column
+	for (int c = 0; c < nColumns; c++) {
+		out.write(reinterpret_cast<const char*>(&chunk[(size_t)c * chunkRows]),
+			sizeof(double) * rows);
+	}
+	totalRows += rows;
+	rows = 0;
+}
+
+void ObservableWriter::close() {
+	if (!out.is_open()) return;
+	writeChunk();
+	uint64_t indexOffset = static_cast<uint64_t>(out.tellp());
+	store<uint64_t>(out, index.size());
+	for (const obsChunkT& entry : index) {
+		store(out, entry);
+	}
+	out.seekp(sizeof(obsTag) + 2 * sizeof(uint32_t));
+	store<uint64_t>(out, totalRows);
+	store<uint64_t>(out, indexOffset);
+	out.close();
+}
+
+
+// The file is read in random places, so it isn't read ahead
+ObservableReader::ObservableReader(string filename)
+	: file(filename, false)
+{
+	const char* p = file.data;
+	size_t size = file.size;
+	if (size < 32 || memcmp(p, obsTag, sizeof(obsTag)) != 0) {
+		fail("'" + filename + "' is not an observable file");
+	}
+	int nColumns = load<uint32_t>(p + 8);
+	chunkRows = load<uint32_t>(p + 12);
+	totalRows = load<uint64_t>(p + 16);
+	uint64_t indexOffset = load<uint64_t>(p + 24);
+	size_t pos = 32;
+	for (int c = 0; c < nColumns; c++) {
+		if (pos + 4 > size) fail("The header of '" + filename + "' is cut off");
+		uint32_t length = load<uint32_t>(p + pos);
+		pos += 4;
+		if (pos + length > size) {
+			fail("The header of '" + filename + "' is cut off");
+		}
+		columns.push_back(string(p + pos, length));
+		pos += length;
+	}
+	size_t dataStart = (pos + headerAlignment - 1) / headerAlignment
+		* headerAlignment;
+	if (nColumns == 0 || chunkRows == 0) {
+		fail("'" + filename + "' has no columns");
+	}
+
+	if (indexOffset != 0 && indexOffset + 8 <= size) {
+		uint64_t nChunks = load<uint64_t>(p + indexOffset);
+		if (indexOffset + 8 + nChunks * sizeof(obsChunkT) > size) {
+			fail("The index of '" + filename + "' is cut off");
+		}
+		index.resize(nChunks);
+		memcpy(index.data(), p + indexOffset + 8, nChunks * sizeof(obsChunkT));
+		return;
+	}
+	// The run didn't close the store, so the complete chunks are indexed
+	size_t chunkBytes = sizeof(double) * nColumns * (size_t)chunkRows;
+	totalRows = 0;
+	for (size_t offset = dataStart; offset + chunkBytes <= size;
+		offset += chunkBytes) {
+		const char* t = p + offset;
+		obsChunkT entry;
+		entry.offset = offset;
+		entry.rows = chunkRows;
+		entry.tFirst = load<double>(t);
+		entry.tLast = load<double>(t + sizeof(double) * (chunkRows - 1));
+		index.push_back(entry);
+		totalRows += chunkRows;
+	}
+	cout << "'" << filename << "' wasn't closed, so only its "
+		<< index.size() << " complete chunks are read" << endl;
+}
+
+const vector<string>& ObservableReader::getColumns() {
+	return columns;
+}
+
+int ObservableReader::findColumn(string name) {
+	for (size_t c = 0; c < columns.size(); c++) {
+		if (columns[c] == name) return static_cast<int>(c);
+	}
+	return -1;
+}
+
+uint64_t ObservableReader::getRows() {
+	return totalRows;
+}
+
+int ObservableReader::getChunks() {
+	return static_cast<int>(index.size());
+}
+
+const double* ObservableReader::getChunk(int k, int c, int* n) {
+	const obsChunkT& entry = index[k];
+	*n = static_cast<int>(entry.rows);
+	return reinterpret_cast<const double*>(file.data + entry.offset
+		+ sizeof(double) * entry.rows * c);
+}
+
+// The chunks are in time order, so the first one, which ends at or after t,
+// is found by bisection
+int ObservableReader::findChunk(double t) {
+	auto it = lower_bound(index.begin(), index.end(), t,
+		[](const obsChunkT& entry, double time) {
+			return entry.tLast < time;
+		});
+	return static_cast<int>(it - index.begin());
+}
+
+bool ObservableReader::getWindow(int k, double tFrom, double tTo, int* begin,
+	int* end) {
+	int n;
+	const double* t = getChunk(k, 0, &n);
+	*begin = static_cast<int>(lower_bound(t, t + n, tFrom) - t);
+	*end = static_cast<int>(upper_bound(t, t + n, tTo) - t);
+	return *begin < *end;
+}
+
+vector<double> ObservableReader::getColumn(int c, double tFrom, double tTo) {
+	vector<double> values;
+	for (int k = findChunk(tFrom); k < getChunks()
+		&& index[k].tFirst <= tTo; k++) {
+		int begin, end, n;
+		if (!getWindow(k, tFrom, tTo, &begin, &end)) continue;
+		const double* v = getChunk(k, c, &n);
+		values.insert(values.end(), v + begin, v + end);
+	}
+	return values;
+}
+
+void ObservableReader::fail(string message) {
+	cout << message << endl;
+	exit(-1);
+}
@@ -0,0 +1,107 @@
+#ifndef _observablestore_h
+#define _observablestore_h
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdint>
+#include "MappedFile.h"
+
+using namespace std;
+
+// A binary store of the observables of a run, which is written in chunks of
+// a fixed number of rows. Inside a chunk the values of every column follow
+// each other, so a column is read without touching the others, and a time
+// window is found from a sparse index with the first and the last time of
+// every chunk. The first column is the time, which must not decrease.
+//
+// The layout (native byte order, which is little-endian on all the supported
+// systems) is:
+//	header	an 8 byte "MDOBS01" tag, the number of columns and the rows per
+//			chunk (32 bit integers), the number of rows and the offset of the
+//			index (64 bit integers), and the name of every column as a 32 bit
+//			length and the characters. It is padded to 64 bytes.
+//	chunks	the rows of every column as doubles, column after column. Only
+//			the last chunk may have fewer rows.
+//	index	the number of chunks (64 bit integer), and the offset, the number
+//			of rows, and the first and last time of every chunk.
+// The number of rows and the index are written when the store is closed. If
+// a run stops before, the reader finds the complete chunks from the size.
+
+// The index entry of a chunk
+struct obsChunkT {
+	uint64_t offset;	// Position of the chunk in the file
+	uint64_t rows;		// The number of rows in the chunk
+	double tFirst;		// The time of the first row
+	double tLast;		// The time of the last row
+};
+
+// Writer of the store. The columns are registered, when it is created.
+class ObservableWriter
+{
+public:
+	// Create the file with the given columns, of which the first is the time
+	ObservableWriter(string filename, vector<string> columns,
+		int chunkRows = defaultChunkRows);
+	// Destructor closes the store
+	virtual ~ObservableWriter();
+
+	// Add a row with a value for every column
+	void addRow(const vector<double>& values);
+	// Write the last chunk, the index and the number of rows
+	void close();
+
+	static constexpr int defaultChunkRows = 4096;	// 32 kB per column
+
+private:
+	ofstream out;
+	int nColumns;
+	int chunkRows;
+	vector<double> chunk;		// The current chunk, column after column
+	int rows = 0;				// The rows of the current chunk
+	uint64_t totalRows = 0;
+	vector<obsChunkT> index;
+
+	// Write the current chunk, and add it to the index
+	void writeChunk();
+};
+
+// Reader of the store, which maps the file, so a column or a time window is
+// read without parsing the rest
+class ObservableReader
+{
+public:
+	// Map the file, and read the header and the index
+	ObservableReader(string filename);
+
+	// Get the names of the columns
+	const vector<string>& getColumns();
+	// Get the index of a column by its name (-1 if there is none)
+	int findColumn(string name);
+	// Get the number of rows
+	uint64_t getRows();
+	// Get the number of chunks
+	int getChunks();
+	// Get the values of column c in chunk k, which are in the mapping, and
+	// the number of them
+	const double* getChunk(int k, int c, int* n);
+	// Get the rows of chunk k, which are in the time window [tFrom, tTo], as
+	// begin and end. Returns false, if there are none.
+	bool getWindow(int k, double tFrom, double tTo, int* begin, int* end);
+	// Get the values of column c in the time window [tFrom, tTo]
+	vector<double> getColumn(int c, double tFrom, double tTo);
+	// Get the first chunk, which can have rows at or after t
+	int findChunk(double t);
+
+private:
+	MappedFile file;
+	vector<string> columns;
+	int chunkRows = 0;
+	uint64_t totalRows = 0;
+	vector<obsChunkT> index;
+
+	// Exit with a message about the file
+	void fail(string message);
+};
+
+#endif // !_observablestore_h
@@ -0,0 +1,369 @@
+#define _USE_MATH_DEFINES
+#include "PME.h"
+#include <iostream>
+#include <cmath>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// The constructor picks the splitting parameter alpha, so the real-space
+// interaction at the cut-off is erfc(alpha * r_c) = tolerance. If no grid size
+// is given, it is chosen to keep alpha * h ~ 0.375 for the grid spacing h,
+// which gives a reciprocal error comparable to the real-space one.
+PME::PME(Atoms* a, dataT* d)
+	: bsplineModuli(3)
+{
+	atoms = a;
+	order = d->pmeOrder;
+	box = a->getBox();
+	// Without a cut-off the real-space sum uses the minimum image convention
+	double halfWidth = 0.5 * box.getMinimumWidth();
+	r_c = d->r_co != 0.0 ? d->r_co : halfWidth;
+	if (r_c > halfWidth) {
+		cout << "The real-space Ewald cut-off is larger than half the cell!"
+			<< endl;
+	}
+
+	// Find alpha with bisection, since erfc is monotonically decreasing
+	double lo = 0.0, hi = 10.0 / r_c;
+	for (int it = 0; it < 100; it++) {
+		alpha = 0.5 * (lo + hi);
+		if (erfc(alpha * r_c) > d->ewaldTol) {
+			lo = alpha;
+		} else {
+			hi = alpha;
+		}
+	}
+
+	// Set up the grid with the spacing along each cell vector
+	for (int k = 0; k < 3; k++) {
+		K[k] = d->pmeGrid;
+		if (K[k] <= 0) {
+			K[k] = static_cast<int>(ceil(alpha * box.getLength(k) / 0.375));
+		}
+		K[k] = FFT3D::nextPowerOfTwo(max(K[k], 2 * order));
+	}
+	fft = new FFT3D(K[0], K[1], K[2]);
+	grid.resize(static_cast<size_t>(K[0]) * K[1] * K[2]);
+
+	calculateModuli();
+	calculateInfluence();
+	cout << "PME: alpha = " << alpha << ", grid = " << K[0] << "x" << K[1]
+		<< "x" << K[2] << ", order = " << order << endl;
+}
+
+// The destructor deletes the FFT engine and releases the grids
+PME::~PME() {
+	delete fft;
+	vector<complex<double>>().swap(grid);
+	vector<vector<double>>().swap(threadGrids);
+}
+
+// erfc(alpha r) / r is the screened Coulomb interaction
+double PME::realEnergy(double qq, double r) {
+	if (r > r_c) return 0.0;
+	return qq * erfc(alpha * r) / r;
+}
+
+// -dU/dr / r for the screened Coulomb interaction
+double PME::realForce(double qq, double r) {
+	if (r > r_c) return 0.0;
+	return qq * (erfc(alpha * r) + 2.0 * alpha / sqrt(M_PI) * r
+		* exp(-alpha * alpha * r * r)) / (r * r * r);
+}
+
+// The excluded pairs have the full interaction subtracted, which leaves
+// -erf(alpha r) / r, since the real-space part is not added for them
+double PME::exclusionEnergy(double qq, double r) {
+	return -qq * erf(alpha * r) / r;
+}
+
+double PME::exclusionForce(double qq, double r) {
+	return qq * (2.0 * alpha / sqrt(M_PI) * r * exp(-alpha * alpha * r * r)
+		- erf(alpha * r)) / (r * r * r);
+}
+
+// The reciprocal part works in four stages:
+// 1) Spread the charges on the grid with B-splines (thread-local grids)
+// 2) Forward FFT, multiply by the influence function, sum the energy
+// 3) Backward FFT, which gives the convolution dE/dQ on the grid
+// 4) Gather the forces as the gradient of the spline weights
+void PME::addReciprocalForces(double* F) {
+	// The influence function depends on the box
+	if (!(atoms->getBox() == box)) {
+		box = atoms->getBox();
+		calculateInfluence();
+	}
+	int N = atoms->getSize();
+	int gridSize = static_cast<int>(grid.size());
+	// The thread count may have changed since the last call, so there is a
+	// grid for every thread the team can have
+	int maxThreads = 1;
+#ifdef _OPENMP
+	maxThreads = omp_get_max_threads();
+#endif
+	if (static_cast<int>(threadGrids.size()) < maxThreads) {
+		threadGrids.resize(maxThreads, vector<double>(grid.size(), 0));
+	}
+
+	// 1) Spread the charges
+	int nThreads = 1;
+	#pragma omp parallel
+	{
+		int t = 0;
+#ifdef _OPENMP
+		t = omp_get_thread_num();
+		#pragma omp master
+		nThreads = omp_get_num_threads();
+#endif
+		vector<double>& Q = threadGrids[t];
+		fill(Q.begin(), Q.end(), 0.0);
+		vector<double> theta(3 * order), dtheta(3 * order);
+		int k0[3];
+		#pragma omp for schedule(static)
+		for (int i = 0; i < N; i++) {
+			double q = atoms->getCharge(i);
+			if (q == 0.0) continue;
+			getSplines(i, k0, &theta[0], &dtheta[0]);
+			for (int j1 = 0; j1 < order; j1++) {
+				int i1 = (k0[0] + j1 + K[0]) % K[0];
+				for (int j2 = 0; j2 < order; j2++) {
+					int i2 = (k0[1] + j2 + K[1]) % K[1];
+					double w12 = q * theta[j1] * theta[order + j2];
+					for (int j3 = 0; j3 < order; j3++) {
+						int i3 = (k0[2] + j3 + K[2]) % K[2];
+						Q[(i1 * K[1] + i2) * K[2] + i3]
+							+= w12 * theta[2 * order + j3];
+					}
+				}
+			}
+		}
+	}
+	// Sum the thread-local grids of the team
+	#pragma omp parallel for schedule(static)
+	for (int idx = 0; idx < gridSize; idx++) {
+		double sum = 0.0;
+		for (int t = 0; t < nThreads; t++) {
+			sum += threadGrids[t][idx];
+		}
+		grid[idx] = complex<double>(sum, 0.0);
+	}
+
+	// 2) Transform and convolve with the influence function
+	fft->forward(grid);
+	// Each reciprocal vector adds e(m) [delta_ab - 2 (1 + pi^2 m^2 / alpha^2)
+	// m_a m_b / m^2] to the virial tensor
+	double E = 0.0, Wxx = 0.0, Wyy = 0.0, Wzz = 0.0;
+	double Wxy = 0.0, Wxz = 0.0, Wyz = 0.0;
+	#pragma omp parallel for reduction(+:E, Wxx, Wyy, Wzz, Wxy, Wxz, Wyz) \
+		schedule(static)
+	for (int idx = 0; idx < gridSize; idx++) {
+		double e = 0.5 * influence[idx] * norm(grid[idx]);
+		double m[3];
+		getReciprocalVector(idx, m);
+		double f = e * virialFactor[idx];
+		E += e;
+		Wxx += e - f * m[0] * m[0];
+		Wyy += e - f * m[1] * m[1];
+		Wzz += e - f * m[2] * m[2];
+		Wxy -= f * m[0] * m[1];
+		Wxz -= f * m[0] * m[2];
+		Wyz -= f * m[1] * m[2];
+		grid[idx] *= influence[idx];
+	}
+	double W = Wxx + Wyy + Wzz;
+	virialTensor[0] = Wxx;
+	virialTensor[1] = Wyy;
+	virialTensor[2] = Wzz;
+	virialTensor[3] = Wxy;
+	virialTensor[4] = Wxz;
+	virialTensor[5] = Wyz;
+
+	// 3) Transform back to get the convolution
+	fft->backward(grid);
+
+	// 4) Gather the forces on the charges. The derivative of the scaled
+	// coordinate u_a = K_a s_a with respect to r_b is K_a hInv_ab.
+	double scale[3][3];
+	for (int a = 0; a < 3; a++) {
+		for (int b = 0; b < 3; b++) {
+			scale[a][b] = K[a] * box.hInv[a][b];
+		}
+	}
+	#pragma omp parallel
+	{
+		vector<double> theta(3 * order), dtheta(3 * order);
+		int k0[3];
+		#pragma omp for schedule(static)
+		for (int i = 0; i < N; i++) {
+			double q = atoms->getCharge(i);
+			if (q == 0.0) continue;
+			getSplines(i, k0, &theta[0], &dtheta[0]);
+			double f[3] = { 0.0, 0.0, 0.0 };
+			for (int j1 = 0; j1 < order; j1++) {
+				int i1 = (k0[0] + j1 + K[0]) % K[0];
+				for (int j2 = 0; j2 < order; j2++) {
+					int i2 = (k0[1] + j2 + K[1]) % K[1];
+					for (int j3 = 0; j3 < order; j3++) {
+						int i3 = (k0[2] + j3 + K[2]) % K[2];
+						double c = grid[(i1 * K[1] + i2) * K[2] + i3].real();
+						f[0] += dtheta[j1] * theta[order + j2]
+							* theta[2 * order + j3] * c;
+						f[1] += theta[j1] * dtheta[order + j2]
+							* theta[2 * order + j3] * c;
+						f[2] += theta[j1] * theta[order + j2]
+							* dtheta[2 * order + j3] * c;
+					}
+				}
+			}
+			for (int k = 0; k < 3; k++) {
+				F[3 * (size_t)i + k] -= q * (scale[0][k] * f[0] + scale[1][k] * f[1]
+					+ scale[2][k] * f[2]);
+			}
+		}
+	}
+
+	// The self energy of the Gaussian charge clouds and the energy of the
+	// neutralizing background for a charged cell
+	double sumQ = 0.0, sumQQ = 0.0;
+	for (int i = 0; i < N; i++) {
+		double q = atoms->getCharge(i);
+		sumQ += q;
+		sumQQ += q * q;
+	}
+	double V = box.getVolume();
+	energy = E - alpha / sqrt(M_PI) * sumQQ
+		- M_PI * sumQ * sumQ / (2.0 * V * alpha * alpha);
+	virial = W;
+}
+
+double PME::getEnergy() {
+	return energy;
+}
+
+double PME::getVirial() {
+	return virial;
+}
+
+// The tensor is symmetric, so only six components are stored
+vector<vector<double>> PME::getVirialTensor() {
+	return {
+		{ virialTensor[0], virialTensor[3], virialTensor[4] },
+		{ virialTensor[3], virialTensor[1], virialTensor[5] },
+		{ virialTensor[4], virialTensor[5], virialTensor[2] }
+	};
+}
+
+double PME::getAlpha() {
+	return alpha;
+}
+
+int PME::getGridSize(int axis) {
+	return K[axis];
+}
+
+// The influence function B(m) exp(-pi^2 m^2 / alpha^2) / (pi V m^2) of the
+// reciprocal vectors m of the box. The m = 0 term is left out.
+void PME::calculateInfluence() {
+	influence.assign(grid.size(), 0.0);
+	virialFactor.assign(grid.size(), 0.0);
+	double V = box.getVolume();
+	int gridSize = static_cast<int>(grid.size());
+	for (int idx = 0; idx < gridSize; idx++) {
+		double m[3];
+		getReciprocalVector(idx, m);
+		double mm = m[0] * m[0] + m[1] * m[1] + m[2] * m[2];
+		if (mm == 0.0) continue;
+		int m1 = idx / (K[1] * K[2]), m2 = (idx / K[2]) % K[1];
+		int m3 = idx % K[2];
+		double B = 1.0 / (bsplineModuli[0][m1] * bsplineModuli[1][m2]
+			* bsplineModuli[2][m3]);
+		influence[idx] = B * exp(-M_PI * M_PI * mm / (alpha * alpha))
+			/ (M_PI * V * mm);
+		virialFactor[idx] = 2.0 * (1.0 + M_PI * M_PI * mm
+			/ (alpha * alpha)) / mm;
+	}
+}
+
+// The reciprocal cell vectors are the rows of h^-1, and the grid indices
+// above K / 2 are the negative frequencies
+void PME::getReciprocalVector(int idx, double* m) {
+	int n[3] = { idx / (K[1] * K[2]), (idx / K[2]) % K[1], idx % K[2] };
+	for (int a = 0; a < 3; a++) {
+		if (n[a] > K[a] / 2) n[a] -= K[a];
+	}
+	for (int b = 0; b < 3; b++) {
+		m[b] = n[0] * box.hInv[0][b] + n[1] * box.hInv[1][b]
+			+ n[2] * box.hInv[2][b];
+	}
+}
+
+// The squared modulus of the discrete Fourier transform of the B-spline
+// values at the integers. Zeros (only for odd orders) are interpolated.
+void PME::calculateModuli() {
+	vector<double> M(order), dM(order);
+	fillSplines(0.0, &M[0], &dM[0]);
+	for (int a = 0; a < 3; a++) {
+		vector<double>& b = bsplineModuli[a];
+		b.assign(K[a], 0.0);
+		for (int m = 0; m < K[a]; m++) {
+			double re = 0.0, im = 0.0;
+			for (int j = 0; j < order; j++) {
+				double phi = 2.0 * M_PI * m * j / K[a];
+				re += M[j] * cos(phi);
+				im += M[j] * sin(phi);
+			}
+			b[m] = re * re + im * im;
+		}
+		for (int m = 0; m < K[a]; m++) {
+			if (b[m] < 1e-7) {
+				b[m] = 0.5 * (b[(m - 1 + K[a]) % K[a]] + b[(m + 1) % K[a]]);
+			}
+		}
+	}
+}
+
+// The recursion for the cardinal B-splines M_n(w + j) and their derivatives
+// for j = 0, ..., order - 1, as given in the appendix of Essmann et al.
+void PME::fillSplines(double w, double* theta, double* dtheta) {
+	theta[order - 1] = 0.0;
+	theta[1] = w;
+	theta[0] = 1.0 - w;
+	for (int k = 3; k < order; k++) {
+		double div = 1.0 / (k - 1.0);
+		theta[k - 1] = div * w * theta[k - 2];
+		for (int j = 1; j < k - 1; j++) {
+			theta[k - j - 1] = div * ((w + j) * theta[k - j - 2]
+				+ (k - j - w) * theta[k - j - 1]);
+		}
+		theta[0] = div * (1.0 - w) * theta[0];
+	}
+	// The derivatives follow from the splines of one order lower
+	dtheta[0] = -theta[0];
+	for (int j = 1; j < order; j++) {
+		dtheta[j] = theta[j - 1] - theta[j];
+	}
+	// Do the final recursion to get the requested order
+	double div = 1.0 / (order - 1.0);
+	theta[order - 1] = div * w * theta[order - 2];
+	for (int j = 1; j < order - 1; j++) {
+		theta[order - j - 1] = div * ((w + j) * theta[order - j - 2]
+			+ (order - j - w) * theta[order - j - 1]);
+	}
+	theta[0] = div * (1.0 - w) * theta[0];
+}
+
+// The scaled fractional coordinate u = K * s of an atom is split in the
+// integer grid point and the fractional part, which determines the weights
+void PME::getSplines(int i, int* k0, double* theta, double* dtheta) {
+	vector<double> p = atoms->getPos(i);
+	double s[3];
+	box.toFractional(&p[0], s);
+	for (int a = 0; a < 3; a++) {
+		s[a] -= floor(s[a]);  // wrap into the cell
+		double u = s[a] * K[a];
+		int k = static_cast<int>(u);
+		fillSplines(u - k, theta + a * order, dtheta + a * order);
+		k0[a] = k - order + 1;
+	}
+}
@@ -0,0 +1,80 @@
+#ifndef _pme_h
+#define _pme_h
+
+#include "Atoms.h"
+#include "FFT.h"
+#include "dataType.h"
+
+// Smooth particle-mesh Ewald (Essmann et al., J. Chem. Phys. 103, 8577) for
+// the Coulomb interaction between the partial charges of the atoms. The
+// real-space part is a short-ranged erfc pair term, which is evaluated by the
+// pair loop of the Potential through realForce() and realEnergy(). The
+// reciprocal part spreads the charges onto a grid with cardinal B-splines and
+// solves Poisson's equation with 3D FFTs, which scales as O(N log N). The grid
+// follows the cell vectors, so any triclinic box is supported.
+// All quantities are in reduced units, so the charges are q / sqrt(4 pi eps_0
+// sigma eps) and the pair energy is q_i q_j / r.
+class PME
+{
+public:
+	// Constructor determines the splitting parameter from the tolerance and
+	// the real-space cut-off, and sets up the charge grid
+	PME(Atoms* atoms, dataT* data);
+	~PME();
+
+	// Real-space energy and force prefactor of a pair of charges (product qq)
+	// at the distance r. The force on atom i is realForce() * (r_i - r_j).
+	double realEnergy(double qq, double r);
+	double realForce(double qq, double r);
+	// Correction for excluded (bonded) pairs, which removes the interaction
+	// that the reciprocal sum includes for every pair
+	double exclusionEnergy(double qq, double r);
+	double exclusionForce(double qq, double r);
+
+	// Calculate the reciprocal-space energy and virial, and add the
+	// reciprocal forces to F (x, y, z of the atoms after each other)
+	void addReciprocalForces(double* F);
+	// Get the reciprocal and self energy from the last force calculation
+	double getEnergy();
+	// Get the reciprocal virial from the last force calculation
+	double getVirial();
+	// Get the reciprocal virial tensor from the last force calculation
+	vector<vector<double>> getVirialTensor();
+
+	// Getters for the chosen parameters
+	double getAlpha();
+	int getGridSize(int axis);
+
+private:
+	Atoms* atoms;
+	double alpha;		// Ewald splitting parameter (reduced)
+	double r_c;			// Real-space cut-off (reduced)
+	int order;			// B-spline interpolation order
+	int K[3];			// Number of grid points along each cell vector
+	boxT box;			// The box the influence function is made for
+	double energy = 0;	// Reciprocal + self energy of the last calculation
+	double virial = 0;	// Reciprocal virial of the last calculation
+	double virialTensor[6] = {};	// xx, yy, zz, xy, xz, yz of the same
+
+	FFT3D* fft;
+	vector<complex<double>> grid;		// The charge grid and its transform
+	vector<vector<double>> threadGrids;	// Thread-local charge spreading
+	vector<vector<double>> bsplineModuli;	// |b(m)|^2 along each axis
+	vector<double> influence;			// B(m) C(m) on the reciprocal grid
+	vector<double> virialFactor;		// 2 (1 + pi^2 m^2 / alpha^2) / m^2
+
+	// Precalculate the influence function for the current box
+	void calculateInfluence();
+	// Calculate the B-spline moduli along the axes
+	void calculateModuli();
+	// Get the reciprocal vector m = h^-T (m1, m2, m3) of grid index idx
+	void getReciprocalVector(int idx, double* m);
+	// Calculate the B-spline weights and their derivatives for the
+	// fractional part w of a scaled coordinate
+	void fillSplines(double w, double* theta, double* dtheta);
+	// Get the grid index of the first grid point and the spline weights of
+	// atom i along all three axes
+	void getSplines(int i, int* k0, double* theta, double* dtheta);
+};
+
+#endif // !_pme_h
@@ -2,11 +2,13 @@
 #include "Ensemble.h"
 #include "Potential.h"
 #include "Integrator.h"
+#include "Minimizer.h"
+#include "CellBuilder.h"
 
 // Creates the InputParser with the alias matrix, and parses the input file.
 // Then parses the values into the dataT object.
 Parser::Parser(std::string f, dataT* d)
-	: ip(aliasMatrix)
+	: ip(aliasMatrix, pathKeys)
 {
 	ip.parseFile(f);
 	parseData(d);
@@ -26,6 +28,31 @@ void Parser::parseData(dataT* d) {
 	parseValue(&(d->nMolecules), "N");
 	parseValue(&(d->apm), "apm");
 	parseValue(&(d->simSteps), "steps");
+	parseValue(&(d->eqSteps), "eq_steps");
+	parseValue(&(d->eqAuto), "eq_auto");
+	parseValue(&(d->targetError), "target_error");
+	parseValue(&(d->targetErrorZ), "target_error_Z");
+	parseValue(&(d->logPressure), "log_pressure");
+	parseValue(&(d->reorderInterval), "reorder");
+	parseValue(&(d->seed), "seed");
+	parseValue(&(d->analysisThreads), "analysis_threads");
+	parseValue(&(d->hugePages), "huge_pages");
+	parseValue(&(d->sqStride), "sq_stride");
+	parseValue(&(d->sqKMax), "sq_kmax");
+	parseValue(&(d->nReplicas), "replicas");
+	parseValue(&(d->T_max), "T_max");
+	parseValue(&(d->exchangeInterval), "exchange_interval");
+	parseValue(&(d->monteCarlo), "mc");
+	parseValue(&(d->mcDisplacement), "mc_dr");
+	parseValue(&(d->mcVolume), "mc_dlnV");
+	parseValue(&(d->mcCheckerboard), "mc_checkerboard");
+	parseValue(&(d->widomStride), "widom_stride");
+	parseValue(&(d->widomInsertions), "widom_insertions");
+	parseValue(&(d->perfCounters), "perf_counters");
+	parseValue(&(d->obsFile), "obs_file");
+	parseValue(&(d->textLog), "text_log");
+	parseValue(&(d->trajStride), "traj_stride");
+	parseValue(&(d->trajFile), "traj_file");
 	parseValue(&(d->mass), "mass");
 	parseValue(&(d->T), "T");
 	parseValue(&(d->rho), "rho");
@@ -35,13 +62,31 @@ void Parser::parseData(dataT* d) {
 	parseValue(&(d->sigma), "sigma");
 	parseValue(&(d->r_co), "r_c");
 	parseValue(&(d->tau_s), "tau_s");
+	parseValue(&(d->tau_p), "tau_p");
+	parseValue(&(d->kappa), "kappa");
 	parseValue(&(d->pos), "pos");
+	parseValue(&(d->config), "config");
+	parseValue(&(d->box), "box");
 	parseValue(&(d->bonds), "bonds");
 	parseValue(&(d->ks), "bks");
 	parseValue(&(d->r_eqs), "r_eqs");
+	parseValue(&(d->charges), "charges");
+	parseValue(&(d->types), "types");
+	parseValue(&(d->typeNames), "type_names");
+	parseValue(&(d->masses), "masses");
+	parseValue(&(d->epsKs), "epsKs");
+	parseValue(&(d->sigmas), "sigmas");
+	parseValue(&(d->ljPairs), "lj_pairs");
+	parseValue(&(d->ewaldTol), "ewald_tol");
+	parseValue(&(d->pmeGrid), "pme_grid");
+	parseValue(&(d->pmeOrder), "pme_order");
 	parseValue(&(d->ET), "ens");
 	parseValue(&(d->PT), "pot");
 	parseValue(&(d->IT), "int");
+	parseValue(&(d->MT), "min");
+	parseValue(&(d->LT), "lattice");
+	parseValue(&(d->minSteps), "min_steps");
+	parseValue(&(d->minForce), "min_ftol");
 }
 
 // Following are all the functions for securely parsing a value into
@@ -77,10 +122,16 @@ void Parser::parseValue(std::vector<int>* vp, std::string key) {
 	*vp = ip.getVectorI(key);
 }
 
+void Parser::parseValue(std::vector<std::string>* vp, std::string key) {
+	*vp = ip.getVectorS(key);
+}
+
 void Parser::parseValue(EnsType* vp, std::string key) {
 	std::string val = ip.getString(key);
 	if (val.compare("NVT") == 0 || val.compare("nvt") == 0) {
 		*vp = EnsType::NVT;
+	} else if (val.compare("NPT") == 0 || val.compare("npt") == 0) {
+		*vp = EnsType::NPT;
 	} else {
 		*vp = EnsType::NVE;
 	}
@@ -99,7 +150,36 @@ void Parser::parseValue(InteType* vp, std::string key) {
 	if (val.compare("VELVERLET") == 0 || val.compare("velverlet") == 0
 		|| val.compare("VelVerlet") == 0) {
 		*vp = InteType::VELVERLET;
+	} else if (val.compare("LANGEVIN") == 0 || val.compare("langevin") == 0
+		|| val.compare("Langevin") == 0 || val.compare("BAOAB") == 0) {
+		*vp = InteType::LANGEVIN;
 	} else {
 		*vp = InteType::VERLET;
 	}
-}
\ No newline at end of file
+}
+
+void Parser::parseValue(LatticeType* vp, std::string key) {
+	std::string val = ip.getString(key);
+	if (val.compare("SC") == 0 || val.compare("sc") == 0) {
+		*vp = LatticeType::SC;
+	} else if (val.compare("BCC") == 0 || val.compare("bcc") == 0) {
+		*vp = LatticeType::BCC;
+	} else if (val.compare("FCC") == 0 || val.compare("fcc") == 0) {
+		*vp = LatticeType::FCC;
+	} else if (val.compare("RANDOM") == 0 || val.compare("random") == 0) {
+		*vp = LatticeType::RANDOM;
+	} else {
+		*vp = LatticeType::AUTO;
+	}
+}
+
+void Parser::parseValue(MinType* vp, std::string key) {
+	std::string val = ip.getString(key);
+	if (val.compare("FIRE") == 0 || val.compare("fire") == 0) {
+		*vp = MinType::FIRE;
+	} else if (val.compare("CG") == 0 || val.compare("cg") == 0) {
+		*vp = MinType::CG;
+	} else {
+		*vp = MinType::NONE;
+	}
+}
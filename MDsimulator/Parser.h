@@ -9,6 +9,7 @@
 enum class EnsType;
 enum class PotType;
 enum class InteType;
+enum class MinType;
 
 class Parser
 {
@@ -27,15 +28,43 @@ private:
 	void parseValue(std::string* valptr, std::string key);
 	void parseValue(std::vector<double>* valptr, std::string key);
 	void parseValue(std::vector<int>* valptr, std::string key);
+	void parseValue(std::vector<std::string>* valptr, std::string key);
 	void parseValue(EnsType* valptr, std::string key);
 	void parseValue(PotType* valptr, std::string key);
 	void parseValue(InteType* valptr, std::string key);
+	void parseValue(MinType* valptr, std::string key);
+	void parseValue(LatticeType* valptr, std::string key);
 
 	// All the keywords with their associated aliases
 	std::vector<std::vector<std::string>> aliasMatrix{
 		{"N", "nmols"},
 		{"apm", "atoms_per_mol"},
 		{"steps", "simSteps"},
+		{"eq_steps", "equilibration_steps"},
+		{"eq_auto", "detect_equilibration"},
+		{"target_error", "target_relative_error"},
+		{"target_error_Z", "target_compressibility_error"},
+		{"log_pressure"},
+		{"reorder", "reorder_interval"},
+		{"seed", "random_seed"},
+		{"analysis_threads", "task_workers"},
+		{"huge_pages", "transparent_huge_pages"},
+		{"sq_stride", "structure_factor_stride"},
+		{"sq_kmax", "structure_factor_kmax"},
+		{"replicas", "parallel_tempering"},
+		{"T_max", "max_temperature"},
+		{"exchange_interval", "swap_interval"},
+		{"mc", "monte_carlo"},
+		{"mc_dr", "mc_max_displacement"},
+		{"mc_dlnV", "mc_max_volume_change"},
+		{"mc_checkerboard", "checkerboard_sweeps"},
+		{"widom_stride", "widom_interval"},
+		{"widom_insertions", "insertions_per_frame"},
+		{"perf_counters", "hardware_counters"},
+		{"obs_file", "observable_file"},
+		{"text_log", "log_text"},
+		{"traj_stride", "trajectory_interval"},
+		{"traj_file", "trajectory_file"},
 		{"mass"},
 		{"dt", "timestep"},
 		{"T", "temperature"},
@@ -45,15 +74,36 @@ private:
 		{"sigma"},
 		{"r_c", "cutoff"},
 		{"tau_s", "relaxation_time"},
+		{"tau_p", "barostat_time"},
+		{"kappa", "compressibility"},
 		{"ens", "Ensemble"},
 		{"pot", "Potential"},
 		{"int", "Integrator"},
 		{"pos", "positions"},
+		{"config", "configuration_file"},
+		{"box", "cell"},
 		{"bonds", "bond_pairs"},
 		{"bks", "bond_constants"},
-		{"r_eqs", "bond_eq_distances"}
+		{"r_eqs", "bond_eq_distances"},
+		{"charges", "partial_charges"},
+		{"types", "atom_types"},
+		{"type_names", "elements"},
+		{"masses", "type_masses"},
+		{"epsKs", "type_epsilons_in_K"},
+		{"sigmas", "type_sigmas"},
+		{"lj_pairs", "explicit_mixing"},
+		{"ewald_tol", "ewald_rtol"},
+		{"pme_grid", "fourier_grid"},
+		{"pme_order"},
+		{"min", "minimizer"},
+		{"lattice", "lattice_type"},
+		{"min_steps", "minimization_steps"},
+		{"min_ftol", "minimization_force_tolerance"}
 	};
 
+	// The keywords of file names, which are read as the rest of their line
+	std::vector<std::string> pathKeys{ "config", "obs_file", "traj_file" };
+
 	// An Input Parser to parse the input through
 	InputParser ip; // has to be at the bottom.
 };
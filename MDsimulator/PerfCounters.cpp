@@ -0,0 +1,165 @@
+#include "PerfCounters.h"
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+bool PerfCounters::enabled = false;
+mutex PerfCounters::lock;
+long long PerfCounters::totals[PHASES][nEvents] = {};
+
+namespace {
+	// The counters of a thread, and their values at the last read
+	struct threadCountersT {
+		int fd[4] = { -1, -1, -1, -1 };
+		long long last[4] = {};
+		bool opened = false;		// Has the thread tried to open them?
+		PerfCounters::Phase phase = PerfCounters::OTHER;	// The current phase
+
+		~threadCountersT() {
+#ifdef __linux__
+			for (int e = 0; e < 4; e++) {
+				if (fd[e] >= 0) close(fd[e]);
+			}
+#endif
+		}
+	};
+	thread_local threadCountersT counters;
+
+#ifdef __linux__
+	const unsigned long long events[4] = {
+		PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+	};
+
+	// Get the count of a counter, scaled up for the time it wasn't running,
+	// when the kernel multiplexes more events than the hardware has counters
+	long long readCounter(int fd) {
+		unsigned long long v[3] = {};
+		if (::read(fd, v, sizeof(v)) != sizeof(v) || v[2] == 0) {
+			return 0;
+		}
+		return static_cast<long long>(
+			static_cast<double>(v[0]) * v[1] / v[2]);
+	}
+#endif
+
+	// Open the counters of the calling thread, which are inherited by the
+	// threads it creates (its OpenMP team). Only user space is counted, which
+	// the default perf_event_paranoid setting allows.
+	bool openCounters(bool report) {
+		counters.opened = true;
+#ifdef __linux__
+		for (int e = 0; e < 4; e++) {
+			perf_event_attr attr;
+			memset(&attr, 0, sizeof(attr));
+			attr.size = sizeof(attr);
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.config = events[e];
+			attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED
+				| PERF_FORMAT_TOTAL_TIME_RUNNING;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			attr.inherit = 1;
+			counters.fd[e] = static_cast<int>(
+				syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+			if (counters.fd[e] < 0) {
+				if (report) {
+					cout << "Couldn't open the hardware counters ("
+						<< strerror(errno) << "), so they are off" << endl;
+				}
+				for (int k = 0; k <= e; k++) {
+					if (counters.fd[k] >= 0) close(counters.fd[k]);
+					counters.fd[k] = -1;
+				}
+				return false;
+			}
+		}
+		for (int e = 0; e < 4; e++) {
+			counters.last[e] = readCounter(counters.fd[e]);
+		}
+		return true;
+#else
+		if (report) {
+			cout << "The hardware counters need Linux perf_event, so they are "
+				<< "off" << endl;
+		}
+		return false;
+#endif
+	}
+}
+
+void PerfCounters::enable() {
+	enabled = openCounters(true);
+}
+
+bool PerfCounters::isEnabled() {
+	return enabled;
+}
+
+bool PerfCounters::read(Phase p) {
+	if (!counters.opened) {
+		openCounters(false);
+	}
+	if (counters.fd[0] < 0) {
+		return false;
+	}
+#ifdef __linux__
+	long long delta[nEvents];
+	for (int e = 0; e < nEvents; e++) {
+		long long now = readCounter(counters.fd[e]);
+		delta[e] = now - counters.last[e];
+		counters.last[e] = now;
+	}
+	lock_guard<mutex> guard(lock);
+	for (int e = 0; e < nEvents; e++) {
+		totals[p][e] += delta[e];
+	}
+#endif
+	return true;
+}
+
+// The counts before the phase go to the phase it's nested in
+PerfCounters::Scope::Scope(Phase p) {
+	active = enabled && read(counters.phase);
+	outer = counters.phase;
+	if (active) {
+		counters.phase = p;
+	}
+}
+
+PerfCounters::Scope::~Scope() {
+	if (!active) return;
+	read(counters.phase);
+	counters.phase = outer;
+}
+
+void PerfCounters::print(long long pairs) {
+	if (!enabled) return;
+	// The main thread counts until the end of the run
+	read(counters.phase);
+	const char* names[PHASES] = { "forces", "integration", "analysis", "other" };
+	lock_guard<mutex> guard(lock);
+	cout << "Hardware counters (user space, all threads):" << endl;
+	for (int p = 0; p < PHASES; p++) {
+		const long long* c = totals[p];
+		cout << "  " << left << setw(12) << names[p] << right
+			<< " cycles = " << c[0] << ", instructions = " << c[1]
+			<< ", IPC = " << (c[0] > 0 ? c[1] / static_cast<double>(c[0]) : 0.0)
+			<< ", cache misses = " << c[2] << ", branch misses = " << c[3]
+			<< endl;
+	}
+	if (pairs > 0) {
+		const long long* c = totals[FORCES];
+		cout << "  per pair of the forces: cycles = "
+			<< c[0] / static_cast<double>(pairs) << ", cache misses = "
+			<< c[2] / static_cast<double>(pairs) << ", branch misses = "
+			<< c[3] / static_cast<double>(pairs) << " (" << pairs
+			<< " pairs)" << endl;
+	}
+}
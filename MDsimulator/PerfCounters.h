@@ -0,0 +1,60 @@
+#ifndef _perfcounters_h
+#define _perfcounters_h
+
+#include <mutex>
+
+using namespace std;
+
+// Static class for counting the cycles, instructions, cache misses and
+// branch misses of the phases of a run with the hardware counters of the
+// Linux perf_event interface, so it shows whether a phase is limited by the
+// compute or the memory, without an external profiler. The counters are
+// only read at the borders of the phases, and the counts between two reads
+// go to the innermost phase, so the phases exclude their nested phases.
+//
+// The counters of a thread are inherited by the threads it creates after
+// they are opened, which are its OpenMP threads, so they count the parallel
+// loops too. The main thread opens its counters after the analysis workers
+// are started, and every worker opens its own, the first time it enters a
+// phase. On other systems, or if
+// the kernel doesn't allow the counters, the phases cost nothing.
+class PerfCounters
+{
+public:
+	// The measured phases. Everything outside of them is OTHER.
+	enum Phase { FORCES, INTEGRATION, ANALYSIS, OTHER, PHASES };
+
+	// Open the counters on the calling thread. Must be called before the
+	// first OpenMP region, so the OpenMP threads inherit them.
+	static void enable();
+	// Are the counters open?
+	static bool isEnabled();
+	// Print the counts, the instructions per cycle, and the misses per pair
+	// of the force phase, which visited the given number of atom pairs
+	static void print(long long pairs);
+
+	// Scope of a phase, which counts from its construction to its
+	// destruction on the calling thread
+	class Scope
+	{
+	public:
+		Scope(Phase p);
+		~Scope();
+
+	private:
+		bool active;
+		Phase outer;	// The phase, that this one is nested in
+	};
+
+private:
+	static constexpr int nEvents = 4;	// cycles, instructions, cache and branch misses
+	static bool enabled;
+	static mutex lock;					// Guards the totals
+	static long long totals[PHASES][nEvents];
+
+	// Read the counters of the calling thread, and add the counts since the
+	// last read to phase p. Returns false, if the thread has no counters.
+	static bool read(Phase p);
+};
+
+#endif // !_perfcounters_h
@@ -1,22 +1,67 @@
 #define _USE_MATH_DEFINES
 #include "Potential.h"
 #include <iostream>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
-// Constructor initializes dist and forces vectors, and links the Atoms object.
+// Constructor initializes the forces vectors, and links the Atoms object.
 // If the radial cut-off is in use, it also calculates constants for this.
 Potential::Potential(Atoms* a, double nDensity, double cutoff)
-	: dist(a->getSize(), vector<double>(a->getSize(), 0)),
-	forces(a->getSize(), vector<double>(3, 0))
+	: forces(a->getSize(), vector<double>(3, 0))
 {
 	atoms = a;
 	numberDensity = nDensity;
 	r_c = cutoff;
+	// Only a finite cut-off allows a cell list
+	if (r_c > 0.0) {
+		cells = new CellList(atoms, r_c);
+	}
 }
 
 // Destructor releases the memory of the internal vectors
 Potential::~Potential() {
-	vector<vector<double>>().swap(dist);
 	vector<vector<double>>().swap(forces);
+	delete forceArena;
+	delete threadArena;
+	delete pme;
+	delete cells;
+}
+
+Potential* Potential::createPotential(Atoms* a, dataT* d) {
+	Potential* pot;
+	// Switch on the Potential type, and create the proper one
+	switch (d->PT)
+	{
+	case PotType::LJ: {
+		LJ* lj = new LJ(a, d->rhoN, d->r_co);
+		lj->setTypes(d->eps_s, d->sigmas_s, d->ljPairs_s);
+		pot = lj;
+		break;
+	}
+	// default is a Lennard-Jones Potential
+	default: {
+		LJ* lj = new LJ(a, d->rhoN, d->r_co);
+		lj->setTypes(d->eps_s, d->sigmas_s, d->ljPairs_s);
+		pot = lj;
+		break;
+	}
+	}
+	// Partial charges interact through particle-mesh Ewald
+	if (a->hasCharges()) {
+		pot->setElectrostatics(new PME(a, d));
+	}
+	return pot;
+}
+
+const double* Potential::getForceArray() {
+	return flatForces;
+}
+
+const vector<vector<double>>& Potential::getForces() {
+	calculateForces();
+	storeForces();
+	return forces;
 }
 
 // Getter for the sumForceInteraction member
@@ -24,102 +69,540 @@ double Potential::getSumForcesInteraction() {
 	return sumForceInteractions;
 }
 
+vector<vector<double>> Potential::getVirialTensor() {
+	vector<vector<double>> W(3, vector<double>(3, 0));
+	for (int a = 0; a < 3; a++) {
+		for (int b = 0; b < 3; b++) {
+			W[a][b] = virial[a][b];
+		}
+	}
+	return W;
+}
+
+double Potential::getCutoff() {
+	return r_c;
+}
+
+long long Potential::getPairCount() {
+	return pairCount;
+}
+
+void Potential::disableCellList() {
+	delete cells;
+	cells = nullptr;
+}
+
+double Potential::getDistance(int i, int j, double* d) {
+	const double* x = atoms->getPositions();
+	for (int k = 0; k < 3; k++) {
+		d[k] = x[3 * (size_t)i + k] - x[3 * (size_t)j + k];
+	}
+	atoms->getBox().minimumImage(d);
+	double r = 0.0;
+	for (int k = 0; k < 3; k++) {
+		r += d[k] * d[k];
+	}
+	return pow(r, 0.5);
+}
+
+double* Potential::resetForces() {
+	int N = atoms->getSize();
+	if (flatSize != N) {
+		delete forceArena;
+		forceArena = new Arena(Arena::getBytes(3 * (size_t)N));
+		flatForces = forceArena->allocate(3 * (size_t)N, 3);
+		flatSize = N;
+		return flatForces;
+	}
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < N; i++) {
+		for (int k = 0; k < 3; k++) {
+			flatForces[3 * (size_t)i + k] = 0.0;
+		}
+	}
+	return flatForces;
+}
+
+// The force vectors keep their memory, unless the number of atoms changes
+void Potential::storeForces() {
+	int N = flatSize;
+	if (static_cast<int>(forces.size()) != N) {
+		forces.assign(N, vector<double>(3, 0));
+	}
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < N; i++) {
+		for (int k = 0; k < 3; k++) {
+			forces[i][k] = flatForces[3 * (size_t)i + k];
+		}
+	}
+}
+
+void Potential::resetVirial() {
+	for (int a = 0; a < 3; a++) {
+		for (int b = 0; b < 3; b++) {
+			virial[a][b] = 0.0;
+		}
+	}
+}
+
+void Potential::addVirial(const double* r, const double* f) {
+	addVirial(virial, r, f);
+}
+
+void Potential::addVirial(double (*W)[3], const double* r, const double* f) {
+	for (int a = 0; a < 3; a++) {
+		for (int b = 0; b < 3; b++) {
+			W[a][b] += r[a] * f[b];
+		}
+	}
+}
+
+// The buffers of the other threads are only allocated, when the number of
+// atoms or threads changes, and they are zeroed by the reduction
+vector<Potential::threadSumT> Potential::startThreadSums(double* F, double U) {
+	int nThreads = 1;
+#ifdef _OPENMP
+	nThreads = omp_get_max_threads();
+#endif
+	int N = flatSize;
+	if (threadSize != N * (nThreads - 1)) {
+		delete threadArena;
+		threadArena = nullptr;
+		threadForces = nullptr;
+		threadSize = N * (nThreads - 1);
+		if (threadSize > 0) {
+			size_t n = 3 * (size_t)threadSize;
+			threadArena = new Arena(Arena::getBytes(n));
+			threadForces = threadArena->allocate(n, 3);
+		}
+	}
+	vector<threadSumT> sums(nThreads);
+	sums[0].F = F;
+	sums[0].W = virial;
+	sums[0].U = U;
+	sums[0].sumF = sumForceInteractions;
+	for (int t = 1; t < nThreads; t++) {
+		sums[t].F = threadForces + 3 * (size_t)N * (t - 1);
+		sums[t].W = sums[t].ownW;
+	}
+	return sums;
+}
+
+double Potential::reduceThreadSums(vector<threadSumT>& sums) {
+	int nThreads = static_cast<int>(sums.size());
+	int N = flatSize;
+	for (int t = 1; t < nThreads; t++) {
+		sums[0].U += sums[t].U;
+		sums[0].sumF += sums[t].sumF;
+		sums[0].pairs += sums[t].pairs;
+		for (int a = 0; a < 3; a++) {
+			for (int b = 0; b < 3; b++) {
+				virial[a][b] += sums[t].ownW[a][b];
+			}
+		}
+	}
+	if (nThreads > 1) {
+		#pragma omp parallel for schedule(static)
+		for (int i = 0; i < N; i++) {
+			for (int t = 1; t < nThreads; t++) {
+				double* Ft = sums[t].F;
+				for (int k = 0; k < 3; k++) {
+					flatForces[3 * (size_t)i + k] += Ft[3 * (size_t)i + k];
+					Ft[3 * (size_t)i + k] = 0.0;
+				}
+			}
+		}
+	}
+	sumForceInteractions = sums[0].sumF;
+	pairCount += sums[0].pairs;
+	return sums[0].U;
+}
+
+void Potential::addReciprocalVirial() {
+	vector<vector<double>> W = pme->getVirialTensor();
+	for (int a = 0; a < 3; a++) {
+		for (int b = 0; b < 3; b++) {
+			virial[a][b] += W[a][b];
+		}
+	}
+}
+
+// The volume changes by mu^3, so only the number density is updated. The PME
+// recalculates its influence function by itself, when it sees the new box.
+void Potential::rescale(double mu) {
+	numberDensity /= mu * mu * mu;
+}
+
+// The Morton order of the molecules over the cell grid
+vector<int> Potential::getSpatialOrder() {
+	if (cells != nullptr) {
+		cells->build();
+		if (cells->isUsable()) {
+			return cells->getMortonOrder();
+		}
+	}
+	vector<int> order(atoms->getNM());
+	for (int m = 0; m < atoms->getNM(); m++) {
+		order[m] = m;
+	}
+	return order;
+}
+
+// The force vectors are permuted by the Ensemble
+void Potential::reorder(const vector<int>& order) {
+	if (flatForces != nullptr && flatSize == atoms->getSize()) {
+		Atoms::reorderMolecules(flatForces, order, atoms->getApm());
+	}
+}
+
+// Setter for the Ewald solver. Replaces any existing one.
+void Potential::setElectrostatics(PME* p) {
+	delete pme;
+	pme = p;
+}
+
 // Constructor for the Lennard-Jones potential initializes as a Potential
 LJ::LJ(Atoms* a, double nDensity, double cutoff) :
-	Potential(a, nDensity, cutoff) 
+	Potential(a, nDensity, cutoff),
+	pairTable(1)
 {
-	if (r_c != 0.0) {
-		cutoffEnergy = calculateEnergy(r_c);
-		diffU_r = -48 * (pow(1.0 / r_c, 13.0) - 0.5 * pow(1.0 / r_c, 7.0));
+	pairTable[0].ctor(1.0, 1.0, r_c);
+}
+
+// The table is filled with the mixing rules first, and then the explicit
+// pairs overwrite their entries
+void LJ::setTypes(vector<double> eps, vector<double> sigma,
+	vector<double> pairs) {
+	nTypes = static_cast<int>(eps.size());
+	pairTable.assign(nTypes * nTypes, ljPairT());
+	for (int a = 0; a < nTypes; a++) {
+		for (int b = 0; b < nTypes; b++) {
+			pairTable[a * nTypes + b].ctor(pow(eps[a] * eps[b], 0.5),
+				0.5 * (sigma[a] + sigma[b]), r_c);
+		}
+	}
+	for (size_t p = 0; p + 3 < pairs.size(); p += 4) {
+		int a = static_cast<int>(pairs[p]);
+		int b = static_cast<int>(pairs[p + 1]);
+		if (a < 0 || b < 0 || a >= nTypes || b >= nTypes) {
+			cout << "LJ pair (" << a << ", " << b << ") refers to a type "
+				<< "that doesn't exist" << endl;
+			exit(-1);
+		}
+		pairTable[a * nTypes + b].ctor(pairs[p + 2], pairs[p + 3], r_c);
+		pairTable[b * nTypes + a] = pairTable[a * nTypes + b];
+	}
+
+	// The fractions of the types weight the tail corrections
+	vector<double> x(nTypes, 0.0);
+	for (int i = 0; i < atoms->getSize(); i++) {
+		x[atoms->getType(i)] += 1.0 / atoms->getSize();
+	}
+	tail12 = 0.0;
+	tail6 = 0.0;
+	for (int a = 0; a < nTypes; a++) {
+		for (int b = 0; b < nTypes; b++) {
+			tail12 += x[a] * x[b] * pairTable[a * nTypes + b].c12 / 4.0;
+			tail6 += x[a] * x[b] * pairTable[a * nTypes + b].c6 / 4.0;
+		}
 	}
+	// Bring the cached results up to date
+	cellVersion = ~0ULL;
+	pairVersion = ~0ULL;
 }
 
 // Function for returning the potential energy 
 double LJ::getEnergy() {
-	// Get the distances
-	dist = atoms->getDistances();
+	// The cell list calculates the energy together with the forces
+	if (cells != nullptr) {
+		calculateForces();
+		if (cellVersion == atoms->getPositionVersion()) {
+			return cellEnergy;
+		}
+	}
 
 	// Initialize the energy as zero
 	double U = 0.0;
 	// Run over all atom pairs and calculate the energy
 	for (int i = 0; i < atoms->getSize() - 1; i++) {
 		for (int j = i + 1; j < atoms->getSize(); j++) {
+			double d[3];
+			double r = getDistance(i, j, d);
 			// Don't use th LJ potential, if the atoms are bonded
 			if (atoms->isBonded(i, j)) {
 				U += atoms->getBondEnergy(i, j);
 			} else {
-				U += calculateEnergy(dist[i][j]);
+				U += calculateEnergy(r, pairTable[
+					atoms->getType(i) * nTypes + atoms->getType(j)]);
+			}
+			// Add the real-space part of the electrostatics
+			if (pme != nullptr) {
+				double qq = atoms->getCharge(i) * atoms->getCharge(j);
+				if (qq == 0.0) continue;
+				if (atoms->isBonded(i, j)) {
+					U += pme->exclusionEnergy(qq, r);
+				} else {
+					U += pme->realEnergy(qq, r);
+				}
 			}
 		}
 	}
+	// The reciprocal and self energy were found with the forces
+	if (pme != nullptr) {
+		U += pme->getEnergy();
+	}
 	// Return the potential energy
 	return U + calculateEnergyCorrection();
 }
 
-vector<vector<double>> LJ::getForces() {
+const double* LJ::calculateForces() {
+	// Use the cell list, if the cell is large enough for it
+	if (cells != nullptr) {
+		if (cellVersion == atoms->getPositionVersion()) {
+			return flatForces;
+		}
+		cells->build();
+		if (cells->isUsable()) {
+			return calculateForcesCellList();
+		}
+	}
+
 	// Only recalculate the forces, if the atomic positions have changed
-	if (!(atoms->hasChangedPositions())) {
-		return forces;
+	if (pairVersion == atoms->getPositionVersion()) {
+		return flatForces;
 	}
-	// Get the distances
-	dist = atoms->getDistances();
-	
-	// Reset the sumForceInteractions
+
+	// Reset the sumForceInteractions and the virial tensor
 	sumForceInteractions = 0.0;
+	resetVirial();
 
-	// Run through all atom pairs
-	vector<vector<double>> F(atoms->getSize(), vector<double>(3, 0));
-	for (int i = 0; i < atoms->getSize() - 1; i++) {
-		for (int j = i + 1; j < atoms->getSize(); j++) {
-			// Only calculate the bond force, if the atoms are bonded
-			if (atoms->isBonded(i, j)) {
-				vector<double> F_ji = atoms->getBondForce(i, j);
-				for (int k = 0; k < 3; k ++) {
-					double diff = atoms->getPos(i)[k] - atoms->getPos(j)[k];
+	// Run through all atom pairs. The rows get shorter, so they are dealt
+	// out to the threads one by one.
+	double* F = resetForces();
+	vector<threadSumT> sums = startThreadSums(F, 0.0);
+	int N = atoms->getSize();
+	#pragma omp parallel
+	{
+		int t = 0;
+#ifdef _OPENMP
+		t = omp_get_thread_num();
+#endif
+		threadSumT& s = sums[t];
+		#pragma omp for schedule(static, 1)
+		for (int i = 0; i < N - 1; i++) {
+			s.pairs += N - 1 - i;
+			for (int j = i + 1; j < N; j++) {
+				// The minimum image separation, which is computed on the fly
+				double d[3];
+				double r = getDistance(i, j, d);
+				// Only calculate the bond force, if the atoms are bonded
+				if (atoms->isBonded(i, j)) {
+					vector<double> F_ji = atoms->getBondForce(i, j);
+					// Remove the reciprocal interaction between bonded charges
+					if (pme != nullptr) {
+						double qq = atoms->getCharge(i) * atoms->getCharge(j);
+						double pfq = qq != 0.0 ?
+							pme->exclusionForce(qq, r) : 0.0;
+						for (int k = 0; k < 3; k++) {
+							F_ji[k] -= pfq * (atoms->getPos(j)[k]
+								- atoms->getPos(i)[k]);
+						}
+					}
+					double r_ij[3];
+					for (int k = 0; k < 3; k ++) {
+						double diff = atoms->getPos(i)[k] - atoms->getPos(j)[k];
+						r_ij[k] = diff;
 
-					// Add the force to the force vectors
-					F[i][k] += F_ji[k];
-					F[j][k] -= F_ji[k];
+						// Add the force to the force vectors
+						s.F[3 * i + k] += F_ji[k];
+						s.F[3 * j + k] -= F_ji[k];
 
-					// Add the sum force interactions
-					sumForceInteractions += F_ji[k] * diff;
+						// Add the sum force interactions
+						s.sumF += F_ji[k] * diff;
+					}
+					addVirial(s.W, r_ij, &F_ji[0]);
+					continue;
+				}
+
+				// Skip the calculation if the distance is longer than cutoff
+				if (r_c != 0.0 && r > r_c) {
+					continue;
 				}
-				continue;
-			}
 
-			// Skip the calculation if the distance is longer than cutoff
-			if (r_c != 0.0 && dist[i][j] > r_c) {
-				continue;
+				// force prefactor from the coefficients of the two types
+				const ljPairT& lj = pairTable[
+					atoms->getType(i) * nTypes + atoms->getType(j)];
+				double inv2 = 1.0 / (r * r);
+				double pf = lj.getForce(inv2, inv2 * inv2 * inv2);
+				// The screened Coulomb force has the same direction
+				if (pme != nullptr) {
+					double qq = atoms->getCharge(i) * atoms->getCharge(j);
+					if (qq != 0.0) {
+						pf += pme->realForce(qq, r);
+					}
+				}
+				double F_ji[3];
+				for (int k = 0; k < 3; k++)	{
+					double pbc_dist = d[k];
+
+					// Multiply the prefactor with the distance
+					double F_jia = pf * pbc_dist;
+
+					// If we are working with a cut-off, then add the correction
+					if (r_c != 0.0) {
+						F_jia += lj.diffU_r * pbc_dist / r;
+					}
+
+					// Add the force to the vector of both affected atoms
+					s.F[3 * i + k] += F_jia;
+					s.F[3 * j + k] -= F_jia;
+
+					// Add the force interaction
+					s.sumF += F_jia * pbc_dist;
+					F_ji[k] = F_jia;
+				}
+				addVirial(s.W, d, F_ji);
 			}
+		}
+	}
+	reduceThreadSums(sums);
+	// Add the long-ranged part of the electrostatics
+	if (pme != nullptr) {
+		pme->addReciprocalForces(F);
+		sumForceInteractions += pme->getVirial();
+		addReciprocalVirial();
+	}
+	pairVersion = atoms->getPositionVersion();
+	return F;
+}
+
+// The pairs are found from each cell and the 13 cells in its forward half
+// shell, so every pair within the cut-off is visited exactly once. The
+// positions are read directly from the flat array of the Atoms, so the inner
+// loop reads contiguous memory when the atoms are sorted spatially, and the
+// forces go to a flat array, which is only allocated when N changes. The
+// cells are shared by the threads in a static partition, so with the
+// molecules sorted along the cells, a thread mostly works on a contiguous
+// part of the arrays.
+const double* LJ::calculateForcesCellList() {
+	int apm = atoms->getApm();
+	const boxT& box = atoms->getBox();
+	double r_c2 = r_c * r_c;
+	const double* x = atoms->getPositions();
+	double* F = resetForces();
+	double U = 0.0;
+	sumForceInteractions = 0.0;
+	resetVirial();
 
-			// force prefactor
-			double pf = 48 * ( pow(1.0 / dist[i][j], 14.0) 
-				- 0.5 * pow(1.0 / dist[i][j], 8.0) );
-			for (int k = 0; k < 3; k++)	{
-				// Calculate the pbc distance per axis
-				double diff = atoms->getPos(i)[k] - atoms->getPos(j)[k];
-				double pbc_dist = diff - atoms->getCellLength()
-					* round(diff / atoms->getCellLength());
-
-				// Multiply the prefactor with the distance
-				double F_jia = pf * pbc_dist;
-				
-				// If we are working with a cut-off, then add the correction
-				if (r_c != 0.0) {
-					F_jia += diffU_r * pbc_dist / dist[i][j];
+	// The bonded pairs within each molecule, which don't have LJ interactions
+	for (int m = 0; m < atoms->getNM(); m++) {
+		for (int i = m * apm; i < (m + 1) * apm - 1; i++) {
+			for (int j = i + 1; j < (m + 1) * apm; j++) {
+				if (!atoms->isBonded(i, j)) continue;
+				U += atoms->getBondEnergy(i, j);
+				vector<double> F_ji = atoms->getBondForce(i, j);
+				double qq = atoms->getCharge(i) * atoms->getCharge(j);
+				double pfq = 0.0;
+				if (pme != nullptr && qq != 0.0) {
+					double r = 0.0;
+					for (int k = 0; k < 3; k++) {
+						r += (x[3 * i + k] - x[3 * j + k])
+							* (x[3 * i + k] - x[3 * j + k]);
+					}
+					r = pow(r, 0.5);
+					U += pme->exclusionEnergy(qq, r);
+					pfq = pme->exclusionForce(qq, r);
 				}
+				double r_ij[3];
+				for (int k = 0; k < 3; k++) {
+					double diff = x[3 * i + k] - x[3 * j + k];
+					r_ij[k] = diff;
+					F_ji[k] += pfq * diff;
+					F[3 * i + k] += F_ji[k];
+					F[3 * j + k] -= F_ji[k];
+					sumForceInteractions += F_ji[k] * diff;
+				}
+				addVirial(r_ij, &F_ji[0]);
+			}
+		}
+	}
 
-				// Add the force to the vector of both affected atoms
-				F[i][k] += F_jia;
-				F[j][k] -= F_jia;
+	vector<threadSumT> sums = startThreadSums(F, U);
+	int nCells = cells->getNumberOfCells();
+	#pragma omp parallel
+	{
+		int t = 0;
+#ifdef _OPENMP
+		t = omp_get_thread_num();
+#endif
+		threadSumT& s = sums[t];
+		// The non-bonded pair interaction of atom i and j
+		auto addPair = [&](int i, int j) {
+			double d[3];
+			for (int k = 0; k < 3; k++) {
+				d[k] = x[3 * i + k] - x[3 * j + k];
+			}
+			box.minimumImage(d);
+			double r2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+			if (r2 > r_c2 || atoms->isBonded(i, j)) return;
+			const ljPairT& lj = pairTable[
+				atoms->getType(i) * nTypes + atoms->getType(j)];
+			double r = pow(r2, 0.5);
+			double inv2 = 1.0 / r2;
+			double inv6 = inv2 * inv2 * inv2;
+			// force prefactor with the shifted force at the cut-off
+			double pf = lj.getForce(inv2, inv6) + lj.diffU_r / r;
+			s.U += lj.getEnergy(inv6) - lj.cutoffEnergy
+				- lj.diffU_r * (r - r_c);
+			if (pme != nullptr) {
+				double qq = atoms->getCharge(i) * atoms->getCharge(j);
+				if (qq != 0.0) {
+					pf += pme->realForce(qq, r);
+					s.U += pme->realEnergy(qq, r);
+				}
+			}
+			double f[3];
+			for (int k = 0; k < 3; k++) {
+				f[k] = pf * d[k];
+				s.F[3 * i + k] += f[k];
+				s.F[3 * j + k] -= f[k];
+			}
+			s.sumF += pf * r2;
+			addVirial(s.W, d, f);
+		};
 
-				// Add the force interaction
-				sumForceInteractions += F_jia * pbc_dist;
+		#pragma omp for schedule(static)
+		for (int c = 0; c < nCells; c++) {
+			int end = cells->getCellStart(c + 1);
+			for (int a = cells->getCellStart(c); a < end; a++) {
+				int i = cells->getAtom(a);
+				// The other atoms in the same cell
+				for (int b = a + 1; b < end; b++) {
+					addPair(i, cells->getAtom(b));
+				}
+				s.pairs += end - a - 1;
+				// The atoms in the neighbouring cells
+				for (int nb : cells->getHalfShell(c)) {
+					int nbEnd = cells->getCellStart(nb + 1);
+					s.pairs += nbEnd - cells->getCellStart(nb);
+					for (int b = cells->getCellStart(nb); b < nbEnd; b++) {
+						addPair(i, cells->getAtom(b));
+					}
+				}
 			}
 		}
 	}
-	// Save the forces to the internal memory
-	forces = F;
+	U = reduceThreadSums(sums);
+
+	// Add the long-ranged part of the electrostatics
+	if (pme != nullptr) {
+		pme->addReciprocalForces(F);
+		sumForceInteractions += pme->getVirial();
+		addReciprocalVirial();
+		U += pme->getEnergy();
+	}
+	cellEnergy = U + calculateEnergyCorrection();
+	cellVersion = atoms->getPositionVersion();
 	return F;
 }
 
@@ -128,7 +611,7 @@ double LJ::getPressureCorrection() {
 		return 0;
 	}
 	return 32.0 / 9.0 * M_PI * numberDensity * numberDensity *
-		(pow(1.0 / r_c, 9.0) - 1.5 * pow(1.0 / r_c, 3.0));
+		(tail12 * pow(1.0 / r_c, 9.0) - 1.5 * tail6 * pow(1.0 / r_c, 3.0));
 }
 
 // Helper function for printing the forces vector to the console
@@ -141,15 +624,23 @@ void LJ::printForces(vector<vector<double>> F) {
 	}
 }
 
-double LJ::calculateEnergy(double r) {
+double LJ::calculateEnergy(double r, const ljPairT& lj) {
 	if (r_c != 0.0 && r_c < r) {
 		return 0;
 	}
-	double U_r = 4.0 * (pow(1.0 / r, 12.0) - pow(1.0 / r, 6.0));
+	double U_r = lj.getEnergy(pow(1.0 / r, 6.0));
 	if (r_c == 0.0) {
 		return U_r;
 	}
-	return U_r - cutoffEnergy - diffU_r * (r - r_c);
+	return U_r - lj.cutoffEnergy - lj.diffU_r * (r - r_c);
+}
+
+double LJ::getPairEnergy(int a, int b, double r) {
+	return calculateEnergy(r, pairTable[a * nTypes + b]);
+}
+
+double LJ::getEnergyCorrection() {
+	return calculateEnergyCorrection();
 }
 
 double LJ::calculateEnergyCorrection() {
@@ -157,5 +648,5 @@ double LJ::calculateEnergyCorrection() {
 		return 0;
 	}
 	return 8.0 / 9.0 * M_PI * atoms->getSize() * numberDensity *
-		(pow(1.0 / r_c, 9.0) - 3.0 * pow(1.0 / r_c, 3.0));
+		(tail12 * pow(1.0 / r_c, 9.0) - 3.0 * tail6 * pow(1.0 / r_c, 3.0));
 }
\ No newline at end of file
@@ -2,12 +2,15 @@
 #define _potential_h
 
 #include "Atoms.h"
+#include "PME.h"
+#include "CellList.h"
+#include "pairType.h"
 
 // Enumerator containing the implemented potential types
 enum class PotType { LJ };
 
 // Abstract class for making a potential for atom interaction. Implementing
-// classes must implement getEnergy() and getForces()
+// classes must implement getEnergy() and calculateForces()
 class Potential
 {
 public:
@@ -15,15 +18,58 @@ public:
 	Potential(Atoms* atoms, double numberDensity, double radialCutOff);
 	virtual ~Potential();
 
+	// Static function for creating the potential given by the data, with
+	// particle-mesh Ewald electrostatics, if the atoms carry charges
+	static Potential* createPotential(Atoms* atoms, dataT* data);
+
 	// Function for getting the potential energy of the collection of atoms
 	virtual double getEnergy() = 0;
-	// Function for getting the forces on every atom
-	virtual vector<vector<double>> getForces() = 0;
+	// Calculate the forces on every atom as x, y, z of the atoms after each
+	// other, unless the positions haven't changed since the last time. The
+	// array is reused by the following calculations.
+	virtual const double* calculateForces() = 0;
+	// Get the forces on every atom as vectors, which are copied from the
+	// array. The reference stays valid until the next call.
+	const vector<vector<double>>& getForces();
 	// Calculate the pressure tail correction resulting from the cut-off
 	virtual double getPressureCorrection() = 0;
+	// Get the non-bonded energy of two atoms of type a and b at the distance
+	// r, without the electrostatics. The Monte Carlo moves and the Widom
+	// insertions sum it over the neighbours.
+	virtual double getPairEnergy(int a, int b, double r) = 0;
+	// Get the energy tail correction resulting from the cut-off
+	virtual double getEnergyCorrection() = 0;
+	// Get the cut-off (0 = no cut-off)
+	double getCutoff();
+	// Use the all-pairs loops instead of the cell list. They are the
+	// reference, which the faster kernels are checked against.
+	void disableCellList();
+	// Get the number of atom pairs visited by all the force calculations
+	long long getPairCount();
+
+	// Get the forces of the last calculation as x, y, z of the atoms after
+	// each other. The array is reused by the following calculations.
+	const double* getForceArray();
 
 	// Function for retrieving the sum of force interactions ((r_i - r_j) * F_ji)
 	double getSumForcesInteraction();
+	// Function for retrieving the virial tensor sum (r_i - r_j)_a * (F_ji)_b,
+	// which is accumulated in the same pass as the forces. Its trace is the
+	// sum of force interactions.
+	vector<vector<double>> getVirialTensor();
+
+	// Update the number density after the cell has been scaled by mu
+	void rescale(double mu);
+
+	// Get an ordering of the molecules, which places molecules that are close
+	// in space close in memory (identity if there is no cell list)
+	vector<int> getSpatialOrder();
+	// Apply a reordering of the molecules to the flat force array
+	void reorder(const vector<int>& order);
+
+	// Add particle-mesh Ewald electrostatics between the partial charges. The
+	// Potential takes ownership of the PME object.
+	void setElectrostatics(PME* pme);
 
 // The following menbers are protected, so they are inherited by implementing
 // classes
@@ -31,35 +77,111 @@ protected:
 	Atoms* atoms;
 	double numberDensity;	// number density (dimension-less)
 	double r_c;				// radial cut-off (dimension-less)
-	// Keep the results of distances and forces in memory to reduce
-	// computational cost
+	// Keep the results of the forces in memory to reduce computational cost
 	double sumForceInteractions = 0;
-	vector<vector<double>> dist;
+	double virial[3][3] = {};
 	vector<vector<double>> forces;
+	long long pairCount = 0;	// The pairs visited by the force calculations
+	// The forces are accumulated in a flat array (x, y, z of the atoms after
+	// each other), which is kept between the calculations
+	Arena* forceArena = nullptr;
+	double* flatForces = nullptr;
+	int flatSize = 0;		// The number of atoms the flat array is for
+	// The forces of the threads after the first in a parallel calculation,
+	// which are kept zeroed between the calculations
+	Arena* threadArena = nullptr;
+	double* threadForces = nullptr;
+	int threadSize = 0;		// The number of atoms times the other threads
+	// The Ewald solver for the charges (nullptr if the atoms are neutral)
+	PME* pme = nullptr;
+	// The cell list for finding pairs within the cut-off (nullptr without)
+	CellList* cells = nullptr;
+
+	// Get the zeroed flat force array, which is only allocated when the number
+	// of atoms changes
+	double* resetForces();
+	// Copy the flat force array to the force vectors
+	void storeForces();
+
+	// The sums of a thread in a parallel force calculation. The first thread
+	// adds to the force array, the virial and the sums of the Potential, so
+	// one thread gives the same result as the serial loops, and the others
+	// add to their own, which are added afterwards.
+	struct threadSumT {
+		double* F = nullptr;		// The forces
+		double (*W)[3] = nullptr;	// The virial tensor
+		double U = 0.0;				// The energy
+		double sumF = 0.0;			// The sum of force interactions
+		long long pairs = 0;		// The visited pairs
+		double ownW[3][3] = {};		// The virial of the other threads
+	};
+	// Get the sums of every thread, where the first starts from the energy
+	// U and the sums so far, and the others from zero
+	vector<threadSumT> startThreadSums(double* F, double U);
+	// Add the sums of the other threads to the ones of the first in thread
+	// order, and the forces in the same static partition of the atoms as
+	// the one the arrays were first touched with. Returns the energy.
+	double reduceThreadSums(vector<threadSumT>& sums);
+	// Get the minimum image distance between atom i and j, and the separation
+	// r_i - r_j in d
+	double getDistance(int i, int j, double* d);
+	// Reset the virial tensor before a force calculation
+	void resetVirial();
+	// Add the outer product of a pair separation and its force to the virial
+	void addVirial(const double* r, const double* f);
+	static void addVirial(double (*W)[3], const double* r, const double* f);
+	// Add the reciprocal Ewald virial tensor to the virial
+	void addReciprocalVirial();
 };
 
-// Implementation of the Potential class with a Lennard-Jones 12-6 potential
+// Implementation of the Potential class with a Lennard-Jones 12-6 potential.
+// Every pair of atom types has its own parameters, which are kept in a dense
+// type x type table, so the pair kernel finds them with one indexed load.
 class LJ :
 	public Potential
 {
 public:
+	// The constructor sets up a single type with eps = sigma = 1
 	LJ(Atoms* a, double numberDensity, double radialCutoff);
 
-	// Implements the abstract functions getEnergy() and getForces()
+	// Set the (reduced) parameters of the atom types. The pairs of different
+	// types are mixed by the Lorentz-Berthelot rules, unless they are given
+	// explicitly in pairs as (type a, type b, eps, sigma) after each other.
+	void setTypes(vector<double> eps, vector<double> sigma,
+		vector<double> pairs);
+
+	// Implements the abstract functions getEnergy() and calculateForces()
 	double getEnergy();
-	vector<vector<double>> getForces();
+	const double* calculateForces();
 	// Calculate the pressure tail correction resulting from the cut-off
 	double getPressureCorrection();
+	// Get the energy of a pair of atoms with the parameters of their types
+	double getPairEnergy(int a, int b, double r);
+	// Calculate the energy tail correction resulting from the cut-off
+	double getEnergyCorrection();
 	
 	// Helper functions for writing the force vector to console
 	void printForces(vector<vector<double>> F);
 
 private:
-	double cutoffEnergy = 0.0;	// the energy at the cut-off
-	double diffU_r = 0.0;	// the force at the cut-off
+	int nTypes = 1;					// The number of atom types
+	vector<ljPairT> pairTable;		// The coefficients of type a and b at a * nTypes + b
+	// The sum over the type pairs of x_a x_b c12 / 4 and x_a x_b c6 / 4, where
+	// x are the fractions of the types, for the tail corrections
+	double tail12 = 1.0;
+	double tail6 = 1.0;
+	double cellEnergy = 0.0;	// the energy found with the cell list forces
+	// The position version of the Atoms, that the cell list results are for
+	unsigned long long cellVersion = ~0ULL;
+	// The position version, that the all-pairs forces are for
+	unsigned long long pairVersion = ~0ULL;
+
+	// Calculate forces and energy in one pass over the pairs from the cell
+	// list, with the bonded pairs handled per molecule
+	const double* calculateForcesCellList();
 
 	// Calculate the energy between a single pair, and handle cut-off
-	double calculateEnergy(double distance);
+	double calculateEnergy(double distance, const ljPairT& pair);
 	// Calculate the energy tail correction resulting from the cut-off
 	double calculateEnergyCorrection();
 };
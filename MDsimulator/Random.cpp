@@ -0,0 +1,81 @@
+#define _USE_MATH_DEFINES
+#include "Random.h"
+#include <cmath>
+
+// The constructor splits the seed into the two key words
+CounterRNG::CounterRNG(uint64_t seed) {
+	key[0] = static_cast<uint32_t>(seed);
+	key[1] = static_cast<uint32_t>(seed >> 32);
+}
+
+// The counter is (atom, low and high word of the step, stream). The 32 bit
+// outputs are mapped to the open interval (0, 1), so log(u) is always finite.
+void CounterRNG::uniform(uint32_t atom, uint64_t step, uint32_t stream,
+	double* u) {
+	uint32_t counter[4] = { atom, static_cast<uint32_t>(step),
+		static_cast<uint32_t>(step >> 32), stream };
+	uint32_t out[4];
+	philox(counter, key, out);
+	for (int j = 0; j < 4; j++) {
+		u[j] = (out[j] + 0.5) * (1.0 / 4294967296.0);
+	}
+}
+
+// Two independent pairs of uniform numbers give two pairs of gaussians, each
+// pair using one number for the radius and the other for the angle
+void CounterRNG::gaussian(uint32_t atom, uint64_t step, uint32_t stream,
+	double* g) {
+	double u[4];
+	uniform(atom, step, stream, u);
+	for (int j = 0; j < 4; j += 2) {
+		double r = sqrt(-2.0 * log(u[j]));
+		double phi = 2.0 * M_PI * u[j + 1];
+		g[j] = r * cos(phi);
+		g[j + 1] = r * sin(phi);
+	}
+}
+
+// The rotation of a unit quaternion of four normal numbers, which is uniform
+// on the unit sphere in four dimensions, so the rotations are uniform too
+void CounterRNG::rotation(uint32_t atom, uint64_t step, uint32_t stream,
+	double rot[3][3]) {
+	double q[4];
+	gaussian(atom, step, stream, q);
+	double norm = sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+	double w = q[0] / norm, x = q[1] / norm, y = q[2] / norm, z = q[3] / norm;
+	rot[0][0] = 1 - 2 * (y * y + z * z);
+	rot[0][1] = 2 * (x * y - w * z);
+	rot[0][2] = 2 * (x * z + w * y);
+	rot[1][0] = 2 * (x * y + w * z);
+	rot[1][1] = 1 - 2 * (x * x + z * z);
+	rot[1][2] = 2 * (y * z - w * x);
+	rot[2][0] = 2 * (x * z - w * y);
+	rot[2][1] = 2 * (y * z + w * x);
+	rot[2][2] = 1 - 2 * (x * x + y * y);
+}
+
+// Ten rounds of the Philox S-box, bumping the key with the Weyl sequence
+// between the rounds
+void CounterRNG::philox(const uint32_t* c, const uint32_t* k, uint32_t* out) {
+	const uint32_t M0 = 0xD2511F53, M1 = 0xCD9E8D57;
+	const uint32_t W0 = 0x9E3779B9, W1 = 0xBB67AE85;
+	uint32_t x[4] = { c[0], c[1], c[2], c[3] };
+	uint32_t k0 = k[0], k1 = k[1];
+	for (int round = 0; round < 10; round++) {
+		uint64_t p0 = static_cast<uint64_t>(M0) * x[0];
+		uint64_t p1 = static_cast<uint64_t>(M1) * x[2];
+		uint32_t hi0 = static_cast<uint32_t>(p0 >> 32);
+		uint32_t lo0 = static_cast<uint32_t>(p0);
+		uint32_t hi1 = static_cast<uint32_t>(p1 >> 32);
+		uint32_t lo1 = static_cast<uint32_t>(p1);
+		x[0] = hi1 ^ x[1] ^ k0;
+		x[1] = lo1;
+		x[2] = hi0 ^ x[3] ^ k1;
+		x[3] = lo0;
+		k0 += W0;
+		k1 += W1;
+	}
+	for (int j = 0; j < 4; j++) {
+		out[j] = x[j];
+	}
+}
@@ -0,0 +1,39 @@
+#ifndef _random_h
+#define _random_h
+
+#include <cstdint>
+
+// Counter-based random number generator (Philox4x32-10, Salmon et al., SC'11).
+// Instead of carrying a state, every draw is a pure function of the key (the
+// seed) and a counter (atom index, step and stream), so the numbers for an
+// atom at a given step are the same no matter which thread asks for them or
+// in what order. This gives bit-reproducible runs independent of the thread
+// count, and independent streams for every atom in parallel loops.
+class CounterRNG
+{
+public:
+	// The streams in use, so different uses never share random numbers
+	enum Stream : uint32_t { VELOCITY_INIT = 0, THERMOSTAT = 1, INSERTION = 2,
+		EXCHANGE = 3, MONTE_CARLO = 4, VOLUME_MOVE = 5,
+		WIDOM = 6, RELOCATION = 7 };
+
+	// Constructor takes the 64 bit seed as the key
+	CounterRNG(uint64_t seed);
+
+	// Get four uniform numbers in (0, 1) for the given counter
+	void uniform(uint32_t atom, uint64_t step, uint32_t stream, double* u);
+	// Get four standard normal numbers for the given counter (Box-Muller)
+	void gaussian(uint32_t atom, uint64_t step, uint32_t stream, double* g);
+	// Get a uniform random rotation matrix for the given counter
+	void rotation(uint32_t atom, uint64_t step, uint32_t stream,
+		double rot[3][3]);
+
+	// The raw Philox4x32-10 block function
+	static void philox(const uint32_t* counter, const uint32_t* key,
+		uint32_t* out);
+
+private:
+	uint32_t key[2];	// The seed split in two 32 bit words
+};
+
+#endif // !_random_h
@@ -0,0 +1,146 @@
+#include "ReplicaExchange.h"
+#include <iostream>
+#include <algorithm>
+#include "Setup.h"
+#include "TaskScheduler.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// The geometric ladder gives the same acceptance to every pair, if the heat
+// capacity is constant. Every replica gets its own seed, so the lattices,
+// velocities and random forces differ.
+ReplicaExchange::ReplicaExchange(dataT* d)
+	: rng(0)
+{
+	M = d->nReplicas;
+	interval = max(1, d->exchangeInterval);
+	if (d->ET == EnsType::NVE || d->monteCarlo != 0) {
+		cout << "Replica exchange needs MD with a thermostat (ens = NVT or "
+			<< "NPT, and mc = 0)" << endl;
+		exit(-1);
+	}
+	if (d->T_max <= d->T) {
+		cout << "T_max has to be above T for replica exchange" << endl;
+		exit(-1);
+	}
+	int nThreads = 1;
+#ifdef _OPENMP
+	nThreads = omp_get_max_threads();
+#endif
+	threadsPerReplica = max(1, nThreads / M);
+
+	data.assign(M, *d);
+	for (int k = 0; k < M; k++) {
+		T.push_back(d->T_s * pow(d->T_max / d->T, k / (M - 1.0)));
+		ladder.push_back(k);
+	}
+	for (int r = 0; r < M; r++) {
+		data[r].T_s = T[r];
+		data[r].T = T[r] * d->epsK;
+		if (r > 0) {
+			data[r].seed = data[0].seed + r;
+		}
+		cout << "Replica " << r << " at T = " << data[r].T << " K" << endl;
+		atoms.push_back(new Atoms(d->apm, d->mass));
+		InitializeSetup(atoms[r], &data[r]);
+		ens.push_back(static_cast<NVT*>(
+			Ensemble::createEnsemble(atoms[r], &data[r])));
+		U.push_back(ens[r]->calculate());
+	}
+	rng = CounterRNG(data[0].seed);
+	attempts.assign(M - 1, 0);
+	accepted.assign(M - 1, 0);
+	Uav.resize(M);
+}
+
+ReplicaExchange::~ReplicaExchange() {
+	for (int r = 0; r < M; r++) {
+		delete ens[r];
+		delete atoms[r];
+	}
+}
+
+// Every replica advances on a worker thread until the next exchange, which
+// is done serially, when they have all arrived
+void ReplicaExchange::run(ofstream& logger) {
+	TaskScheduler tasks(M, threadsPerReplica);
+	logger << "t";
+	for (int k = 0; k < M; k++) {
+		logger << "\tU_" << k;
+	}
+	logger << endl;
+
+	int steps = data[0].simSteps;
+	for (int i = 0; i < steps; i += interval) {
+		int n = min(interval, steps - i);
+		for (int k = 0; k < M; k++) {
+			int r = ladder[k];
+			tasks.submit([this, r, i, n, k]() {
+				advance(r, i, n, k);
+			}, {});
+		}
+		tasks.waitAll();
+
+		logger << (i + n) * data[0].dt_ps;
+		for (int k = 0; k < M; k++) {
+			logger << "\t" << U[ladder[k]] * data[0].eps;
+		}
+		logger << endl;
+		exchange(i / interval);
+	}
+}
+
+// The worker thread has its share of the OpenMP threads from the scheduler.
+// The molecules are reordered at the same steps as in a single simulation.
+void ReplicaExchange::advance(int r, int first, int n, int k) {
+	const dataT& d = data[r];
+	for (int i = first + 1; i <= first + n; i++) {
+		ens[r]->update();
+		U[r] = ens[r]->calculate();
+		if (i > d.eqSteps) {
+			Uav[k].addPoint(U[r] * d.eps);
+		}
+		if (d.reorderInterval > 0 && i % d.reorderInterval == 0) {
+			ens[r]->reorder();
+		}
+	}
+}
+
+// The replicas a at T_k and b at T_k+1 swap with the probability
+// min(1, exp[(1/T_k - 1/T_k+1)(U_a - U_b + P (V_a - V_b))]). The pressure
+// term only enters with the barostat.
+void ReplicaExchange::exchange(long long number) {
+	for (int k = static_cast<int>(number % 2); k + 1 < M; k += 2) {
+		int a = ladder[k], b = ladder[k + 1];
+		double dE = U[a] - U[b];
+		if (data[0].ET == EnsType::NPT) {
+			dE += data[0].P_s * (atoms[a]->getBox().getVolume()
+				- atoms[b]->getBox().getVolume());
+		}
+		double delta = (1.0 / T[k] - 1.0 / T[k + 1]) * dE;
+		double u[4];
+		rng.uniform(k, number, CounterRNG::EXCHANGE, u);
+		attempts[k]++;
+		if (delta >= 0.0 || u[0] < exp(delta)) {
+			ens[a]->exchangeThermostat(ens[b]);
+			swap(ladder[k], ladder[k + 1]);
+			accepted[k]++;
+		}
+	}
+}
+
+void ReplicaExchange::printSummary() {
+	double epsK = data[0].epsK;
+	for (int k = 0; k < M; k++) {
+		cout << "T = " << T[k] * epsK << " K: U = " << Uav[k].getMean()
+			<< " +- " << Uav[k].getError() << " eV"
+			<< (Uav[k].isConverged() ? "" : " (lower bound)") << endl;
+	}
+	for (int k = 0; k + 1 < M; k++) {
+		cout << "Acceptance " << T[k] * epsK << " K <-> " << T[k + 1] * epsK
+			<< " K: " << (attempts[k] > 0
+				? accepted[k] / static_cast<double>(attempts[k]) : 0.0)
+			<< " (" << accepted[k] << "/" << attempts[k] << ")" << endl;
+	}
+}
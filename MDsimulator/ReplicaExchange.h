@@ -0,0 +1,57 @@
+#ifndef _replicaexchange_h
+#define _replicaexchange_h
+
+#include <fstream>
+#include "Atoms.h"
+#include "Ensemble.h"
+#include "Analysis.h"
+#include "Random.h"
+#include "dataType.h"
+
+// Parallel tempering (replica exchange, Sugita and Okamoto, Chem. Phys. Lett.
+// 314, 141). The replicas of the system run at a geometric ladder of
+// temperatures between T and T_max, each on its own thread with a share of
+// the OpenMP threads. After every exchange interval the neighbouring
+// temperatures (alternately the even and the odd pairs) attempt a swap, which
+// is accepted with the probability min(1, exp[(1/T_k - 1/T_k+1)(U_k - U_k+1)]).
+// An accepted swap exchanges the temperatures and the thermostats of the two
+// replicas and their pointers in the ladder, so no configuration is copied.
+class ReplicaExchange
+{
+public:
+	// Constructor creates and sets up every replica from the input
+	ReplicaExchange(dataT* data);
+	// Destructor deletes the replicas
+	~ReplicaExchange();
+
+	// Run all the steps, and log the potential energy at every temperature
+	// after each exchange
+	void run(ofstream& logger);
+	// Print the mean potential energy of the production at every temperature,
+	// and the acceptance ratio of every pair of neighbouring temperatures
+	void printSummary();
+
+private:
+	int M;						// Number of replicas
+	int interval;				// Steps between the exchanges
+	int threadsPerReplica;		// OpenMP threads of every replica
+	vector<dataT> data;			// The input of every replica
+	vector<Atoms*> atoms;		// The replicas in the order of creation
+	vector<NVT*> ens;
+	vector<double> U;			// Potential energy of every replica (reduced)
+	vector<double> T;			// The temperature ladder (reduced)
+	vector<int> ladder;			// The replica at every temperature
+	vector<long long> attempts;	// Attempted swaps of every pair
+	vector<long long> accepted;	// Accepted swaps of every pair
+	// The potential energy of the production at every temperature [eV]
+	vector<AnalysisTools::BlockAverage> Uav;
+	CounterRNG rng;
+
+	// Advance replica r from step 'first' by n steps at temperature k
+	void advance(int r, int first, int n, int k);
+	// Attempt the swaps of the pairs, which start at an even or odd
+	// temperature depending on the number of the exchange
+	void exchange(long long number);
+};
+
+#endif // !_replicaexchange_h
@@ -0,0 +1,266 @@
+#include "Setup.h"
+#include <iostream>
+#include <ctime>
+#include <algorithm>
+#include "CellBuilder.h"
+#include "CoordinateReader.h"
+#include "VelocityManager.h"
+#include "Minimizer.h"
+#include "Parser.h"
+
+// Function for population the data container from the input file
+void GetParameters(dataT *d, string file) {
+	// Parse the input file
+	Parser ps(file, d);
+
+	// The first atom type defines the units, if the types are given
+	if (d->masses.size() > 0) d->mass = d->masses[0];
+	if (d->epsKs.size() > 0) d->epsK = d->epsKs[0];
+	if (d->sigmas.size() > 0) d->sigma = d->sigmas[0];
+
+	// Calculate reduced parameters
+	double mu = (d->mass * d->mass) / (2 * d->mass) 
+		/ (AVOGADRO * 1000.0);
+
+	d->dt_s = pow(d->epsK * kB / (mu * pow(d->sigma, 2)), 0.5) 
+		* 1.0e-12 * 1.0e+10 * d->dt_ps;
+
+	// The reduced temperature is given by T_s = T * kB / eps = T / epsK
+	d->T_s = d->T / d->epsK;
+
+	d->eps = d->epsK * kBeV;
+
+	// The reduced relaxation can be determined from the factor for dt_s
+	d->tau_s_s = d->tau_s * d->dt_s / d->dt_ps;
+	d->tau_p_s = d->tau_p * d->dt_s / d->dt_ps;
+
+	// The reduced pressure is P_s = P * sigma^3 / eps, and the compressibility
+	// is the inverse of a pressure
+	double pressureUnit = d->epsK * kB / pow(d->sigma * 1e-10, 3.0);
+	d->P_s = d->P / pressureUnit;
+	d->kappa_s = d->kappa * pressureUnit;
+
+	// Reduced bond distances and force constants
+	double redFact = d->sigma * d->sigma / d->eps;
+	for (double &k : d->ks) {
+		k *= redFact;
+	}
+
+	for (double &r : d->r_eqs) {
+		r /= d->sigma;
+	}
+
+	// Reduced charges, so the Coulomb energy is q_i * q_j / r
+	double chargeFact = pow(COULOMB / (d->sigma * d->eps), 0.5);
+	for (double &q : d->charges) {
+		q *= chargeFact;
+	}
+
+	SetupTypes(d);
+}
+
+// Function for checking the atom types and reducing their parameters by the
+// reference values. Parameters that are not given per type are the same for
+// all the types.
+void SetupTypes(dataT* d) {
+	int nTypes = 1;
+	for (int t : d->types) {
+		nTypes = max(nTypes, t + 1);
+	}
+	nTypes = max(nTypes, static_cast<int>(d->typeNames.size()));
+	nTypes = max(nTypes, static_cast<int>(d->masses.size()));
+	nTypes = max(nTypes, static_cast<int>(d->epsKs.size()));
+	nTypes = max(nTypes, static_cast<int>(d->sigmas.size()));
+
+	if (d->types.size() == 0) {
+		d->types = vector<int>(d->apm, 0);
+	} else if (d->types.size() != static_cast<size_t>(d->apm)) {
+		cout << "Expected " << d->apm << " atom types, but found "
+			<< d->types.size() << endl;
+		exit(-1);
+	}
+	vector<vector<double>*> perType = { &d->masses, &d->epsKs, &d->sigmas };
+	vector<double> reference = { d->mass, d->epsK, d->sigma };
+	vector<vector<double>*> reduced = { &d->masses_s, &d->eps_s,
+		&d->sigmas_s };
+	for (int p = 0; p < 3; p++) {
+		if (perType[p]->size() == 0) {
+			*perType[p] = vector<double>(nTypes, reference[p]);
+		} else if (perType[p]->size() != static_cast<size_t>(nTypes)) {
+			cout << "Expected a mass, epsilon and sigma for each of the "
+				<< nTypes << " atom types" << endl;
+			exit(-1);
+		}
+		reduced[p]->resize(nTypes);
+		for (int t = 0; t < nTypes; t++) {
+			(*reduced[p])[t] = (*perType[p])[t] / reference[p];
+		}
+	}
+
+	if (d->ljPairs.size() % 4 != 0) {
+		cout << "LJ pairs must be given as (type, type, epsK, sigma)" << endl;
+		exit(-1);
+	}
+	d->ljPairs_s = d->ljPairs;
+	for (size_t p = 0; p < d->ljPairs_s.size(); p += 4) {
+		d->ljPairs_s[p + 2] /= d->epsK;
+		d->ljPairs_s[p + 3] /= d->sigma;
+	}
+}
+
+// Function for creating the initial configuration of the system
+void InitializeSetup(Atoms* a, dataT* d) {
+	if (d->pos.size() != d->apm * 3.0) {
+		string em = "Not enough positions were given! Found: "
+			+ to_string(d->pos.size()) + " , but expected: "
+			+ to_string(d->apm * (__int64)3);
+		cout << em << endl;
+		exit(-1);
+	}
+
+	for (int i = 0; i < d->apm; i++) {
+		a->setPos(i, vector<double>{
+			d->pos[(__int64)3 * i] / d->sigma,
+			d->pos[(__int64)3 * i + (__int64)1] / d->sigma,
+			d->pos[(__int64)3 * i + (__int64)2] / d->sigma
+		});
+	}
+
+	if (d->bonds.size() % 2 == 1) {
+		cout << "Bonds not given as pairs" << endl;
+		exit(-1);
+	}
+	a->setBonds(d->bonds, d->ks, d->r_eqs);
+
+	if (d->charges.size() != 0
+		&& d->charges.size() != static_cast<size_t>(d->apm)) {
+		cout << "Expected " << d->apm << " partial charges, but found "
+			<< d->charges.size() << endl;
+		exit(-1);
+	}
+	a->setCharges(d->charges);
+	a->setTypes(d->types, d->masses_s);
+
+	// Calculate number density in m^{-3} from the mass of a molecule
+	double molMass = a->getTotalMass() * d->mass;
+	double rhoN = AVOGADRO / molMass * d->rho * 1e-24 * pow(d->sigma, 3);
+	d->rhoN = rhoN;
+	// Use a pseudo random seed, unless one is given, and report it, so the
+	// run can be reproduced
+	if (d->seed < 0) {
+		d->seed = static_cast<int>(time(0) & 0x7fffffff);
+	}
+	int nCells;
+	bool cubic = d->LT == LatticeType::AUTO
+		&& CellBuilder::getCubicLattice(d->nMolecules, &nCells) != 0;
+	if (d->config.compare("") != 0) {
+		// Load the configuration, which replaces the lattice
+		loadConfiguration(a, d);
+	} else if (d->box.size() > 0) {
+		// Build a cubic lattice with the volume of the box, and deform it,
+		// or build the lattice in the box directly
+		boxT box = getInputBox(d);
+		if (cubic) {
+			CellBuilder::buildCell(a, d->nMolecules,
+				d->nMolecules / box.getVolume());
+			CellBuilder::fitToBox(a, box);
+		} else {
+			CellBuilder::buildLattice(a, d->nMolecules, box, d->LT, d->seed);
+		}
+		d->rhoN = a->getNM() / box.getVolume();
+		printDensity(a, d);
+	} else if (cubic || d->LT == LatticeType::AUTO) {
+		// Build the cell (with a static call)
+		CellBuilder::buildCell(a, d->nMolecules, rhoN);
+	} else {
+		double L = pow(d->nMolecules / rhoN, 1.0 / 3.0);
+		boxT box;
+		box.ctor(L, L, L);
+		CellBuilder::buildLattice(a, d->nMolecules, box, d->LT, d->seed);
+	}
+	cout << "seed = " << d->seed << endl;
+	// Relax the structure, so the first steps don't see large forces
+	if (d->MT != MinType::NONE) {
+		Minimizer::minimize(a, d);
+	}
+	// Initialize the velocities
+	VelocityManager::initializeVelocities(a, d->T_s, d->seed);
+}
+
+
+// Read the positions from the configuration file. The number of molecules
+// follows from the file, and so does the density, if the file or the input
+// has a box.
+void loadConfiguration(Atoms* a, dataT* d) {
+	double fileBox;
+	vector<string> elements;
+	vector<double> r = CoordinateReader::read(d->config, &fileBox, &elements);
+	int nAtoms = static_cast<int>(r.size() / 3);
+	if (nAtoms % d->apm != 0) {
+		cout << "The configuration has " << nAtoms << " atoms, which is not "
+			<< "a multiple of " << d->apm << " atoms per molecule" << endl;
+		exit(-1);
+	}
+	d->nMolecules = nAtoms / d->apm;
+	cout << "Loaded " << d->nMolecules << " molecules from " << d->config
+		<< endl;
+	for (double& x : r) {
+		x /= d->sigma;
+	}
+	a->resize(d->nMolecules);
+	// The elements in the file give the atom types, if the types are named
+	if (d->typeNames.size() > 0 && elements.size() > 0) {
+		for (int i = 0; i < nAtoms; i++) {
+			int t = static_cast<int>(find(d->typeNames.begin(),
+				d->typeNames.end(), elements[i]) - d->typeNames.begin());
+			if (t == static_cast<int>(d->typeNames.size())) {
+				cout << "The element '" << elements[i] << "' of atom " << i
+					<< " is not one of the type names" << endl;
+				exit(-1);
+			}
+			a->setType(i, t);
+		}
+	}
+	// The box of the input takes precedence over the box of the file
+	if (d->box.size() > 0) {
+		a->setBox(getInputBox(d));
+	} else if (fileBox > 0.0) {
+		a->setCellLength(fileBox / d->sigma);
+	} else {
+		a->setCellLength(pow(d->nMolecules / d->rhoN, (1.0 / 3.0)));
+	}
+	if (d->box.size() > 0 || fileBox > 0.0) {
+		d->rhoN = d->nMolecules / a->getBox().getVolume();
+		printDensity(a, d);
+	}
+	a->setPositions(r);
+	a->center();
+}
+
+// The box is given as the lengths of the cell vectors, optionally followed by
+// the tilts xy, xz and yz, all in Angstrom
+boxT getInputBox(dataT* d) {
+	if (d->box.size() != 3 && d->box.size() != 6) {
+		cout << "The box must be given as (lx, ly, lz) or "
+			<< "(lx, ly, lz, xy, xz, yz)" << endl;
+		exit(-1);
+	}
+	vector<double> b = d->box;
+	b.resize(6, 0.0);
+	if (abs(b[3]) > 0.5 * b[0] || abs(b[4]) > 0.5 * b[0]
+		|| abs(b[5]) > 0.5 * b[1]) {
+		cout << "The box tilts can be at most half the box length" << endl;
+		exit(-1);
+	}
+	boxT box;
+	box.ctor(b[0] / d->sigma, b[1] / d->sigma, b[2] / d->sigma,
+		b[3] / d->sigma, b[4] / d->sigma, b[5] / d->sigma);
+	return box;
+}
+
+// Print the mass density of the atoms in the box
+void printDensity(Atoms* a, dataT* d) {
+	cout << "rho = " << a->getTotalMass() * d->mass / AVOGADRO
+		/ (a->getBox().getVolume() * pow(d->sigma, 3.0)) * 1e24
+		<< " g/cm^3 from the box" << endl;
+}
@@ -0,0 +1,30 @@
+#ifndef _setup_h
+#define _setup_h
+
+#include <string>
+#include "Atoms.h"
+#include "dataType.h"
+
+// Physical constants for the conversion to and from the reduced units
+const double kB = 1.38064852e-23;  // Boltzmann's constant
+const double kBeV = 8.6173303360e-5;  //Boltzmann's constant in eV/K
+const double AVOGADRO = 6.022045e+23;  // Avogadro's constant
+const double COULOMB = 14.3996454;  // e^2 / (4 pi eps_0) in eV*Angstrom
+
+// The setup of a simulation from an input file, which is shared by the
+// executable and the library
+
+// Populate the data container from the input file, and reduce the units
+void GetParameters(dataT* data, string file);
+// Check the atom types and reduce their parameters
+void SetupTypes(dataT* data);
+// Create the initial configuration and velocities of the system
+void InitializeSetup(Atoms* atoms, dataT* data);
+// Read the initial positions from the configuration file of the input
+void loadConfiguration(Atoms* atoms, dataT* data);
+// Get the periodic cell given in the input (reduced)
+boxT getInputBox(dataT* data);
+// Print the mass density of the atoms in the box
+void printDensity(Atoms* atoms, dataT* data);
+
+#endif // !_setup_h
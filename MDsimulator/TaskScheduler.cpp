@@ -0,0 +1,123 @@
+#include "TaskScheduler.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+TaskScheduler::TaskScheduler(int nWorkers, int threads)
+	: queues(nWorkers > 0 ? nWorkers : 0)
+{
+	threadsPerWorker = threads > 0 ? threads : 1;
+	for (int w = 0; w < nWorkers; w++) {
+		workers.push_back(thread(&TaskScheduler::work, this, w));
+	}
+}
+
+TaskScheduler::~TaskScheduler() {
+	waitAll();
+	{
+		unique_lock<mutex> l(lock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (thread& w : workers) {
+		w.join();
+	}
+}
+
+// A task is queued right away, if all its dependencies have finished, and
+// otherwise registered as a successor of the unfinished ones
+int TaskScheduler::submit(function<void()> work, const vector<int>& after) {
+	if (workers.size() == 0) {
+		work();
+		return nextId++;
+	}
+	unique_lock<mutex> l(lock);
+	int id = nextId++;
+	taskT& task = tasks[id];
+	task.work = work;
+	for (int a : after) {
+		auto it = tasks.find(a);
+		if (a >= 0 && it != tasks.end()) {
+			it->second.successors.push_back(id);
+			task.waitingFor++;
+		}
+	}
+	if (task.waitingFor == 0) {
+		queues[nextQueue].push_back(id);
+		nextQueue = (nextQueue + 1) % static_cast<int>(queues.size());
+		wake.notify_one();
+	}
+	return id;
+}
+
+void TaskScheduler::waitPending(int n) {
+	unique_lock<mutex> l(lock);
+	while (static_cast<int>(tasks.size()) > n) {
+		finished.wait(l);
+	}
+}
+
+void TaskScheduler::waitAll() {
+	waitPending(0);
+}
+
+int TaskScheduler::getWorkers() {
+	return static_cast<int>(workers.size());
+}
+
+// The lock is released while the task runs. A new thread starts with the
+// default number of OpenMP threads, which is all of the machine, so the
+// worker's own number is set first.
+void TaskScheduler::work(int w) {
+#ifdef _OPENMP
+	omp_set_num_threads(threadsPerWorker);
+#endif
+	unique_lock<mutex> l(lock);
+	while (true) {
+		int id;
+		if (takeTask(w, &id)) {
+			function<void()> f = tasks[id].work;
+			l.unlock();
+			f();
+			l.lock();
+			finish(id, w);
+		} else if (stopping) {
+			return;
+		} else {
+			wake.wait(l);
+		}
+	}
+}
+
+// The newest task of the own queue is the most likely to have its data in the
+// cache, while the oldest task of another queue is stolen
+bool TaskScheduler::takeTask(int w, int* id) {
+	if (!queues[w].empty()) {
+		*id = queues[w].back();
+		queues[w].pop_back();
+		return true;
+	}
+	int n = static_cast<int>(queues.size());
+	for (int k = 1; k < n; k++) {
+		deque<int>& victim = queues[(w + k) % n];
+		if (!victim.empty()) {
+			*id = victim.front();
+			victim.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void TaskScheduler::finish(int id, int w) {
+	for (int s : tasks[id].successors) {
+		taskT& successor = tasks[s];
+		successor.waitingFor--;
+		if (successor.waitingFor == 0) {
+			queues[w].push_back(s);
+			wake.notify_one();
+		}
+	}
+	tasks.erase(id);
+	finished.notify_all();
+}
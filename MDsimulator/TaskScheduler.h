@@ -0,0 +1,70 @@
+#ifndef _taskscheduler_h
+#define _taskscheduler_h
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+
+// A pool of worker threads, which run tasks as soon as the tasks they depend
+// on have finished. Every worker has its own queue of ready tasks: the tasks
+// a worker makes ready are added to the back of its own queue, and it takes
+// its next task from the back too, while an idle worker steals from the
+// front of the other queues. Without workers every task runs immediately on
+// the thread that submits it, which keeps the submission order. The OpenMP
+// regions of the tasks on a worker run with the worker's own number of
+// threads, since a worker doesn't follow omp_set_num_threads() of the main
+// thread.
+class TaskScheduler
+{
+public:
+	// Constructor starts the given number of worker threads, which run the
+	// OpenMP regions of their tasks with threadsPerWorker threads each
+	TaskScheduler(int nWorkers, int threadsPerWorker = 1);
+	// Destructor waits for all the tasks, and stops the workers
+	virtual ~TaskScheduler();
+
+	// Submit a task, which runs when all the tasks in 'after' have finished.
+	// Returns the id of the task for later dependencies. Negative ids and the
+	// ids of finished tasks are ignored.
+	int submit(function<void()> work, const vector<int>& after);
+	// Wait until at most n of the submitted tasks are unfinished
+	void waitPending(int n);
+	// Wait until all the submitted tasks have finished
+	void waitAll();
+	// Get the number of worker threads
+	int getWorkers();
+
+private:
+	// A task with the dependencies, that are still missing
+	struct taskT {
+		function<void()> work;
+		int waitingFor = 0;			// Unfinished tasks, this one depends on
+		vector<int> successors;		// Tasks, which depend on this one
+	};
+
+	mutex lock;						// Guards the tasks and the queues
+	condition_variable wake;		// New ready tasks, or the workers stop
+	condition_variable finished;	// A task has finished
+	unordered_map<int, taskT> tasks;	// The unfinished tasks by their id
+	vector<deque<int>> queues;		// The ready tasks of every worker
+	vector<thread> workers;
+	int threadsPerWorker;			// OpenMP threads of a worker's tasks
+	int nextId = 0;					// The id of the next task
+	int nextQueue = 0;				// The queue of the next submitted task
+	bool stopping = false;			// Are the workers told to stop?
+
+	// The loop of worker w, which runs tasks until it's stopped
+	void work(int w);
+	// Take a task from the own queue, or steal one from another queue
+	bool takeTask(int w, int* id);
+	// Remove a finished task, and queue the successors, which became ready
+	void finish(int id, int w);
+};
+
+#endif // !_taskscheduler_h
@@ -0,0 +1,135 @@
+#include "Trajectory.h"
+#include <iostream>
+#include <cstring>
+
+namespace {
+	const char trajTag[8] = "MDTRAJ1";
+	const size_t headerBytes = 64;
+	// The time and the box matrix before the positions of a frame
+	const int frameHeader = 10;
+
+	template <typename T>
+	T load(const char* p) {
+		T v;
+		memcpy(&v, p, sizeof(T));
+		return v;
+	}
+
+	template <typename T>
+	void store(ofstream& out, T v) {
+		out.write(reinterpret_cast<const char*>(&v), sizeof(T));
+	}
+}
+
+TrajectoryWriter::TrajectoryWriter(string filename, int n, int apm,
+	double sigma)
+	: out(filename, ios::binary | ios::trunc)
+{
+	if (!out.is_open()) {
+		cout << "Couldn't open the trajectory file '" << filename << "'"
+			<< endl;
+		exit(-1);
+	}
+	nAtoms = n;
+	out.write(trajTag, sizeof(trajTag));
+	store<uint64_t>(out, nAtoms);
+	store<uint64_t>(out, 0);
+	store<uint32_t>(out, apm);
+	store<uint32_t>(out, 0);
+	store<double>(out, sigma);
+	size_t padding = headerBytes - static_cast<size_t>(out.tellp());
+	out.write(string(padding, '\0').data(), padding);
+}
+
+TrajectoryWriter::~TrajectoryWriter() {
+	close();
+}
+
+void TrajectoryWriter::addFrame(double t, const boxT& box,
+	const vector<double>& r) {
+	double head[frameHeader];
+	head[0] = t;
+	for (int a = 0; a < 3; a++) {
+		for (int b = 0; b < 3; b++) {
+			head[1 + 3 * a + b] = box.h[a][b];
+		}
+	}
+	out.write(reinterpret_cast<const char*>(head), sizeof(head));
+	out.write(reinterpret_cast<const char*>(r.data()),
+		sizeof(double) * 3 * (size_t)nAtoms);
+	frames++;
+}
+
+void TrajectoryWriter::close() {
+	if (!out.is_open()) return;
+	out.seekp(sizeof(trajTag) + sizeof(uint64_t));
+	store<uint64_t>(out, frames);
+	out.close();
+}
+
+
+// The frames are read in random places, so the file isn't read ahead
+TrajectoryReader::TrajectoryReader(string filename)
+	: file(filename, false)
+{
+	const char* p = file.data;
+	if (file.size < headerBytes || memcmp(p, trajTag, sizeof(trajTag)) != 0) {
+		cout << "'" << filename << "' is not a trajectory file" << endl;
+		exit(-1);
+	}
+	nAtoms = static_cast<int>(load<uint64_t>(p + 8));
+	uint64_t written = load<uint64_t>(p + 16);
+	apm = static_cast<int>(load<uint32_t>(p + 24));
+	sigma = load<double>(p + 32);
+	frameBytes = sizeof(double) * (frameHeader + 3 * (size_t)nAtoms);
+	// The complete frames in the file, which are all of them, if the
+	// trajectory was closed
+	uint64_t complete = (file.size - headerBytes) / frameBytes;
+	frames = static_cast<int>(written > 0 ? min(written, complete) : complete);
+	if (written == 0 && complete > 0) {
+		cout << "'" << filename << "' wasn't closed, so only its " << frames
+			<< " complete frames are read" << endl;
+	}
+}
+
+int TrajectoryReader::getAtoms() {
+	return nAtoms;
+}
+
+int TrajectoryReader::getApm() {
+	return apm;
+}
+
+double TrajectoryReader::getSigma() {
+	return sigma;
+}
+
+int TrajectoryReader::getFrames() {
+	return frames;
+}
+
+const double* TrajectoryReader::getFrame(int k, double* t, boxT* box) {
+	const double* f = reinterpret_cast<const double*>(
+		file.data + headerBytes + frameBytes * k);
+	*t = f[0];
+	if (box != nullptr) {
+		box->ctor(f[1], f[5], f[9], f[2], f[3], f[6]);
+	}
+	return f + frameHeader;
+}
+
+// The times increase with the frames, so the frame is found by bisection
+int TrajectoryReader::findFrame(double t) {
+	int lo = 0, hi = frames;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		double tMid;
+		getFrame(mid, &tMid, nullptr);
+		if (tMid < t) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
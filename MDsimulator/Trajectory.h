@@ -0,0 +1,74 @@
+#ifndef _trajectory_h
+#define _trajectory_h
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdint>
+#include "boxType.h"
+#include "MappedFile.h"
+
+using namespace std;
+
+// A binary trajectory of the production, with frames of a fixed size, so any
+// frame is found at a known offset without reading the ones before it. The
+// positions are reduced, unwrapped (as the Atoms keep them), and in the
+// original order of the atoms, so the frames can be compared atom by atom
+// for the mean square displacement.
+//
+// The layout (native byte order) is:
+//	header	an 8 byte "MDTRAJ1" tag, the number of atoms and of frames (64 bit
+//			integers), the atoms per molecule (32 bit integer, and 4 bytes of
+//			padding) and sigma in Angstrom (double), padded to 64 bytes.
+//	frames	the time [ps], the 9 elements of the box matrix row by row and x,
+//			y, z of every atom (doubles).
+// The number of frames is written, when the trajectory is closed. If a run
+// stops before, the reader finds the complete frames from the size.
+class TrajectoryWriter
+{
+public:
+	// Create the file for frames of n atoms
+	TrajectoryWriter(string filename, int nAtoms, int apm, double sigma);
+	// Destructor closes the trajectory
+	virtual ~TrajectoryWriter();
+
+	// Add a frame of the positions (x, y, z of the atoms after each other)
+	void addFrame(double t, const boxT& box, const vector<double>& r);
+	// Write the number of frames
+	void close();
+
+private:
+	ofstream out;
+	int nAtoms;
+	uint64_t frames = 0;
+};
+
+// Reader of a trajectory, which maps the file, so the frames are read in any
+// order, and by many threads at the same time
+class TrajectoryReader
+{
+public:
+	// Map the file, and read the header
+	TrajectoryReader(string filename);
+
+	int getAtoms();			// Get the number of atoms of a frame
+	int getApm();			// Get the number of atoms per molecule
+	double getSigma();		// Get the length unit [Angstrom]
+	int getFrames();		// Get the number of frames
+
+	// Get the positions of frame k (x, y, z of the atoms after each other),
+	// which are in the mapping, and its time and box
+	const double* getFrame(int k, double* t, boxT* box);
+	// Get the first frame at or after time t
+	int findFrame(double t);
+
+private:
+	MappedFile file;
+	int nAtoms = 0;
+	int apm = 1;
+	double sigma = 1.0;
+	int frames = 0;
+	size_t frameBytes = 0;
+};
+
+#endif // !_trajectory_h
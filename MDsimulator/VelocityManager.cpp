@@ -1,31 +1,16 @@
 #define _USE_MATH_DEFINES
 #include "VelocityManager.h"
-#include <random>
-#include "time.h"
-
-// A struct needed to be able to use the class in a static way, which can
-// produce a random real number in the range [0, 1].
-struct uniform_double {
-	double random = generate();
-	static double generate() {
-		static default_random_engine e{
-			static_cast<long unsigned int>(time(0))  // Pseudo random seed
-		};
-		static uniform_real_distribution<double> d{0, 1};
-		return d(e);
-	}
-};
 
 // The static initializeVelocities() function generates the velocities from
 // a gaussian distribution and makes sure that the center of velocity is zero.
-void VelocityManager::initializeVelocities(Atoms* atoms, double T) {
-	vector<double> v = { 0.0, 0.0, 0.0 };
-	// Loop through all velocities, and generate them
+void VelocityManager::initializeVelocities(Atoms* atoms, double T,
+	uint64_t seed) {
+	CounterRNG rng(seed);
+	// Loop through all velocities, and generate them. Every atom has its own
+	// random numbers, so the loop can be split over the threads.
+	#pragma omp parallel for schedule(static)
 	for (int i = 0; i < atoms->getSize(); i++) {
-		for (int j = 0; j < 3; j++) {
-			v[j] = gaussianN(atoms->getMass(), T);
-		}
-		atoms->setVel(i, v);
+		atoms->setVel(i, gaussianV(&rng, i, atoms->getMass(i), T));
 	}
 	// Center the velocity
 	atoms->centerVel();
@@ -45,15 +30,15 @@ void VelocityManager::initializeVelocities(Atoms* atoms, double T) {
 	}
 }
 
-// The gaussianN() function calculates a number from a gaussian distribution
-// from a uniformly distributed random number in [0, 1].
-double VelocityManager::gaussianN(double m, double T) {
+// The gaussianV() function draws the three cartesian components of a velocity
+// from a gaussian distribution. The counter of the draw is the atom index at
+// step zero in the velocity initialization stream.
+vector<double> VelocityManager::gaussianV(CounterRNG* rng, int i, double m,
+	double T) {
 	// The gaussian variance is calculated
-	double variance = T;  // * m[i];
-	// The two polar coordinates for a gaussian distribution
-	uniform_double ra = uniform_double();
-	double phi = 2 * M_PI * ra.random;
-	double s = -variance * log(1.0 - ra.random);
-	// Return the cartesian gaussian
-	return pow(2 * s, 0.5) * cos(phi);
+	double variance = T / m;
+	double g[4];
+	rng->gaussian(i, 0, CounterRNG::VELOCITY_INIT, g);
+	double s = pow(variance, 0.5);
+	return { s * g[0], s * g[1], s * g[2] };
 }
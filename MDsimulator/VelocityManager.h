@@ -2,6 +2,7 @@
 #define _velocitymanager_h
 
 #include "Atoms.h"
+#include "Random.h"
 
 // Static class for initializing the velocities to a proper gaussian distibution
 // and make sure that it corresponds to the given temperature.
@@ -9,13 +10,16 @@ class VelocityManager {
 public:
 	// Static function for initializing the velocities of an Atoms object to
 	// correspond to a proper gaussian distribution, which has a kinetic energy
-	// in accordance to the temperature given.
-	static void initializeVelocities(Atoms* atoms, double temperature);
+	// in accordance to the temperature given. The same seed always gives the
+	// same velocities, regardless of the number of threads.
+	static void initializeVelocities(Atoms* atoms, double temperature,
+		uint64_t seed);
 
 private:
-	// Private helper function for generating a gaussian number from a uniform
-	// distribution in [0, 1].
-	static double gaussianN(double mass, double temperature);
+	// Private helper function for generating a gaussian velocity vector for
+	// atom i from the counter-based random number generator.
+	static vector<double> gaussianV(CounterRNG* rng, int i, double mass,
+		double temperature);
 };
 
 #endif // !_velocitymanager_h
@@ -0,0 +1,118 @@
+#ifndef _boxtype_h
+#define _boxtype_h
+#include "math.h"
+
+// The periodic cell as a box matrix h, whose columns are the cell vectors
+//	a = (lx, 0, 0), b = (xy, ly, 0), c = (xz, yz, lz)
+// so a position is r = h s for the fractional coordinates s in [0, 1). The
+// inverse is precalculated, so the minimum image is found by multiplications.
+// An orthorhombic box has no tilts, and the minimum image reduces to one
+// multiplication and rounding per axis.
+struct boxT {
+	double h[3][3] = {};	// The box matrix (upper triangular)
+	double hInv[3][3] = {};	// The inverse of the box matrix
+	bool orthorhombic = true;
+
+	// Fake constructor. The tilts must be at most half the length of the
+	// vector they tilt along, so the minimum image is the nearest image.
+	void ctor(double lx, double ly, double lz,
+		double xy = 0.0, double xz = 0.0, double yz = 0.0) {
+		for (int a = 0; a < 3; a++) {
+			for (int b = 0; b < 3; b++) {
+				h[a][b] = 0.0;
+				hInv[a][b] = 0.0;
+			}
+		}
+		h[0][0] = lx;
+		h[1][1] = ly;
+		h[2][2] = lz;
+		h[0][1] = xy;
+		h[0][2] = xz;
+		h[1][2] = yz;
+		orthorhombic = xy == 0.0 && xz == 0.0 && yz == 0.0;
+		if (lx <= 0.0 || ly <= 0.0 || lz <= 0.0) return;
+		// The inverse of an upper triangular matrix is upper triangular
+		hInv[0][0] = 1.0 / lx;
+		hInv[1][1] = 1.0 / ly;
+		hInv[2][2] = 1.0 / lz;
+		hInv[0][1] = -xy / (lx * ly);
+		hInv[1][2] = -yz / (ly * lz);
+		hInv[0][2] = (xy * yz - ly * xz) / (lx * ly * lz);
+	}
+
+	// Get the volume of the box
+	double getVolume() const {
+		return h[0][0] * h[1][1] * h[2][2];
+	}
+
+	// Get the distance between the two faces of the box, which are not
+	// spanned by cell vector k. Spheres with a diameter up to the smallest
+	// width fit in the box.
+	double getWidth(int k) const {
+		double c[3];  // The cross product of the two other cell vectors
+		int a = (k + 1) % 3, b = (k + 2) % 3;
+		for (int i = 0; i < 3; i++) {
+			int j = (i + 1) % 3, l = (i + 2) % 3;
+			c[i] = h[j][a] * h[l][b] - h[l][a] * h[j][b];
+		}
+		return getVolume() / sqrt(c[0] * c[0] + c[1] * c[1] + c[2] * c[2]);
+	}
+
+	double getMinimumWidth() const {
+		return fmin(getWidth(0), fmin(getWidth(1), getWidth(2)));
+	}
+
+	// Get the length of cell vector k
+	double getLength(int k) const {
+		return sqrt(h[0][k] * h[0][k] + h[1][k] * h[1][k]
+			+ h[2][k] * h[2][k]);
+	}
+
+	// s = h^-1 r
+	void toFractional(const double* r, double* s) const {
+		s[0] = hInv[0][0] * r[0] + hInv[0][1] * r[1] + hInv[0][2] * r[2];
+		s[1] = hInv[1][1] * r[1] + hInv[1][2] * r[2];
+		s[2] = hInv[2][2] * r[2];
+	}
+
+	// r = h s
+	void toCartesian(const double* s, double* r) const {
+		r[0] = h[0][0] * s[0] + h[0][1] * s[1] + h[0][2] * s[2];
+		r[1] = h[1][1] * s[1] + h[1][2] * s[2];
+		r[2] = h[2][2] * s[2];
+	}
+
+	// Replace the separation d by its nearest periodic image
+	void minimumImage(double* d) const {
+		if (orthorhombic) {
+			for (int k = 0; k < 3; k++) {
+				d[k] -= h[k][k] * round(d[k] * hInv[k][k]);
+			}
+			return;
+		}
+		double s[3];
+		toFractional(d, s);
+		for (int k = 0; k < 3; k++) {
+			s[k] -= round(s[k]);
+		}
+		toCartesian(s, d);
+	}
+
+	// Scale all the cell vectors by mu
+	void scale(double mu) {
+		ctor(mu * h[0][0], mu * h[1][1], mu * h[2][2],
+			mu * h[0][1], mu * h[0][2], mu * h[1][2]);
+	}
+
+	// Override for the 'equals' operator
+	bool operator ==(const boxT& other) const {
+		for (int a = 0; a < 3; a++) {
+			for (int b = 0; b < 3; b++) {
+				if (h[a][b] != other.h[a][b]) return false;
+			}
+		}
+		return true;
+	}
+};
+
+#endif // !_boxtype_h
@@ -1,15 +1,45 @@
 #ifndef _datatype_h
 #define _datatype_h
 
+#include <vector>
+#include <string>
+
 enum class InteType;
 enum class PotType;
 enum class EnsType;
+enum class MinType;
+enum class LatticeType;
 
 // Structure class to contain the parameters of the MD simulation
 struct dataT {
 	int nMolecules = 1;			// Number of atoms
 	int apm = 1;			// Atoms per molecules
 	int simSteps = 1;		// Number of MD steps
+	int eqSteps = 10000;	// Number of equilibration steps before sampling
+	int eqAuto = 0;			// Detect the end of the equilibration (0 = off)
+	double targetError = 0;	// Relative error of U that ends the production (0 = off)
+	double targetErrorZ = 0;	// Error of Z that ends the production (0 = off)
+	int logPressure = 0;	// Log the pressure tensor every step (0 = off)
+	int reorderInterval = 0;	// Steps between spatial reordering (0 = off)
+	int seed = -1;			// Random seed (negative = seed from the clock)
+	int analysisThreads = 0;	// Worker threads for the analysis (0 = serial)
+	int hugePages = 0;		// Transparent huge pages for the arrays (0 = off)
+	int sqStride = 0;		// Production steps between S(k) samples (0 = off)
+	double sqKMax = 10.0;	// Largest wave number of S(k) (reduced)
+	int nReplicas = 1;		// Replicas for parallel tempering (1 = off)
+	double T_max = 0.0;		// Highest temperature of the replicas [Kelvin]
+	int exchangeInterval = 100;	// Steps between the replica exchanges
+	int monteCarlo = 0;		// Metropolis Monte Carlo sweeps instead of MD (0 = off)
+	double mcDisplacement = 0.3;	// Largest trial displacement [Angstrom]
+	double mcVolume = 0.01;	// Largest trial change of ln V
+	int mcCheckerboard = 0;	// Parallel checkerboard sweeps (0 = serial)
+	int widomStride = 0;	// Production steps between Widom frames (0 = off)
+	int widomInsertions = 1000;	// Ghost insertions per Widom frame
+	int perfCounters = 0;	// Hardware counters of the phases (0 = off)
+	std::string obsFile = "";	// Binary store of the observables ("" = off)
+	int textLog = 1;		// Write the observables to sim.out (0 = off)
+	int trajStride = 0;		// Production steps between frames (0 = off)
+	std::string trajFile = "traj.bin";	// Binary trajectory of the production
 	double T = 273.15;		// Temperature [Kelvin]
 	double rho = 1.0;		// Density [g/cm^3]
 	double mass = 1.0;		// Mass per atom [amu]
@@ -19,10 +49,26 @@ struct dataT {
 	double sigma = 2.5;		// sigma [Angstrom]
 	double r_co = 0.0;		// Potential cut_off [Angstrom]
 	double tau_s = 0.0;		// Relaxation time for heat bath [ps]
+	double tau_p = 0.0;		// Relaxation time for the barostat [ps]
+	double kappa = 4.5e-10;	// Isothermal compressibility [1/Pa]
 	std::vector<double> pos{};		// The initial positions for the atoms
+	std::string config = "";		// File with the initial configuration
+	std::vector<double> box{};		// Cell lengths and tilts [Angstrom]
 	std::vector<int> bonds{};		// The bonding pairs
 	std::vector<double> ks{};		// The bonding force constants [eV/Angstrom^2]
 	std::vector<double> r_eqs{};	// The equilibrium distances [Angstrom]
+	std::vector<double> charges{};	// The partial charges of a molecule [e]
+	std::vector<int> types{};		// The atom types of a molecule
+	std::vector<std::string> typeNames{};	// The element of each type
+	std::vector<double> masses{};	// The mass of each type [amu]
+	std::vector<double> epsKs{};	// The epsilon/k_B of each type [Kelvin]
+	std::vector<double> sigmas{};	// The sigma of each type [Angstrom]
+	std::vector<double> ljPairs{};	// Explicit (type, type, epsK, sigma) pairs
+	double ewaldTol = 1e-5;	// Relative Ewald interaction at the cut-off
+	int pmeGrid = 0;		// PME grid points per axis (0 = automatic)
+	int pmeOrder = 4;		// PME B-spline interpolation order
+	int minSteps = 1000;	// Maximum number of minimization steps
+	double minForce = 0.01;	// Force tolerance of the minimization [eV/Angstrom]
 
 	// Derived values
 	double eps = 0;			// epsilon [eV]
@@ -32,11 +78,20 @@ struct dataT {
 	double rhoN = 0;		// Reduced number density
 	double T_s = 0;			// Reduced temperature
 	double tau_s_s = 0;		// Reduced heat bath relaxation time 
+	double tau_p_s = 0;		// Reduced barostat relaxation time
+	double P_s = 0;			// Reduced pressure
+	double kappa_s = 0;		// Reduced isothermal compressibility
+	std::vector<double> masses_s{};		// Reduced masses of the types
+	std::vector<double> eps_s{};		// Reduced epsilons of the types
+	std::vector<double> sigmas_s{};		// Reduced sigmas of the types
+	std::vector<double> ljPairs_s{};	// Reduced explicit pairs
 
 	// Simulation type
 	EnsType ET = EnsType(0);		// The ensemble type employed
 	InteType IT = InteType(0);		// The integration scheme employed
 	PotType PT = PotType(0);		// The potential employed
+	MinType MT = MinType(0);		// The energy minimization before the run
+	LatticeType LT = LatticeType(0);	// The placement of the molecules
 };
 
 #endif // !_datatype_h
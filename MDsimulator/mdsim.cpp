@@ -0,0 +1,116 @@
+#include "mdsim.h"
+#include "Setup.h"
+#include "Ensemble.h"
+
+// A system is the data of the input with its Atoms and Ensemble, and the
+// results of the last step
+struct mds_system {
+	dataT data;
+	Atoms* atoms = nullptr;
+	Ensemble* ens = nullptr;
+	long long step = 0;
+	double U = 0.0;		// Potential energy (reduced)
+	double Hx = 0.0;	// Energy of the extended system (reduced)
+};
+
+int mds_get_api_version(void) {
+	return MDS_API_VERSION;
+}
+
+// The setup is the same as for the executable
+mds_system* mds_create(const char* parameterFile) {
+	mds_system* s = new mds_system();
+	GetParameters(&s->data, parameterFile);
+	Arena::setHugePages(s->data.hugePages != 0);
+	s->atoms = new Atoms(s->data.apm, s->data.mass);
+	InitializeSetup(s->atoms, &s->data);
+	s->ens = Ensemble::createEnsemble(s->atoms, &s->data);
+	s->U = s->ens->calculate();
+	return s;
+}
+
+void mds_destroy(mds_system* s) {
+	if (s == nullptr) return;
+	delete s->ens;
+	delete s->atoms;
+	delete s;
+}
+
+// The molecules are reordered at the same steps as in the executable
+long long mds_advance(mds_system* s, int steps) {
+	for (int i = 0; i < steps; i++) {
+		s->Hx = s->ens->update();
+		s->U = s->ens->calculate();
+		s->step++;
+		if (s->data.reorderInterval > 0
+			&& s->step % s->data.reorderInterval == 0) {
+			s->ens->reorder();
+		}
+	}
+	return s->step;
+}
+
+int mds_get_atom_count(mds_system* s) {
+	return s->atoms->getSize();
+}
+
+int mds_get_atoms_per_molecule(mds_system* s) {
+	return s->atoms->getApm();
+}
+
+double mds_get_time(mds_system* s) {
+	return s->step * s->data.dt_ps;
+}
+
+double mds_get_potential_energy(mds_system* s) {
+	return s->U * s->data.eps;
+}
+
+double mds_get_kinetic_energy(mds_system* s) {
+	return s->atoms->getEnergy() * s->data.eps;
+}
+
+double mds_get_extended_energy(mds_system* s) {
+	return s->Hx * s->data.eps;
+}
+
+double mds_get_pressure(mds_system* s) {
+	double pressureUnit = s->data.epsK * kB / pow(s->data.sigma, 3.0) * 1e30;
+	return s->ens->getPressure() * pressureUnit;
+}
+
+void mds_get_box(mds_system* s, double* h) {
+	const boxT& box = s->atoms->getBox();
+	for (int a = 0; a < 3; a++) {
+		for (int b = 0; b < 3; b++) {
+			h[3 * a + b] = box.h[a][b];
+		}
+	}
+}
+
+void mds_get_units(mds_system* s, double* length, double* energy,
+	double* time) {
+	*length = s->data.sigma;
+	*energy = s->data.eps;
+	*time = s->data.dt_ps / s->data.dt_s;
+}
+
+const double* mds_get_positions(mds_system* s) {
+	return s->atoms->getPositions();
+}
+
+const double* mds_get_velocities(mds_system* s) {
+	return s->atoms->getVelocities();
+}
+
+const double* mds_get_forces(mds_system* s) {
+	return s->ens->getForceArray();
+}
+
+int mds_get_original_index(mds_system* s, int i) {
+	return s->atoms->getOriginalIndex(i);
+}
+
+void mds_set_velocities(mds_system* s, const double* v) {
+	s->ens->setVelocities(v);
+}
@@ -0,0 +1,82 @@
+#ifndef _mdsim_h
+#define _mdsim_h
+
+// C interface of the simulation library, so a host program can keep systems
+// in memory, advance them and read their arrays without going through files.
+//
+// The positions, velocities and forces are borrowed as arrays of x, y, z of
+// the atoms after each other in reduced units (length sigma, energy epsilon,
+// mass of the first atom type, see mds_get_units()). The pointers stay valid
+// until the system is destroyed, but the molecules may be reordered for cache
+// locality during mds_advance(), if 'reorder' is given in the input, so
+// mds_get_original_index() maps them back. The velocities are changed between
+// the steps with mds_set_velocities(), since the integrator may keep its own
+// copy of them. A system may only be used by one thread at a time.
+//
+// Invalid input ends the process with a message, like the executable does.
+
+#ifdef _WIN32
+#ifdef MDSIM_EXPORTS
+#define MDS_API __declspec(dllexport)
+#elif defined(MDSIM_DLL)
+#define MDS_API __declspec(dllimport)
+#else
+#define MDS_API
+#endif
+#else
+#define MDS_API __attribute__((visibility("default")))
+#endif
+
+// Increases whenever a function is changed or removed
+#define MDS_API_VERSION 2
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct mds_system mds_system;
+
+// Get the version of the interface, which the library was built with
+MDS_API int mds_get_api_version(void);
+
+// Create a system from an input file in the format of params.in, including
+// the minimization and the initial velocities. Nothing is written to files.
+MDS_API mds_system* mds_create(const char* parameterFile);
+// Release the system and all its arrays
+MDS_API void mds_destroy(mds_system* system);
+
+// Advance the system by the given number of time steps. Returns the number of
+// steps taken since the creation.
+MDS_API long long mds_advance(mds_system* system, int steps);
+
+// Getters for the size and the state of the system
+MDS_API int mds_get_atom_count(mds_system* system);
+MDS_API int mds_get_atoms_per_molecule(mds_system* system);
+MDS_API double mds_get_time(mds_system* system);				// [ps]
+MDS_API double mds_get_potential_energy(mds_system* system);	// [eV]
+MDS_API double mds_get_kinetic_energy(mds_system* system);		// [eV]
+// The energy of the thermostat, which is conserved with the Hamiltonian [eV]
+MDS_API double mds_get_extended_energy(mds_system* system);
+MDS_API double mds_get_pressure(mds_system* system);			// [Pa]
+// Get the box matrix (reduced) as h[3 * row + column]. Its columns are the
+// cell vectors.
+MDS_API void mds_get_box(mds_system* system, double* h);
+// Get the reduced units: sigma [Angstrom], epsilon [eV] and the time unit [ps]
+MDS_API void mds_get_units(mds_system* system, double* length,
+	double* energy, double* time);
+
+// Borrow the arrays of the system (3 * mds_get_atom_count() values each)
+MDS_API const double* mds_get_positions(mds_system* system);
+MDS_API const double* mds_get_velocities(mds_system* system);
+MDS_API const double* mds_get_forces(mds_system* system);
+// Get the index, which atom i had when the system was created
+MDS_API int mds_get_original_index(mds_system* system, int i);
+// Set the velocities of the atoms in the current order (3 * the atom count
+// values), which the next steps continue from
+MDS_API void mds_set_velocities(mds_system* system, const double* v);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !_mdsim_h
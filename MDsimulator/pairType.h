@@ -0,0 +1,38 @@
+#ifndef _pairtype_h
+#define _pairtype_h
+#include "math.h"
+
+// The Lennard-Jones coefficients of a pair of atom types, precalculated for
+// the pair kernel. With a cut-off the potential is shifted, so both the
+// energy and the force go to zero at the cut-off.
+struct ljPairT {
+	double c12 = 4;			// 4 eps sigma^12 (reduced)
+	double c6 = 4;			// 4 eps sigma^6 (reduced)
+	double cutoffEnergy = 0;	// The energy at the cut-off
+	double diffU_r = 0;		// The force at the cut-off
+
+	// Fake constructor
+	void ctor(double eps, double sigma, double r_c) {
+		c6 = 4.0 * eps * pow(sigma, 6.0);
+		c12 = c6 * pow(sigma, 6.0);
+		cutoffEnergy = 0.0;
+		diffU_r = 0.0;
+		if (r_c != 0.0) {
+			cutoffEnergy = c12 * pow(r_c, -12.0) - c6 * pow(r_c, -6.0);
+			diffU_r = -(12.0 * c12 * pow(r_c, -13.0)
+				- 6.0 * c6 * pow(r_c, -7.0));
+		}
+	}
+
+	// Get the unshifted energy from the inverse sixth power of the distance
+	double getEnergy(double inv6) const {
+		return (c12 * inv6 - c6) * inv6;
+	}
+
+	// Get the unshifted force prefactor, so the force is prefactor * r_ij
+	double getForce(double inv2, double inv6) const {
+		return (12.0 * c12 * inv6 - 6.0 * c6) * inv6 * inv2;
+	}
+};
+
+#endif // !_pairtype_h